@@ -35,9 +35,11 @@
 #include <glib.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <glib/gi18n-lib.h>
+#include <math.h>
 #include <string.h>
 
 #define SCALE_FACTOR 0.2
+#define DRAFT_REDUCTION 2
 
 enum {
 	PROP_0,
@@ -310,16 +312,12 @@ djvu_document_get_page_size (EvDocument   *document,
 				width, height);
 }
 
-static cairo_surface_t *
-djvu_document_render (EvDocument      *document, 
-		      EvRenderContext *rc)
+/* Decodes the page of rc, and sets its rotation and rendered size */
+static ddjvu_page_t *
+djvu_document_get_render_page (DjvuDocument    *djvu_document,
+			       EvRenderContext *rc,
+			       ddjvu_rect_t    *prect)
 {
-	DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
-	cairo_surface_t *surface;
-	gchar *pixels;
-	gint   rowstride;
-    	ddjvu_rect_t rrect;
-	ddjvu_rect_t prect;
 	ddjvu_page_t *d_page;
 	ddjvu_page_rotation_t rotation;
 	double page_width, page_height, tmp;
@@ -355,31 +353,234 @@ djvu_document_render (EvDocument      *document,
 			rotation = DDJVU_ROTATE_0;
 	}
 
-	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
-					      page_width, page_height);
+	prect->x = 0;
+	prect->y = 0;
+	prect->w = page_width;
+	prect->h = page_height;
+
+	ddjvu_page_set_rotation (d_page, rotation);
+
+	return d_page;
+}
+
+static cairo_surface_t *
+djvu_document_render (EvDocument      *document, 
+		      EvRenderContext *rc)
+{
+	DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
+	cairo_surface_t *surface;
+	gchar *pixels;
+	gint   rowstride;
+    	ddjvu_rect_t rrect;
+	ddjvu_rect_t prect;
+	ddjvu_rect_t page_rect;
+	ddjvu_page_t *d_page;
+	gboolean bitonal;
+
+	d_page = djvu_document_get_render_page (djvu_document, rc, &prect);
+
+	/* Drafts are rendered at a lower resolution, which lets djvulibre
+	 * decode the background layers subsampled, and scaled up later.
+	 */
+	page_rect = prect;
+	if (rc->quality == EV_RENDER_QUALITY_DRAFT) {
+		prect.w = MAX (prect.w / DRAFT_REDUCTION, 1);
+		prect.h = MAX (prect.h / DRAFT_REDUCTION, 1);
+	}
+
+	/* Bitonal pages are stored as A8 surfaces holding the ink
+	 * coverage, a quarter of the memory of an RGB24 one.
+	 */
+	bitonal = ddjvu_page_get_type (d_page) == DDJVU_PAGETYPE_BITONAL;
+	surface = ev_document_misc_surface_new (bitonal ? CAIRO_FORMAT_A8 : CAIRO_FORMAT_RGB24,
+						prect.w, prect.h);
 	rowstride = cairo_image_surface_get_stride (surface);
 	pixels = (gchar *)cairo_image_surface_get_data (surface);
 
-	prect.x = 0;
-	prect.y = 0;
-	prect.w = page_width;
-	prect.h = page_height;
 	rrect = prect;
-
-	ddjvu_page_set_rotation (d_page, rotation);
 	
 	ddjvu_page_render (d_page, DDJVU_RENDER_COLOR,
 			   &prect,
 			   &rrect,
-			   djvu_document->d_format,
+			   bitonal ? djvu_document->d_bitonal_format : djvu_document->d_format,
 			   rowstride,
 			   pixels);
 
+	if (bitonal) {
+		gint x, y;
+
+		/* Gray levels to ink coverage */
+		for (y = 0; y < prect.h; y++) {
+			guchar *p = (guchar *)pixels + y * rowstride;
+
+			for (x = 0; x < prect.w; x++)
+				p[x] = 0xff - p[x];
+		}
+	}
+
 	cairo_surface_mark_dirty (surface);
 
+	if (prect.w != page_rect.w || prect.h != page_rect.h) {
+		cairo_surface_t *scaled_surface;
+
+		scaled_surface = ev_document_misc_surface_rotate_and_scale_full (surface,
+										 page_rect.w,
+										 page_rect.h,
+										 0,
+										 CAIRO_FILTER_FAST);
+		cairo_surface_destroy (surface);
+		surface = scaled_surface;
+	}
+
 	return surface;
 }
 
+/* Whether painting an opaque page with cr replaces the pixels of an
+ * RGB24 or ARGB32 image surface inside a single rectangle, translated
+ * by whole pixels, so that pages can be rendered into its data.
+ */
+static gboolean
+djvu_cairo_is_pixel_aligned (cairo_t *cr,
+			     gint    *tx,
+			     gint    *ty)
+{
+	cairo_surface_t *target = cairo_get_target (cr);
+	cairo_rectangle_list_t *clip;
+	cairo_format_t format;
+	cairo_operator_t op;
+	cairo_matrix_t matrix;
+	double x_offset, y_offset;
+	gboolean aligned;
+	gint i;
+
+	if (cairo_get_group_target (cr) != target ||
+	    cairo_surface_get_type (target) != CAIRO_SURFACE_TYPE_IMAGE)
+		return FALSE;
+
+	op = cairo_get_operator (cr);
+	if (op != CAIRO_OPERATOR_OVER && op != CAIRO_OPERATOR_SOURCE)
+		return FALSE;
+
+	format = cairo_image_surface_get_format (target);
+	if (format != CAIRO_FORMAT_RGB24 && format != CAIRO_FORMAT_ARGB32)
+		return FALSE;
+
+	cairo_surface_get_device_offset (target, &x_offset, &y_offset);
+	if (x_offset != 0. || y_offset != 0.)
+		return FALSE;
+
+	cairo_get_matrix (cr, &matrix);
+	if (matrix.xx != 1. || matrix.yy != 1. ||
+	    matrix.xy != 0. || matrix.yx != 0. ||
+	    matrix.x0 != floor (matrix.x0) || matrix.y0 != floor (matrix.y0))
+		return FALSE;
+
+	/* The clip is intersected with the surface, so there's always
+	 * a rectangle unless it's empty.
+	 */
+	clip = cairo_copy_clip_rectangle_list (cr);
+	aligned = clip->status == CAIRO_STATUS_SUCCESS && clip->num_rectangles <= 1;
+	for (i = 0; aligned && i < clip->num_rectangles; i++) {
+		cairo_rectangle_t *rect = &clip->rectangles[i];
+
+		aligned = rect->x == floor (rect->x) && rect->y == floor (rect->y) &&
+			rect->width == floor (rect->width) &&
+			rect->height == floor (rect->height);
+	}
+	cairo_rectangle_list_destroy (clip);
+
+	if (!aligned)
+		return FALSE;
+
+	*tx = matrix.x0;
+	*ty = matrix.y0;
+
+	return TRUE;
+}
+
+/* The visible part of color pages is rendered straight into the
+ * target of cr when possible. Drafts, which are rendered at a lower
+ * resolution, bitonal pages, which are painted as masks, and any
+ * other target are rendered and painted.
+ */
+static gboolean
+djvu_document_render_to (EvDocument      *document,
+			 EvRenderContext *rc,
+			 cairo_t         *cr)
+{
+	DjvuDocument *djvu_document = DJVU_DOCUMENT (document);
+	cairo_surface_t *target = cairo_get_target (cr);
+	double x1, y1, x2, y2;
+	ddjvu_rect_t rrect;
+	ddjvu_rect_t prect;
+	ddjvu_page_t *d_page;
+	gint left, top, right, bottom;
+	gint tx, ty;
+	guchar *pixels;
+	gint rowstride;
+
+	if (rc->quality == EV_RENDER_QUALITY_DRAFT ||
+	    !djvu_cairo_is_pixel_aligned (cr, &tx, &ty))
+		return EV_DOCUMENT_CLASS (djvu_document_parent_class)->render_to (document, rc, cr);
+
+	d_page = djvu_document_get_render_page (djvu_document, rc, &prect);
+	if (ddjvu_page_get_type (d_page) == DDJVU_PAGETYPE_BITONAL) {
+		ddjvu_page_release (d_page);
+
+		return EV_DOCUMENT_CLASS (djvu_document_parent_class)->render_to (document, rc, cr);
+	}
+
+	/* Part of the page inside both the clip and the surface */
+	cairo_clip_extents (cr, &x1, &y1, &x2, &y2);
+	left = MAX (MAX (0, floor (x1)), -tx);
+	top = MAX (MAX (0, floor (y1)), -ty);
+	right = MIN (MIN ((gint) prect.w, ceil (x2)),
+		     cairo_image_surface_get_width (target) - tx);
+	bottom = MIN (MIN ((gint) prect.h, ceil (y2)),
+		      cairo_image_surface_get_height (target) - ty);
+	if (right <= left || bottom <= top) {
+		ddjvu_page_release (d_page);
+
+		return TRUE;
+	}
+
+	rrect.x = left;
+	rrect.y = top;
+	rrect.w = right - left;
+	rrect.h = bottom - top;
+
+	cairo_surface_flush (target);
+	rowstride = cairo_image_surface_get_stride (target);
+	pixels = cairo_image_surface_get_data (target) +
+		(ty + top) * rowstride + (tx + left) * 4;
+
+	if (!ddjvu_page_render (d_page, DDJVU_RENDER_COLOR,
+				&prect,
+				&rrect,
+				djvu_document->d_format,
+				rowstride,
+				(gchar *)pixels)) {
+		ddjvu_page_release (d_page);
+
+		return FALSE;
+	}
+	ddjvu_page_release (d_page);
+
+	cairo_surface_mark_dirty_rectangle (target, tx + left, ty + top,
+					    rrect.w, rrect.h);
+
+	return TRUE;
+}
+
+/* Every document has its own ddjvu context, so documents don't share
+ * any state.
+ */
+static gboolean
+djvu_document_is_thread_safe (EvDocument *document)
+{
+	return TRUE;
+}
+
 static void
 djvu_document_finalize (GObject *object)
 {
@@ -396,6 +597,7 @@ djvu_document_finalize (GObject *object)
 	    
 	ddjvu_context_release (djvu_document->d_context);
 	ddjvu_format_release (djvu_document->d_format);
+	ddjvu_format_release (djvu_document->d_bitonal_format);
 	ddjvu_format_release (djvu_document->thumbs_format);
 	g_free (djvu_document->uri);
 	
@@ -415,6 +617,8 @@ djvu_document_class_init (DjvuDocumentClass *klass)
 	ev_document_class->get_n_pages = djvu_document_get_n_pages;
 	ev_document_class->get_page_size = djvu_document_get_page_size;
 	ev_document_class->render = djvu_document_render;
+	ev_document_class->render_to = djvu_document_render_to;
+	ev_document_class->is_thread_safe = djvu_document_is_thread_safe;
 }
 
 static gchar *
@@ -622,6 +826,9 @@ djvu_document_init (DjvuDocument *djvu_document)
 	djvu_document->d_format = ddjvu_format_create (DDJVU_FORMAT_RGBMASK32, 4, masks);
 	ddjvu_format_set_row_order (djvu_document->d_format, 1);
 
+	djvu_document->d_bitonal_format = ddjvu_format_create (DDJVU_FORMAT_GREY8, 0, 0);
+	ddjvu_format_set_row_order (djvu_document->d_bitonal_format, 1);
+
 	djvu_document->thumbs_format = ddjvu_format_create (DDJVU_FORMAT_RGB24, 0, 0);
 	ddjvu_format_set_row_order (djvu_document->thumbs_format, 1);
 
@@ -215,6 +215,9 @@ pdf_document_dispose (GObject *object)
 {
 	PdfDocument *pdf_document = PDF_DOCUMENT(object);
 
+	/* Drop the cached pages before the poppler document */
+	G_OBJECT_CLASS (pdf_document_parent_class)->dispose (object);
+
 	if (pdf_document->print_ctx) {
 		pdf_print_context_free (pdf_document->print_ctx);
 		pdf_document->print_ctx = NULL;
@@ -241,8 +244,6 @@ pdf_document_dispose (GObject *object)
 		g_list_foreach (pdf_document->layers, (GFunc)g_object_unref, NULL);
 		g_list_free (pdf_document->layers);
 	}
-
-	G_OBJECT_CLASS (pdf_document_parent_class)->dispose (object);
 }
 
 static void
@@ -369,20 +370,37 @@ pdf_document_get_page_label (EvDocument *document,
 	return label;
 }
 
-static cairo_surface_t *
-pdf_page_render (PopplerPage     *page,
-		 gint             width,
-		 gint             height,
-		 EvRenderContext *rc)
+#ifdef HAVE_POPPLER_PAGE_RENDER
+/* Draws the white page and its contents at the origin of cr */
+static void
+pdf_page_render_cairo (PopplerPage     *page,
+		       gint             width,
+		       gint             height,
+		       EvRenderContext *rc,
+		       cairo_t         *cr)
 {
-	cairo_surface_t *surface;
+	cairo_save (cr);
 
-#ifdef HAVE_POPPLER_PAGE_RENDER
-	cairo_t *cr;
+	cairo_rectangle (cr, 0, 0, width, height);
+	cairo_clip (cr);
+	cairo_set_source_rgb (cr, 1., 1., 1.);
+	cairo_paint (cr);
 
-	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-					      width, height);
-	cr = cairo_create (surface);
+	/* Antialiasing is the most expensive part of rendering
+	 * vector pages, drafts are replaced soon anyway.
+	 */
+	if (rc->quality == EV_RENDER_QUALITY_DRAFT) {
+		cairo_font_options_t *font_options;
+
+		cairo_set_antialias (cr, CAIRO_ANTIALIAS_NONE);
+
+		font_options = cairo_font_options_create ();
+		cairo_get_font_options (cr, font_options);
+		cairo_font_options_set_antialias (font_options, CAIRO_ANTIALIAS_NONE);
+		cairo_font_options_set_hint_style (font_options, CAIRO_HINT_STYLE_NONE);
+		cairo_set_font_options (cr, font_options);
+		cairo_font_options_destroy (font_options);
+	}
 
 	switch (rc->rotation) {
 	        case 90:
@@ -401,10 +419,29 @@ pdf_page_render (PopplerPage     *page,
 	cairo_rotate (cr, rc->rotation * G_PI / 180.0);
 	poppler_page_render (page, cr);
 
-	cairo_set_operator (cr, CAIRO_OPERATOR_DEST_OVER);
-	cairo_set_source_rgb (cr, 1., 1., 1.);
-	cairo_paint (cr);
+	cairo_restore (cr);
+}
+#endif /* HAVE_POPPLER_PAGE_RENDER */
+
+static cairo_surface_t *
+pdf_page_render (PopplerPage     *page,
+		 gint             width,
+		 gint             height,
+		 EvRenderContext *rc)
+{
+	cairo_surface_t *surface;
 
+#ifdef HAVE_POPPLER_PAGE_RENDER
+	cairo_t *cr;
+
+	/* Pages are opaque: render onto a white RGB24 surface, so that
+	 * there's no need to composite a background afterwards and the
+	 * surface can be painted without alpha blending.
+	 */
+	surface = ev_document_misc_surface_new (CAIRO_FORMAT_RGB24,
+						width, height);
+	cr = cairo_create (surface);
+	pdf_page_render_cairo (page, width, height, rc, cr);
 	cairo_destroy (cr);
 #else /* HAVE_POPPLER_PAGE_RENDER */
 	GdkPixbuf *pixbuf;
@@ -426,32 +463,60 @@ pdf_page_render (PopplerPage     *page,
 	return surface;	
 }
 
-static cairo_surface_t *
-pdf_document_render (EvDocument      *document,
-		     EvRenderContext *rc)
+static void
+pdf_page_get_render_size (PopplerPage     *poppler_page,
+			  EvRenderContext *rc,
+			  gint            *width,
+			  gint            *height)
 {
-	PdfDocument *pdf_document;
-	PopplerPage *poppler_page;
 	double width_points, height_points;
-	gint width, height;
-
-	poppler_page = POPPLER_PAGE (rc->page->backend_page);
 
 	poppler_page_get_size (poppler_page,
 			       &width_points, &height_points);
 	
 	if (rc->rotation == 90 || rc->rotation == 270) {
-		width = (int) ((height_points * rc->scale) + 0.5);
-		height = (int) ((width_points * rc->scale) + 0.5);
+		*width = (int) ((height_points * rc->scale) + 0.5);
+		*height = (int) ((width_points * rc->scale) + 0.5);
 	} else {
-		width = (int) ((width_points * rc->scale) + 0.5);
-		height = (int) ((height_points * rc->scale) + 0.5);
+		*width = (int) ((width_points * rc->scale) + 0.5);
+		*height = (int) ((height_points * rc->scale) + 0.5);
 	}
+}
+
+static cairo_surface_t *
+pdf_document_render (EvDocument      *document,
+		     EvRenderContext *rc)
+{
+	PopplerPage *poppler_page;
+	gint width, height;
+
+	poppler_page = POPPLER_PAGE (rc->page->backend_page);
+	pdf_page_get_render_size (poppler_page, rc, &width, &height);
 	
 	return pdf_page_render (poppler_page,
 				width, height, rc);
 }
 
+#ifdef HAVE_POPPLER_PAGE_RENDER
+static gboolean
+pdf_document_render_to (EvDocument      *document,
+			EvRenderContext *rc,
+			cairo_t         *cr)
+{
+	PopplerPage *poppler_page;
+	gint width, height;
+
+	poppler_page = POPPLER_PAGE (rc->page->backend_page);
+	pdf_page_get_render_size (poppler_page, rc, &width, &height);
+
+	ev_document_fc_mutex_lock ();
+	pdf_page_render_cairo (poppler_page, width, height, rc, cr);
+	ev_document_fc_mutex_unlock ();
+
+	return cairo_status (cr) == CAIRO_STATUS_SUCCESS;
+}
+#endif /* HAVE_POPPLER_PAGE_RENDER */
+
 /* reference:
 http://www.pdfa.org/lib/exe/fetch.php?id=pdfa%3Aen%3Atechdoc&cache=cache&media=pdfa:techdoc:tn0001_pdfa-1_and_namespaces_2008-03-18.pdf */
 static char *
@@ -874,6 +939,9 @@ pdf_document_class_init (PdfDocumentClass *klass)
 	ev_document_class->get_page_size = pdf_document_get_page_size;
 	ev_document_class->get_page_label = pdf_document_get_page_label;
 	ev_document_class->render = pdf_document_render;
+#ifdef HAVE_POPPLER_PAGE_RENDER
+	ev_document_class->render_to = pdf_document_render_to;
+#endif
 	ev_document_class->get_info = pdf_document_get_info;
 	ev_document_class->get_backend_info = pdf_document_get_backend_info;
 	ev_document_class->synctex_enabled = pdf_document_synctex_enabled;
@@ -1488,15 +1556,31 @@ pdf_document_thumbnails_get_thumbnail (EvDocumentThumbnails *document_thumbnails
 			gdk_pixbuf_get_height (pixbuf) :
 			gdk_pixbuf_get_width (pixbuf);
 
-		if (thumb_width == width) {
+		if (thumb_width >= width) {
 			GdkPixbuf *rotated_pixbuf;
 
+			/* Scaling down the provided thumbnail is much
+			 * cheaper than rendering the page */
+			if (thumb_width > width) {
+				GdkPixbuf *scaled_pixbuf;
+				gboolean   swap;
+
+				/* The provided thumbnail is not rotated */
+				swap = (rc->rotation == 90 || rc->rotation == 270);
+				scaled_pixbuf = gdk_pixbuf_scale_simple (pixbuf,
+									 swap ? height : width,
+									 swap ? width : height,
+									 GDK_INTERP_BILINEAR);
+				g_object_unref (pixbuf);
+				pixbuf = scaled_pixbuf;
+			}
+
 			rotated_pixbuf = gdk_pixbuf_rotate_simple (pixbuf,
 								   (GdkPixbufRotation) (360 - rc->rotation));
 			g_object_unref (pixbuf);
 			pixbuf = rotated_pixbuf;
 		} else {
-			/* The provided thumbnail has a different size */
+			/* The provided thumbnail is too small */
 			g_object_unref (pixbuf);
 			pixbuf = make_thumbnail_for_page (poppler_page, rc, width, height);
 		}
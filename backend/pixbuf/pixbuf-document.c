@@ -35,6 +35,8 @@ struct _PixbufDocument
 	EvDocument parent_instance;
 
 	GdkPixbuf *pixbuf;
+	/* The pixbuf as a surface, for render_to */
+	cairo_surface_t *surface;
 	
 	gchar *uri;
 };
@@ -116,7 +118,8 @@ pixbuf_document_render (EvDocument      *document,
 		pixbuf_document->pixbuf,
 		(gdk_pixbuf_get_width (pixbuf_document->pixbuf) * rc->scale) + 0.5,
 		(gdk_pixbuf_get_height (pixbuf_document->pixbuf) * rc->scale) + 0.5,
-		GDK_INTERP_BILINEAR);
+		rc->quality == EV_RENDER_QUALITY_DRAFT ?
+		GDK_INTERP_NEAREST : GDK_INTERP_BILINEAR);
 	
         rotated_pixbuf = gdk_pixbuf_rotate_simple (scaled_pixbuf, 360 - rc->rotation);
         g_object_unref (scaled_pixbuf);
@@ -127,12 +130,40 @@ pixbuf_document_render (EvDocument      *document,
 	return surface;
 }
 
+static gboolean
+pixbuf_document_render_to (EvDocument      *document,
+			   EvRenderContext *rc,
+			   cairo_t         *cr)
+{
+	PixbufDocument *pixbuf_document = PIXBUF_DOCUMENT (document);
+
+	if (!pixbuf_document->surface)
+		pixbuf_document->surface = ev_document_misc_surface_from_pixbuf (pixbuf_document->pixbuf);
+
+	ev_document_misc_paint_surface_scaled (cr, pixbuf_document->surface,
+					       (gdk_pixbuf_get_width (pixbuf_document->pixbuf) * rc->scale) + 0.5,
+					       (gdk_pixbuf_get_height (pixbuf_document->pixbuf) * rc->scale) + 0.5,
+					       rc->rotation,
+					       rc->quality == EV_RENDER_QUALITY_DRAFT ?
+					       CAIRO_FILTER_FAST : CAIRO_FILTER_GOOD);
+
+	return TRUE;
+}
+
+static gboolean
+pixbuf_document_is_thread_safe (EvDocument *document)
+{
+	return TRUE;
+}
+
 static void
 pixbuf_document_finalize (GObject *object)
 {
 	PixbufDocument *pixbuf_document = PIXBUF_DOCUMENT (object);
 
 	g_object_unref (pixbuf_document->pixbuf);
+	if (pixbuf_document->surface)
+		cairo_surface_destroy (pixbuf_document->surface);
 	g_free (pixbuf_document->uri);
 	
 	G_OBJECT_CLASS (pixbuf_document_parent_class)->finalize (object);
@@ -151,6 +182,8 @@ pixbuf_document_class_init (PixbufDocumentClass *klass)
 	ev_document_class->get_n_pages = pixbuf_document_get_n_pages;
 	ev_document_class->get_page_size = pixbuf_document_get_page_size;
 	ev_document_class->render = pixbuf_document_render;
+	ev_document_class->render_to = pixbuf_document_render_to;
+	ev_document_class->is_thread_safe = pixbuf_document_is_thread_safe;
 }
 
 static GdkPixbuf *
@@ -63,6 +63,9 @@ ps_document_dispose (GObject *object)
 {
 	PSDocument *ps = PS_DOCUMENT (object);
 
+	/* Drop the cached pages before the spectre document */
+	G_OBJECT_CLASS (ps_document_parent_class)->dispose (object);
+
 	if (ps->doc) {
 		spectre_document_free (ps->doc);
 		ps->doc = NULL;
@@ -72,8 +75,6 @@ ps_document_dispose (GObject *object)
 		spectre_exporter_free (ps->exporter);
 		ps->exporter = NULL;
 	}
-
-	G_OBJECT_CLASS (ps_document_parent_class)->dispose (object);
 }
 
 /* EvDocumentIface */
@@ -209,11 +209,99 @@ tiff_document_get_page_size (EvDocument *document,
 	pop_handlers ();
 }
 
+static inline guchar
+reverse_bits (guchar b)
+{
+	b = ((b & 0xf0) >> 4) | ((b & 0x0f) << 4);
+	b = ((b & 0xcc) >> 2) | ((b & 0x33) << 2);
+
+	return ((b & 0xaa) >> 1) | ((b & 0x55) << 1);
+}
+
+/* Bitonal pages, like faxes and most scans, are read directly into an
+ * A1 surface holding the ink, 32 times smaller than an RGB24 one.
+ * Returns NULL for any other kind of page.
+ */
 static cairo_surface_t *
-tiff_document_render (EvDocument      *document,
-		      EvRenderContext *rc)
+tiff_document_render_bitonal (TiffDocument *tiff_document,
+			      int           width,
+			      int           height)
+{
+	TIFF            *tiff = tiff_document->tiff;
+	cairo_surface_t *surface;
+	guint16          bits_per_sample, samples_per_pixel;
+	guint16          photometric;
+	guchar          *data;
+	guchar          *scanline;
+	gint             stride;
+	gint             row, i;
+
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+	TIFFGetFieldDefaulted (tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
+	if (bits_per_sample != 1 || samples_per_pixel != 1 || TIFFIsTiled (tiff))
+		return NULL;
+
+	if (!TIFFGetField (tiff, TIFFTAG_PHOTOMETRIC, &photometric) ||
+	    (photometric != PHOTOMETRIC_MINISWHITE &&
+	     photometric != PHOTOMETRIC_MINISBLACK))
+		return NULL;
+
+	surface = ev_document_misc_surface_new (CAIRO_FORMAT_A1, width, height);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (surface);
+		return NULL;
+	}
+
+	scanline = g_try_malloc (TIFFScanlineSize (tiff));
+	if (!scanline) {
+		cairo_surface_destroy (surface);
+		return NULL;
+	}
+
+	data = cairo_image_surface_get_data (surface);
+	stride = cairo_image_surface_get_stride (surface);
+
+	for (row = 0; row < height; row++) {
+		guchar *dest = data + row * stride;
+
+		if (TIFFReadScanline (tiff, scanline, row, 0) < 0) {
+			g_free (scanline);
+			cairo_surface_destroy (surface);
+
+			return NULL;
+		}
+
+		/* TIFF stores the first pixel in the most significant
+		 * bit, cairo in the least significant one on little
+		 * endian machines. Set bits are ink.
+		 */
+		for (i = 0; i < (width + 7) / 8; i++) {
+			guchar b = scanline[i];
+
+			if (photometric == PHOTOMETRIC_MINISBLACK)
+				b = ~b;
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+			b = reverse_bits (b);
+#endif
+			dest[i] = b;
+		}
+	}
+
+	g_free (scanline);
+	cairo_surface_mark_dirty (surface);
+
+	return surface;
+}
+
+/* Returns the page of rc at its own resolution, and the size it
+ * must be scaled to before applying the rotation.
+ */
+static cairo_surface_t *
+tiff_document_read_page (TiffDocument    *tiff_document,
+			 EvRenderContext *rc,
+			 gint            *dest_width,
+			 gint            *dest_height)
 {
-	TiffDocument *tiff_document = TIFF_DOCUMENT (document);
 	int width, height;
 	float x_res, y_res;
 	gint rowstride, bytes;
@@ -221,10 +309,7 @@ tiff_document_render (EvDocument      *document,
 	guchar *p;
 	int orientation;
 	cairo_surface_t *surface;
-	cairo_surface_t *rotated_surface;
-	static const cairo_user_data_key_t key;
 	
-	g_return_val_if_fail (TIFF_IS_DOCUMENT (document), NULL);
 	g_return_val_if_fail (tiff_document->tiff != NULL, NULL);
   
 	push_handlers ();
@@ -255,6 +340,18 @@ tiff_document_render (EvDocument      *document,
 	if (width <= 0 || height <= 0)
 		return NULL;                
 
+	*dest_width = (width * rc->scale) + 0.5;
+	*dest_height = (height * rc->scale * (x_res / y_res)) + 0.5;
+
+	if (orientation == ORIENTATION_TOPLEFT) {
+		push_handlers ();
+		surface = tiff_document_render_bitonal (tiff_document, width, height);
+		pop_handlers ();
+
+		if (surface)
+			return surface;
+	}
+
 #ifdef HAVE_CAIRO_FORMAT_STRIDE_FOR_WIDTH
 	rowstride = cairo_format_stride_for_width (CAIRO_FORMAT_RGB24, width);
 #else
@@ -269,16 +366,12 @@ tiff_document_render (EvDocument      *document,
 		/* overflow */
 		return NULL;                
 	
-	pixels = g_try_malloc (bytes);
-	if (!pixels)
+	surface = ev_document_misc_surface_new (CAIRO_FORMAT_RGB24, width, height);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (surface);
 		return NULL;
-	
-	surface = cairo_image_surface_create_for_data (pixels,
-						       CAIRO_FORMAT_RGB24,
-						       width, height,
-						       rowstride);
-	cairo_surface_set_user_data (surface, &key,
-				     pixels, (cairo_destroy_func_t)g_free);
+	}
+	pixels = cairo_image_surface_get_data (surface);
 
 	TIFFReadRGBAImageOriented (tiff_document->tiff,
 				   width, height,
@@ -301,16 +394,73 @@ tiff_document_render (EvDocument      *document,
 
 		p += 4;
 	}
+	cairo_surface_mark_dirty (surface);
+
+	return surface;
+}
 
-	rotated_surface = ev_document_misc_surface_rotate_and_scale (surface,
-								     (width * rc->scale) + 0.5,
-								     (height * rc->scale * (x_res / y_res)) + 0.5,
-								     rc->rotation);
+static cairo_surface_t *
+tiff_document_render (EvDocument      *document,
+		      EvRenderContext *rc)
+{
+	TiffDocument *tiff_document = TIFF_DOCUMENT (document);
+	cairo_surface_t *surface;
+	cairo_surface_t *rotated_surface;
+	gint width, height;
+
+	g_return_val_if_fail (TIFF_IS_DOCUMENT (document), NULL);
+
+	surface = tiff_document_read_page (tiff_document, rc, &width, &height);
+	if (!surface)
+		return NULL;
+
+	rotated_surface = ev_document_misc_surface_rotate_and_scale_full (surface,
+									  width, height,
+									  rc->rotation,
+									  rc->quality == EV_RENDER_QUALITY_DRAFT ?
+									  CAIRO_FILTER_FAST : CAIRO_FILTER_GOOD);
 	cairo_surface_destroy (surface);
 	
 	return rotated_surface;
 }
 
+/* Scales the page straight into cr, without an intermediate surface */
+static gboolean
+tiff_document_render_to (EvDocument      *document,
+			 EvRenderContext *rc,
+			 cairo_t         *cr)
+{
+	TiffDocument *tiff_document = TIFF_DOCUMENT (document);
+	cairo_surface_t *surface;
+	gint width, height;
+
+	g_return_val_if_fail (TIFF_IS_DOCUMENT (document), FALSE);
+
+	surface = tiff_document_read_page (tiff_document, rc, &width, &height);
+	if (!surface)
+		return FALSE;
+
+	if (ev_document_misc_surface_is_monochrome (surface)) {
+		cairo_save (cr);
+		cairo_set_source_rgb (cr, 1., 1., 1.);
+		if (rc->rotation == 90 || rc->rotation == 270)
+			cairo_rectangle (cr, 0, 0, height, width);
+		else
+			cairo_rectangle (cr, 0, 0, width, height);
+		cairo_fill (cr);
+		cairo_restore (cr);
+	}
+
+	ev_document_misc_paint_surface_scaled (cr, surface,
+					       width, height,
+					       rc->rotation,
+					       rc->quality == EV_RENDER_QUALITY_DRAFT ?
+					       CAIRO_FILTER_FAST : CAIRO_FILTER_GOOD);
+	cairo_surface_destroy (surface);
+
+	return TRUE;
+}
+
 static GdkPixbuf *
 tiff_document_render_pixbuf (EvDocument      *document,
 			     EvRenderContext *rc)
@@ -424,6 +574,7 @@ tiff_document_class_init (TiffDocumentClass *klass)
 	ev_document_class->get_n_pages = tiff_document_get_n_pages;
 	ev_document_class->get_page_size = tiff_document_get_page_size;
 	ev_document_class->render = tiff_document_render;
+	ev_document_class->render_to = tiff_document_render_to;
 	ev_document_class->get_page_label = tiff_document_get_page_label;
 }
 
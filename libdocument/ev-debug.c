@@ -45,7 +45,50 @@ static EvDebugSection ev_debug = EV_NO_DEBUG;
 static EvProfileSection ev_profile = EV_NO_PROFILE;
 
 static GHashTable *timers = NULL;
+#endif
+
+/* Tracing
+ *
+ * Every thread records its events in its own ring buffer, so that
+ * recording never takes a lock; only the thread owning a buffer
+ * writes to it. When the buffer is full the oldest events are
+ * overwritten. Buffers are never freed, so the events of threads that
+ * have already finished are still exported, and threads that are still
+ * running at shutdown never record into freed memory.
+ */
+#define TRACE_BUFFER_SIZE 8192
+
+typedef struct {
+	EvTracePhase  phase;
+	const gchar  *name;
+	gint64        start;
+	gint64        end;
+	gconstpointer id;
+	const gchar  *type;
+	gint          page;
+	gdouble       scale;
+	gconstpointer document;
+} EvTraceEvent;
+
+typedef struct {
+	guint          tid;
+	/* Events ever recorded, it wraps around after G_MAXUINT */
+	volatile guint n_events;
+	EvTraceEvent   events[TRACE_BUFFER_SIZE];
+} EvTraceBuffer;
 
+static gchar        *trace_file = NULL;
+static GTimer       *trace_timer = NULL; /* NULL when not recording */
+static GTimer       *trace_timer_instance = NULL;
+static GStaticPrivate trace_buffer_key = G_STATIC_PRIVATE_INIT;
+G_LOCK_DEFINE_STATIC (trace_buffers);
+static GSList       *trace_buffers = NULL;
+static guint         trace_n_threads = 0;
+
+static EvTraceBuffer *trace_get_buffer (void);
+static gboolean       trace_write      (const gchar *filename);
+
+#ifdef EV_ENABLE_DEBUG
 static void
 debug_init ()
 {
@@ -77,23 +120,68 @@ profile_init ()
 						(GDestroyNotify) g_timer_destroy);
 	}
 }
+#endif /* EV_ENABLE_DEBUG */
+
+static void
+trace_init ()
+{
+	const gchar *filename;
+
+	filename = g_getenv ("EV_TRACE");
+	if (!filename || *filename == '\0')
+		return;
+
+	trace_file = g_strdup (filename);
+	if (!trace_timer_instance)
+		trace_timer_instance = g_timer_new ();
+	trace_timer = trace_timer_instance;
+
+	/* The first buffer is the main thread one */
+	trace_get_buffer ();
+}
+
+static void
+trace_shutdown ()
+{
+	if (!trace_file)
+		return;
+
+	/* Stop recording first. Job threads might still be recording,
+	 * so the timer and the buffers they can reach are left alive.
+	 */
+	g_atomic_pointer_set (&trace_timer, NULL);
+
+	trace_write (trace_file);
+
+	g_free (trace_file);
+	trace_file = NULL;
+}
 
 void
 _ev_debug_init ()
 {
+#ifdef EV_ENABLE_DEBUG
 	debug_init ();
 	profile_init ();
+#endif
+	trace_init ();
 }
 
 void
 _ev_debug_shutdown ()
 {
+#ifdef EV_ENABLE_DEBUG
 	if (timers) {
 		g_hash_table_destroy (timers);
 		timers = NULL;
 	}
+#endif
+
+	trace_shutdown ();
 }
 
+#ifdef EV_ENABLE_DEBUG
+
 void
 ev_debug_message (EvDebugSection  section,
 		  const gchar    *file,
@@ -175,3 +263,194 @@ ev_profiler_stop (EvProfileSection section,
 }
 
 #endif /* EV_ENABLE_DEBUG */
+
+/**
+ * ev_trace_is_enabled:
+ *
+ * Returns: %TRUE when trace events are being recorded
+ */
+gboolean
+ev_trace_is_enabled (void)
+{
+	return trace_timer != NULL;
+}
+
+/**
+ * ev_trace_get_time:
+ *
+ * Returns: the current trace time in microseconds, to be used as
+ * the start of a %EV_TRACE_SPAN event, or 0 when tracing is disabled
+ */
+gint64
+ev_trace_get_time (void)
+{
+	GTimer *timer = trace_timer;
+
+	if (G_LIKELY (!timer))
+		return 0;
+
+	return (gint64)(g_timer_elapsed (timer, NULL) * G_USEC_PER_SEC);
+}
+
+static EvTraceBuffer *
+trace_get_buffer (void)
+{
+	EvTraceBuffer *buffer;
+
+	buffer = g_static_private_get (&trace_buffer_key);
+	if (G_LIKELY (buffer))
+		return buffer;
+
+	buffer = g_new0 (EvTraceBuffer, 1);
+
+	G_LOCK (trace_buffers);
+	buffer->tid = trace_n_threads++;
+	trace_buffers = g_slist_prepend (trace_buffers, buffer);
+	G_UNLOCK (trace_buffers);
+
+	g_static_private_set (&trace_buffer_key, buffer, NULL);
+
+	return buffer;
+}
+
+/**
+ * ev_trace_event:
+ * @phase: the #EvTracePhase
+ * @name: the event name, it must be a static string
+ * @start: the start time of a %EV_TRACE_SPAN, as returned by ev_trace_get_time()
+ * @id: identifier matching async events, usually the job
+ * @type: the job type name, it must be a static string, or %NULL
+ * @page: the page, or -1
+ * @scale: the scale, or 0
+ * @document: the document, or %NULL
+ *
+ * Records a trace event in the ring buffer of the current thread.
+ */
+void
+ev_trace_event (EvTracePhase  phase,
+		const gchar  *name,
+		gint64        start,
+		gconstpointer id,
+		const gchar  *type,
+		gint          page,
+		gdouble       scale,
+		gconstpointer document)
+{
+	EvTraceBuffer *buffer;
+	EvTraceEvent  *event;
+	guint          n_events;
+
+	if (G_LIKELY (!trace_timer))
+		return;
+
+	buffer = trace_get_buffer ();
+	n_events = (guint) g_atomic_int_get ((volatile gint *)&buffer->n_events);
+	event = &buffer->events[n_events % TRACE_BUFFER_SIZE];
+
+	event->phase = phase;
+	event->name = name;
+	event->end = ev_trace_get_time ();
+	event->start = phase == EV_TRACE_SPAN ? start : event->end;
+	event->id = id;
+	event->type = type;
+	event->page = page;
+	event->scale = scale;
+	event->document = document;
+
+	/* Publish the event once it's complete */
+	g_atomic_int_set ((volatile gint *)&buffer->n_events, (gint)(n_events + 1));
+}
+
+static void
+trace_write_event (FILE         *file,
+		   guint         tid,
+		   EvTraceEvent *event)
+{
+	static const gchar phases[] = { 'X', 'i', 'b', 'e' };
+	gchar scale[G_ASCII_DTOSTR_BUF_SIZE];
+
+	fprintf (file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\","
+		 "\"pid\":1,\"tid\":%u,\"ts\":%" G_GINT64_FORMAT,
+		 event->name, event->type ? event->type : "evince",
+		 phases[event->phase], tid, event->start);
+
+	switch (event->phase) {
+	case EV_TRACE_SPAN:
+		fprintf (file, ",\"dur\":%" G_GINT64_FORMAT, event->end - event->start);
+		break;
+	case EV_TRACE_INSTANT:
+		fputs (",\"s\":\"t\"", file);
+		break;
+	case EV_TRACE_ASYNC_BEGIN:
+	case EV_TRACE_ASYNC_END:
+		fprintf (file, ",\"id\":\"%p\"", event->id);
+		break;
+	}
+
+	g_ascii_formatd (scale, sizeof (scale), "%.3f", event->scale);
+	fprintf (file, ",\"args\":{\"page\":%d,\"scale\":%s,\"document\":\"%p\"}}",
+		 event->page, scale, event->document);
+}
+
+/**
+ * ev_trace_dump:
+ * @filename: the output file name
+ *
+ * Writes the recorded trace events to @filename in the Chrome trace
+ * event format, so that they can be loaded in chrome://tracing.
+ * Buffers are not locked while they are written, threads still
+ * recording might overwrite the oldest events of a full buffer.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+ev_trace_dump (const gchar *filename)
+{
+	if (!trace_timer)
+		return FALSE;
+
+	return trace_write (filename);
+}
+
+static gboolean
+trace_write (const gchar *filename)
+{
+	FILE    *file;
+	GSList  *l;
+	gboolean retval;
+
+	file = fopen (filename, "w");
+	if (!file) {
+		g_warning ("Error writing trace file %s", filename);
+		return FALSE;
+	}
+
+	fputs ("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+	       "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+	       "\"args\":{\"name\":\"evince\"}}", file);
+
+	G_LOCK (trace_buffers);
+	for (l = trace_buffers; l; l = g_slist_next (l)) {
+		EvTraceBuffer *buffer = l->data;
+		guint          n_events;
+		guint          i;
+
+		fprintf (file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+			 "\"args\":{\"name\":\"%s %u\"}}",
+			 buffer->tid, buffer->tid == 0 ? "main" : "thread", buffer->tid);
+
+		n_events = (guint) g_atomic_int_get ((volatile gint *)&buffer->n_events);
+		for (i = n_events - MIN (n_events, TRACE_BUFFER_SIZE); i != n_events; i++)
+			trace_write_event (file, buffer->tid,
+					   &buffer->events[i % TRACE_BUFFER_SIZE]);
+	}
+	G_UNLOCK (trace_buffers);
+
+	fputs ("\n]}\n", file);
+
+	retval = !ferror (file);
+	if (fclose (file) != 0)
+		retval = FALSE;
+
+	return retval;
+}
@@ -43,10 +43,40 @@
 
 #define EV_GET_TYPE_NAME(instance) g_type_name_from_instance ((gpointer)instance)
 
+G_BEGIN_DECLS
+
+/*
+ * Set EV_TRACE to a file name to record trace events. They are
+ * written to the file in the Chrome trace event format when evince
+ * exits, or when ev_trace_dump() is called. Tracing is built in
+ * release builds too, so that production sessions can be traced.
+ */
+typedef enum {
+	EV_TRACE_SPAN,        /* From start to now in the current thread */
+	EV_TRACE_INSTANT,
+	EV_TRACE_ASYNC_BEGIN, /* Async events are matched by id and can */
+	EV_TRACE_ASYNC_END    /* begin and end in different threads */
+} EvTracePhase;
+
+void _ev_debug_init     (void);
+void _ev_debug_shutdown (void);
+
+gboolean ev_trace_is_enabled (void);
+gint64   ev_trace_get_time (void);
+void     ev_trace_event    (EvTracePhase     phase,
+			    const gchar     *name,
+			    gint64           start,
+			    gconstpointer    id,
+			    const gchar     *type,
+			    gint             page,
+			    gdouble          scale,
+			    gconstpointer    document);
+gboolean ev_trace_dump     (const gchar     *filename);
+
+G_END_DECLS
+
 #ifndef EV_ENABLE_DEBUG
 
-#define _ev_debug_init()
-#define _ev_debug_shutdown()
 #if defined(G_HAVE_GNUC_VARARGS)
 #define ev_debug_message(section, format, args...) G_STMT_START { } G_STMT_END
 #define ev_profiler_start(format, args...) G_STMT_START { } G_STMT_END
@@ -87,9 +117,6 @@ typedef enum {
 	EV_PROFILE_JOBS = 1 << 0
 } EvProfileSection;
 
-void _ev_debug_init     (void);
-void _ev_debug_shutdown (void);
-
 void ev_debug_message  (EvDebugSection   section,
 			const gchar     *file,
 			gint             line,
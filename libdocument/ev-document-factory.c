@@ -206,6 +206,26 @@ free_uncompressed_uri (gchar *uri_unc)
  */
 EvDocument *
 ev_document_factory_get_document (const char *uri, GError **error)
+{
+	return ev_document_factory_get_document_full (uri, EV_DOCUMENT_LOAD_FLAG_NONE, error);
+}
+
+/**
+ * ev_document_factory_get_document_full:
+ * @uri: an URI
+ * @flags: a set of #EvDocumentLoadFlags
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Creates a #EvDocument for the document at @uri like
+ * ev_document_factory_get_document(), loading it with @flags.
+ * See ev_document_load_full().
+ *
+ * Returns: a new #EvDocument, or %NULL.
+ */
+EvDocument *
+ev_document_factory_get_document_full (const char         *uri,
+				       EvDocumentLoadFlags flags,
+				       GError            **error)
 {
 	EvDocument *document;
 	int result;
@@ -232,7 +252,7 @@ ev_document_factory_get_document (const char *uri, GError **error)
 			return NULL;
 		}
 
-		result = ev_document_load (document, uri_unc ? uri_unc : uri, &err);
+		result = ev_document_load_full (document, uri_unc ? uri_unc : uri, flags, &err);
 
 		if (result == FALSE || err) {
 			if (err &&
@@ -274,7 +294,7 @@ ev_document_factory_get_document (const char *uri, GError **error)
 		return NULL;
 	}
 	
-	result = ev_document_load (document, uri_unc ? uri_unc : uri, &err);
+	result = ev_document_load_full (document, uri_unc ? uri_unc : uri, flags, &err);
 	if (result == FALSE) {
 		if (err == NULL) {
 			/* FIXME: this really should not happen; the backend should
@@ -26,6 +26,7 @@
 #include <gtk/gtk.h>
 
 #include "ev-document-misc.h"
+#include "ev-pixel-kernels.h"
 
 /* Returns a new GdkPixbuf that is suitable for placing in the thumbnail view.
  * It is four pixels wider and taller than the source.  If source_pixbuf is not
@@ -154,20 +155,272 @@ ev_document_misc_paint_one_page (GdkDrawable  *drawable,
 
 }
 
+/* Page sized surfaces are created and destroyed all the time while
+ * scrolling, always with the same few sizes. Their buffers are kept
+ * in a pool when the surfaces are destroyed, so that new surfaces can
+ * reuse them instead of mapping fresh memory. Buffers are grouped in
+ * size classes, eight per power of two, and the ones that haven't
+ * been reused for a while are freed. Without a main loop, like in the
+ * command line tools, the trim timeout never runs, so buffers that
+ * haven't been reused after SURFACE_POOL_MAX_RELEASES other buffers
+ * were released are freed as well.
+ */
+#define SURFACE_POOL_MAX_SIZE      (64 * 1024 * 1024)
+#define SURFACE_POOL_MAX_RELEASES  32
+#define SURFACE_POOL_MIN_BUFFER    (64 * 1024)
+#define SURFACE_POOL_TRIM_INTERVAL 5 /* seconds */
+
+typedef struct {
+	guchar *data;
+	gsize   size;
+	guint   age;
+	guint   release;
+} PoolBuffer;
+
+G_LOCK_DEFINE_STATIC (surface_pool);
+static GQueue                surface_pool;  /* Most recently released first */
+static gsize                 surface_pool_size = 0;
+static guint                 surface_pool_trim_id = 0;
+static guint                 surface_pool_n_releases = 0;
+static cairo_user_data_key_t surface_pool_key;
+
+static gsize
+surface_pool_size_class (gsize size)
+{
+	gsize step = 4096;
+
+	while (step * 16 <= size)
+		step <<= 1;
+
+	return (size + step - 1) & ~(step - 1);
+}
+
+static void
+pool_buffer_free (PoolBuffer *buffer)
+{
+	g_free (buffer->data);
+	g_slice_free (PoolBuffer, buffer);
+}
+
+static PoolBuffer *
+surface_pool_acquire (gsize size)
+{
+	PoolBuffer *buffer = NULL;
+	GList      *l;
+
+	G_LOCK (surface_pool);
+
+	for (l = surface_pool.head; l; l = g_list_next (l)) {
+		if (((PoolBuffer *) l->data)->size == size) {
+			buffer = l->data;
+			g_queue_delete_link (&surface_pool, l);
+			surface_pool_size -= size;
+			break;
+		}
+	}
+
+	G_UNLOCK (surface_pool);
+
+	if (buffer)
+		return buffer;
+
+	buffer = g_slice_new (PoolBuffer);
+	buffer->data = g_try_malloc (size);
+	if (!buffer->data) {
+		g_slice_free (PoolBuffer, buffer);
+		return NULL;
+	}
+	buffer->size = size;
+
+	return buffer;
+}
+
+/* Frees the buffers that haven't been reused since the previous run */
+static gboolean
+surface_pool_trim (gpointer data)
+{
+	GSList  *unused = NULL;
+	GList   *l;
+	gboolean retval;
+
+	G_LOCK (surface_pool);
+
+	l = surface_pool.head;
+	while (l) {
+		GList      *next = l->next;
+		PoolBuffer *buffer = l->data;
+
+		if (buffer->age++ > 0) {
+			g_queue_delete_link (&surface_pool, l);
+			surface_pool_size -= buffer->size;
+			unused = g_slist_prepend (unused, buffer);
+		}
+		l = next;
+	}
+
+	/* Decided with the lock held, a release right after
+	 * unlocking adds a new timeout if this one is removed.
+	 */
+	if (g_queue_is_empty (&surface_pool))
+		surface_pool_trim_id = 0;
+	retval = surface_pool_trim_id != 0;
+
+	G_UNLOCK (surface_pool);
+
+	g_slist_foreach (unused, (GFunc) pool_buffer_free, NULL);
+	g_slist_free (unused);
+
+	return retval;
+}
+
+/* Called when the last reference of a pool surface is gone,
+ * possibly in a rendering thread.
+ */
+static void
+surface_pool_release (PoolBuffer *buffer)
+{
+	GSList *unused = NULL;
+
+	G_LOCK (surface_pool);
+
+	buffer->age = 0;
+	buffer->release = surface_pool_n_releases++;
+	g_queue_push_head (&surface_pool, buffer);
+	surface_pool_size += buffer->size;
+
+	/* The oldest buffers are at the tail */
+	while (!g_queue_is_empty (&surface_pool)) {
+		PoolBuffer *oldest = g_queue_peek_tail (&surface_pool);
+
+		if (surface_pool_size <= SURFACE_POOL_MAX_SIZE &&
+		    surface_pool_n_releases - oldest->release <= SURFACE_POOL_MAX_RELEASES)
+			break;
+
+		g_queue_pop_tail (&surface_pool);
+		surface_pool_size -= oldest->size;
+		unused = g_slist_prepend (unused, oldest);
+	}
+
+	if (!surface_pool_trim_id && !g_queue_is_empty (&surface_pool)) {
+		surface_pool_trim_id = g_timeout_add_seconds (SURFACE_POOL_TRIM_INTERVAL,
+							      surface_pool_trim,
+							      NULL);
+	}
+
+	G_UNLOCK (surface_pool);
+
+	g_slist_foreach (unused, (GFunc) pool_buffer_free, NULL);
+	g_slist_free (unused);
+}
+
+/* Same as cairo_format_stride_for_width(), which needs cairo 1.6 */
+static gint
+surface_stride_for_width (cairo_format_t format,
+			  gint           width)
+{
+	gint bpp;
+
+	switch (format) {
+	case CAIRO_FORMAT_ARGB32:
+	case CAIRO_FORMAT_RGB24:
+		bpp = 32;
+		break;
+	case CAIRO_FORMAT_A8:
+		bpp = 8;
+		break;
+	case CAIRO_FORMAT_A1:
+		bpp = 1;
+		break;
+	default:
+		return -1;
+	}
+
+	if (width <= 0 || width > (G_MAXINT - 31) / 32)
+		return -1;
+
+	return (bpp * width + 31) / 32 * 4;
+}
+
+/**
+ * ev_document_misc_surface_new:
+ * @format: the format of the surface
+ * @width: the width of the surface
+ * @height: the height of the surface
+ *
+ * Creates an image surface cleared to 0, like cairo_image_surface_create(),
+ * reusing the memory of the page surfaces destroyed recently when possible.
+ * Backends should use it for the surfaces returned by render.
+ *
+ * Returns: a new image surface
+ */
 cairo_surface_t *
-ev_document_misc_surface_from_pixbuf (GdkPixbuf *pixbuf)
+ev_document_misc_surface_new (cairo_format_t format,
+			      gint           width,
+			      gint           height)
 {
 	cairo_surface_t *surface;
-	cairo_t         *cr;
+	PoolBuffer      *buffer;
+	gint             stride;
+	gsize            size;
+
+	stride = surface_stride_for_width (format, width);
+	if (stride < 0 || height <= 0 || (gsize) height > G_MAXSIZE / stride)
+		return cairo_image_surface_create (format, width, height);
+
+	size = (gsize) stride * height;
+	if (size < SURFACE_POOL_MIN_BUFFER)
+		return cairo_image_surface_create (format, width, height);
+
+	buffer = surface_pool_acquire (surface_pool_size_class (size));
+	if (!buffer)
+		return cairo_image_surface_create (format, width, height);
+
+	memset (buffer->data, 0, size);
+	surface = cairo_image_surface_create_for_data (buffer->data, format,
+						       width, height, stride);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS ||
+	    cairo_surface_set_user_data (surface, &surface_pool_key, buffer,
+					 (cairo_destroy_func_t) surface_pool_release) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (surface);
+		surface_pool_release (buffer);
+
+		return cairo_image_surface_create (format, width, height);
+	}
 
-	surface = cairo_image_surface_create (gdk_pixbuf_get_has_alpha (pixbuf) ?
-					      CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24,
-					      gdk_pixbuf_get_width (pixbuf),
-					      gdk_pixbuf_get_height (pixbuf));
-	cr = cairo_create (surface);
-	gdk_cairo_set_source_pixbuf (cr, pixbuf, 0, 0);
-	cairo_paint (cr);
-	cairo_destroy (cr);
+	return surface;
+}
+
+cairo_surface_t *
+ev_document_misc_surface_from_pixbuf (GdkPixbuf *pixbuf)
+{
+	const EvPixelKernels *kernels = _ev_pixel_kernels_get ();
+	cairo_surface_t      *surface;
+	const guchar         *src;
+	guchar               *dest;
+	gint                  width, height;
+	gint                  src_stride, dest_stride;
+	gint                  n_channels;
+	gint                  y;
+
+	width = gdk_pixbuf_get_width (pixbuf);
+	height = gdk_pixbuf_get_height (pixbuf);
+	n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+	surface = ev_document_misc_surface_new (gdk_pixbuf_get_has_alpha (pixbuf) ?
+						CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24,
+						width, height);
+
+	src = gdk_pixbuf_get_pixels (pixbuf);
+	src_stride = gdk_pixbuf_get_rowstride (pixbuf);
+	dest = cairo_image_surface_get_data (surface);
+	dest_stride = cairo_image_surface_get_stride (surface);
+
+	cairo_surface_flush (surface);
+	for (y = 0; y < height; y++) {
+		kernels->rgba_to_argb32 (src + y * src_stride,
+					 (guint32 *)(dest + y * dest_stride),
+					 width, n_channels);
+	}
+	cairo_surface_mark_dirty (surface);
 	
 	return surface;
 }
@@ -175,75 +428,264 @@ ev_document_misc_surface_from_pixbuf (GdkPixbuf *pixbuf)
 GdkPixbuf *
 ev_document_misc_pixbuf_from_surface (cairo_surface_t *surface)
 {
-	GdkPixbuf       *pixbuf;
-	cairo_surface_t *image;
-	cairo_t         *cr;
-	gboolean         has_alpha;
-	gint             width, height;
-	cairo_format_t   surface_format;
-	gint             pixbuf_n_channels;
-	gint             pixbuf_rowstride;
-	guchar          *pixbuf_pixels;
-	gint             x, y;
+	const EvPixelKernels *kernels = _ev_pixel_kernels_get ();
+	GdkPixbuf            *pixbuf;
+	cairo_surface_t      *image;
+	gint                  width, height;
+	const guchar         *src;
+	gint                  src_stride;
+	guchar               *dest;
+	gint                  dest_stride;
+	gint                  y;
 
 	width = cairo_image_surface_get_width (surface);
 	height = cairo_image_surface_get_height (surface);
-	
-	surface_format = cairo_image_surface_get_format (surface);
-	has_alpha = (surface_format == CAIRO_FORMAT_ARGB32);
+
+	image = ev_document_misc_surface_to_color (surface);
+	cairo_surface_flush (image);
 
 	pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
 				 TRUE, 8,
 				 width, height);
-	pixbuf_n_channels = gdk_pixbuf_get_n_channels (pixbuf);
-	pixbuf_rowstride = gdk_pixbuf_get_rowstride (pixbuf);
-	pixbuf_pixels = gdk_pixbuf_get_pixels (pixbuf);
-
-	image = cairo_image_surface_create_for_data (pixbuf_pixels,
-						     surface_format,
-						     width, height,
-						     pixbuf_rowstride);
-	cr = cairo_create (image);
-	cairo_set_source_surface (cr, surface, 0, 0);
+	dest = gdk_pixbuf_get_pixels (pixbuf);
+	dest_stride = gdk_pixbuf_get_rowstride (pixbuf);
+	src = cairo_image_surface_get_data (image);
+	src_stride = cairo_image_surface_get_stride (image);
 
-	if (has_alpha)
-		cairo_mask_surface (cr, surface, 0, 0);
-	else
-		cairo_paint (cr);
+	for (y = 0; y < height; y++) {
+		kernels->argb32_to_rgba ((const guint32 *)(src + y * src_stride),
+					 dest + y * dest_stride,
+					 width,
+					 cairo_image_surface_get_format (image) == CAIRO_FORMAT_ARGB32);
+	}
 
-	cairo_destroy (cr);
 	cairo_surface_destroy (image);
 
-	for (y = 0; y < height; y++) {
-		guchar *p = pixbuf_pixels + y * pixbuf_rowstride;
-
-		for (x = 0; x < width; x++) {
-			guchar tmp;
-			
-#if G_BYTE_ORDER == G_LITTLE_ENDIAN
-			tmp = p[0];
-			p[0] = p[2];
-			p[2] = tmp;
-			p[3] = (has_alpha) ? p[3] : 0xff;
-#else
-			tmp = p[0];
-			p[0] = p[1];
-			p[1] = p[2];
-			p[2] = p[3];
-			p[3] = (has_alpha) ? tmp : 0xff;
-#endif			
-			p += pixbuf_n_channels;
+	return pixbuf;
+}
+
+/* Box filter: every destination pixel is the average of the source
+ * pixels it covers. Only meant for downscaling image surfaces.
+ */
+GdkPixbuf *
+ev_document_misc_pixbuf_from_surface_scaled (cairo_surface_t *surface,
+					     gint             dest_width,
+					     gint             dest_height)
+{
+	const EvPixelKernels *kernels = _ev_pixel_kernels_get ();
+	GdkPixbuf *pixbuf;
+	gboolean   has_alpha;
+	guchar    *src_data;
+	gint       src_width, src_height;
+	gint       src_stride;
+	guchar    *dest_data;
+	gint       dest_stride;
+	guint32   *sums;
+	gint      *x_bounds;
+	gint       dest_x, dest_y;
+	gint       y;
+
+	surface = ev_document_misc_surface_to_color (surface);
+
+	src_width = cairo_image_surface_get_width (surface);
+	src_height = cairo_image_surface_get_height (surface);
+	src_stride = cairo_image_surface_get_stride (surface);
+	src_data = cairo_image_surface_get_data (surface);
+	has_alpha = cairo_image_surface_get_format (surface) == CAIRO_FORMAT_ARGB32;
+
+	dest_width = CLAMP (dest_width, 1, src_width);
+	dest_height = CLAMP (dest_height, 1, src_height);
+
+	pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+				 dest_width, dest_height);
+	dest_data = gdk_pixbuf_get_pixels (pixbuf);
+	dest_stride = gdk_pixbuf_get_rowstride (pixbuf);
+
+	cairo_surface_flush (surface);
+
+	x_bounds = g_new (gint, dest_width + 1);
+	for (dest_x = 0; dest_x <= dest_width; dest_x++)
+		x_bounds[dest_x] = (gint64)dest_x * src_width / dest_width;
+
+	sums = g_new (guint32, dest_width * 4);
+
+	for (dest_y = 0; dest_y < dest_height; dest_y++) {
+		gint    y0 = (gint64)dest_y * src_height / dest_height;
+		gint    y1 = (gint64)(dest_y + 1) * src_height / dest_height;
+		guchar *q = dest_data + dest_y * dest_stride;
+
+		memset (sums, 0, dest_width * 4 * sizeof (guint32));
+
+		for (y = y0; y < y1; y++) {
+			kernels->box_accumulate ((const guint32 *)(src_data + y * src_stride),
+						 x_bounds, dest_width, sums);
+		}
+
+		for (dest_x = 0; dest_x < dest_width; dest_x++) {
+			guint32 *sum = sums + dest_x * 4;
+			guint32  n = (x_bounds[dest_x + 1] - x_bounds[dest_x]) * (y1 - y0);
+			guint32  a = has_alpha ? (sum[3] + n / 2) / n : 0xff;
+
+			if (has_alpha && a > 0 && a < 0xff) {
+				/* Cairo stores premultiplied colors */
+				q[0] = MIN ((sum[0] * 0xff + sum[3] / 2) / sum[3], 0xff);
+				q[1] = MIN ((sum[1] * 0xff + sum[3] / 2) / sum[3], 0xff);
+				q[2] = MIN ((sum[2] * 0xff + sum[3] / 2) / sum[3], 0xff);
+			} else {
+				q[0] = (sum[0] + n / 2) / n;
+				q[1] = (sum[1] + n / 2) / n;
+				q[2] = (sum[2] + n / 2) / n;
+			}
+			q[3] = a;
+			q += 4;
 		}
 	}
 
+	g_free (sums);
+	g_free (x_bounds);
+	cairo_surface_destroy (surface);
+
 	return pixbuf;
 }
 
+/* Pixels are copied in square blocks, so that the rows of the
+ * destination a block is written to stay in the CPU cache while
+ * reading rows of the source. 32 x 32 ARGB32 pixels are 4KB.
+ */
+#define ROTATE_BLOCK_SIZE 32
+
+/* Rotates width x height pixels of bpp bytes clockwise by rotation
+ * degrees, into dest which must have room for the rotated size.
+ */
+static void
+rotate_pixels (const guchar *src,
+	       gint          src_stride,
+	       guchar       *dest,
+	       gint          dest_stride,
+	       gint          bpp,
+	       gint          width,
+	       gint          height,
+	       gint          rotation)
+{
+	gssize origin, dx, dy;
+	gint   bx, by, x, y;
+
+	/* Offset in dest of the source pixel (x, y) is
+	 * origin + x * dx + y * dy
+	 */
+	switch (rotation) {
+	case 90:
+		origin = (gssize)(height - 1) * bpp;
+		dx = dest_stride;
+		dy = -bpp;
+		break;
+	case 180:
+		origin = (gssize)(height - 1) * dest_stride + (gssize)(width - 1) * bpp;
+		dx = -bpp;
+		dy = -dest_stride;
+		break;
+	default: /* 270 */
+		origin = (gssize)(width - 1) * dest_stride;
+		dx = -dest_stride;
+		dy = bpp;
+	}
+
+	for (by = 0; by < height; by += ROTATE_BLOCK_SIZE) {
+		gint y_end = MIN (by + ROTATE_BLOCK_SIZE, height);
+
+		for (bx = 0; bx < width; bx += ROTATE_BLOCK_SIZE) {
+			gint x_end = MIN (bx + ROTATE_BLOCK_SIZE, width);
+
+			for (y = by; y < y_end; y++) {
+				const guchar *p = src + (gssize)y * src_stride + bx * bpp;
+				guchar       *q = dest + origin + bx * dx + y * dy;
+
+				if (bpp == 4) {
+					for (x = bx; x < x_end; x++, p += 4, q += dx)
+						*(guint32 *)q = *(const guint32 *)p;
+				} else {
+					for (x = bx; x < x_end; x++, p++, q += dx)
+						*q = *p;
+				}
+			}
+		}
+	}
+}
+
+/* Returns surface rotated by a multiple of 90 degrees, or NULL if
+ * its format can't be rotated by permuting whole bytes.
+ */
+static cairo_surface_t *
+surface_rotate (cairo_surface_t *surface,
+		gint             rotation)
+{
+	cairo_surface_t *new_surface;
+	cairo_format_t   format;
+	gint             width, height;
+	gint             bpp;
+
+	if (rotation != 90 && rotation != 180 && rotation != 270)
+		return NULL;
+
+	format = cairo_image_surface_get_format (surface);
+	switch (format) {
+	case CAIRO_FORMAT_ARGB32:
+	case CAIRO_FORMAT_RGB24:
+		bpp = 4;
+		break;
+	case CAIRO_FORMAT_A8:
+		bpp = 1;
+		break;
+	default:
+		return NULL;
+	}
+
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+
+	if (rotation == 90 || rotation == 270)
+		new_surface = ev_document_misc_surface_new (format, height, width);
+	else
+		new_surface = ev_document_misc_surface_new (format, width, height);
+	if (cairo_surface_status (new_surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (new_surface);
+		return NULL;
+	}
+
+	cairo_surface_flush (surface);
+	cairo_surface_flush (new_surface);
+	rotate_pixels (cairo_image_surface_get_data (surface),
+		       cairo_image_surface_get_stride (surface),
+		       cairo_image_surface_get_data (new_surface),
+		       cairo_image_surface_get_stride (new_surface),
+		       bpp, width, height, rotation);
+	cairo_surface_mark_dirty (new_surface);
+
+	return new_surface;
+}
+
 cairo_surface_t *
 ev_document_misc_surface_rotate_and_scale (cairo_surface_t *surface,
 					   gint             dest_width,
 					   gint             dest_height,
 					   gint             dest_rotation)
+{
+	return ev_document_misc_surface_rotate_and_scale_full (surface,
+							       dest_width,
+							       dest_height,
+							       dest_rotation,
+							       CAIRO_FILTER_GOOD);
+}
+
+/* Like ev_document_misc_surface_rotate_and_scale(), using filter to
+ * scale the surface. Backends use CAIRO_FILTER_FAST for draft renders.
+ */
+cairo_surface_t *
+ev_document_misc_surface_rotate_and_scale_full (cairo_surface_t *surface,
+						gint             dest_width,
+						gint             dest_height,
+						gint             dest_rotation,
+						cairo_filter_t   filter)
 {
 	cairo_surface_t *new_surface;
 	cairo_t         *cr;
@@ -265,11 +707,70 @@ ev_document_misc_surface_rotate_and_scale (cairo_surface_t *surface,
 		new_height = dest_width;
 	}
 
-	new_surface = cairo_surface_create_similar (surface,
-						    cairo_surface_get_content (surface),
-						    new_width, new_height);
+	/* Rotating without scaling just moves the pixels around */
+	if (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE &&
+	    dest_width == width && dest_height == height) {
+		new_surface = surface_rotate (surface, dest_rotation);
+		if (new_surface)
+			return new_surface;
+	}
+
+	if (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE) {
+		cairo_format_t format;
+
+		/* Same formats cairo_surface_create_similar() would use */
+		switch (cairo_surface_get_content (surface)) {
+		case CAIRO_CONTENT_COLOR:
+			format = CAIRO_FORMAT_RGB24;
+			break;
+		case CAIRO_CONTENT_ALPHA:
+			format = CAIRO_FORMAT_A8;
+			break;
+		default:
+			format = CAIRO_FORMAT_ARGB32;
+		}
+		new_surface = ev_document_misc_surface_new (format, new_width, new_height);
+	} else {
+		new_surface = cairo_surface_create_similar (surface,
+							    cairo_surface_get_content (surface),
+							    new_width, new_height);
+	}
 
 	cr = cairo_create (new_surface);
+	ev_document_misc_paint_surface_scaled (cr, surface,
+					       dest_width, dest_height,
+					       dest_rotation, filter);
+	cairo_destroy (cr);
+
+	return new_surface;
+}
+
+/* Paints surface at the origin of cr, scaled to dest_width x dest_height
+ * and then rotated, like ev_document_misc_surface_rotate_and_scale() does.
+ */
+void
+ev_document_misc_paint_surface_scaled (cairo_t         *cr,
+				       cairo_surface_t *surface,
+				       gint             dest_width,
+				       gint             dest_height,
+				       gint             dest_rotation,
+				       cairo_filter_t   filter)
+{
+	cairo_pattern_t *pattern;
+	gint             width, height;
+	gint             new_width = dest_width;
+	gint             new_height = dest_height;
+
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+
+	if (dest_rotation == 90 || dest_rotation == 270) {
+		new_width = dest_height;
+		new_height = dest_width;
+	}
+
+	cairo_save (cr);
+
 	switch (dest_rotation) {
 	        case 90:
 			cairo_translate (cr, new_width, 0);
@@ -285,13 +786,72 @@ ev_document_misc_surface_rotate_and_scale (cairo_surface_t *surface,
 	}
 	
 	if (dest_width != width || dest_height != height) {
-		cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_BILINEAR);
 		cairo_scale (cr,
 			     (gdouble)dest_width / width,
 			     (gdouble)dest_height / height);
 	}
 	
 	cairo_rotate (cr, dest_rotation * G_PI / 180.0);
+
+	pattern = cairo_pattern_create_for_surface (surface);
+	cairo_pattern_set_filter (pattern, filter);
+	if (ev_document_misc_surface_is_monochrome (surface)) {
+		cairo_set_source_rgb (cr, 0., 0., 0.);
+		cairo_mask (cr, pattern);
+	} else {
+		cairo_set_source (cr, pattern);
+		cairo_paint (cr);
+	}
+	cairo_pattern_destroy (pattern);
+
+	cairo_restore (cr);
+}
+
+cairo_surface_t *
+ev_document_misc_surface_copy (cairo_surface_t *surface)
+{
+	cairo_surface_t *new_surface;
+	cairo_t         *cr;
+
+	/* Image surfaces are copied as they are, keeping their format */
+	if (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE) {
+		const guchar *src;
+		guchar       *dest;
+		gint          src_stride, dest_stride;
+		gint          height;
+		gint          y;
+
+		new_surface = ev_document_misc_surface_new (cairo_image_surface_get_format (surface),
+							    cairo_image_surface_get_width (surface),
+							    cairo_image_surface_get_height (surface));
+		cairo_surface_flush (surface);
+		cairo_surface_flush (new_surface);
+
+		src = cairo_image_surface_get_data (surface);
+		src_stride = cairo_image_surface_get_stride (surface);
+		dest = cairo_image_surface_get_data (new_surface);
+		dest_stride = cairo_image_surface_get_stride (new_surface);
+		height = cairo_image_surface_get_height (surface);
+
+		if (src_stride == dest_stride) {
+			memcpy (dest, src, src_stride * height);
+		} else {
+			for (y = 0; y < height; y++)
+				memcpy (dest + y * dest_stride, src + y * src_stride,
+					MIN (src_stride, dest_stride));
+		}
+		cairo_surface_mark_dirty (new_surface);
+
+		return new_surface;
+	}
+
+	new_surface = cairo_surface_create_similar (surface,
+						    cairo_surface_get_content (surface),
+						    cairo_image_surface_get_width (surface),
+						    cairo_image_surface_get_height (surface));
+
+	cr = cairo_create (new_surface);
+	cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
 	cairo_set_source_surface (cr, surface, 0, 0);
 	cairo_paint (cr);
 	cairo_destroy (cr);
@@ -299,6 +859,73 @@ ev_document_misc_surface_rotate_and_scale (cairo_surface_t *surface,
 	return new_surface;
 }
 
+/* Monochrome pages are stored as A8 or A1 surfaces holding the ink
+ * coverage, they are painted in black over the white page.
+ */
+gboolean
+ev_document_misc_surface_is_monochrome (cairo_surface_t *surface)
+{
+	cairo_format_t format;
+
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return FALSE;
+
+	format = cairo_image_surface_get_format (surface);
+
+	return format == CAIRO_FORMAT_A8 || format == CAIRO_FORMAT_A1;
+}
+
+/* Returns a new reference to surface if it is an ARGB32 or RGB24 image
+ * surface, or a new RGB24 (ARGB32 for non monochrome formats) copy
+ * otherwise.
+ */
+cairo_surface_t *
+ev_document_misc_surface_to_color (cairo_surface_t *surface)
+{
+	cairo_surface_t *new_surface;
+	cairo_format_t   format;
+	cairo_t         *cr;
+
+	format = cairo_image_surface_get_format (surface);
+	if (format == CAIRO_FORMAT_ARGB32 || format == CAIRO_FORMAT_RGB24)
+		return cairo_surface_reference (surface);
+
+	if (ev_document_misc_surface_is_monochrome (surface)) {
+		new_surface = ev_document_misc_surface_new (CAIRO_FORMAT_RGB24,
+							    cairo_image_surface_get_width (surface),
+							    cairo_image_surface_get_height (surface));
+		cr = cairo_create (new_surface);
+		cairo_set_source_rgb (cr, 1., 1., 1.);
+		cairo_paint (cr);
+	} else {
+		new_surface = ev_document_misc_surface_new (CAIRO_FORMAT_ARGB32,
+							    cairo_image_surface_get_width (surface),
+							    cairo_image_surface_get_height (surface));
+		cr = cairo_create (new_surface);
+	}
+
+	ev_document_misc_paint_surface (cr, surface);
+	cairo_destroy (cr);
+
+	return new_surface;
+}
+
+/* Paints surface at the origin of cr, the page background must have
+ * already been painted for monochrome surfaces.
+ */
+void
+ev_document_misc_paint_surface (cairo_t         *cr,
+				cairo_surface_t *surface)
+{
+	if (ev_document_misc_surface_is_monochrome (surface)) {
+		cairo_set_source_rgb (cr, 0., 0., 0.);
+		cairo_mask_surface (cr, surface, 0, 0);
+	} else {
+		cairo_set_source_surface (cr, surface, 0, 0);
+		cairo_paint (cr);
+	}
+}
+
 void
 ev_document_misc_invert_surface (cairo_surface_t *surface) {
 #if CAIRO_VERSION > CAIRO_VERSION_ENCODE(1, 9, 2)
@@ -312,26 +939,22 @@ ev_document_misc_invert_surface (cairo_surface_t *surface) {
 	cairo_paint(cr);
 	cairo_destroy (cr);
 #else
-	guchar *data;
-	gint    rowstride;
-	gint    width, height;
-	gint    x, y;
+	const EvPixelKernels *kernels = _ev_pixel_kernels_get ();
+	guchar               *data;
+	gint                  rowstride;
+	gint                  width, height;
+	gint                  y;
+
+	cairo_surface_flush (surface);
 
 	data = cairo_image_surface_get_data (surface);
 	rowstride = cairo_image_surface_get_stride (surface);
 	width = cairo_image_surface_get_width (surface);
 	height = cairo_image_surface_get_height (surface);
 
-	for (y = 0; y < height; y++) {
-		guchar *p = data + y * rowstride;
-
-		for (x = 0; x < width; x++) {
-			p[0] = 255 - p[0];
-			p[1] = 255 - p[1];
-			p[2] = 255 - p[2];
-			p += 4;
-		}
-	}
+	/* Invert the color channels of the native endian pixels */
+	for (y = 0; y < height; y++)
+		kernels->invert (data + y * rowstride, width * 4, 0x00ffffff);
 
 	cairo_surface_mark_dirty (surface);
 #endif
@@ -340,8 +963,10 @@ ev_document_misc_invert_surface (cairo_surface_t *surface) {
 void
 ev_document_misc_invert_pixbuf (GdkPixbuf *pixbuf)
 {
-	guchar *data, *p;
-	guint   width, height, x, y, rowstride, n_channels;
+	const EvPixelKernels *kernels = _ev_pixel_kernels_get ();
+	guchar               *data;
+	guint                 width, height, y, rowstride, n_channels;
+	guint32               mask;
 
 	n_channels = gdk_pixbuf_get_n_channels (pixbuf);
 	g_assert (gdk_pixbuf_get_colorspace (pixbuf) == GDK_COLORSPACE_RGB);
@@ -355,16 +980,11 @@ ev_document_misc_invert_pixbuf (GdkPixbuf *pixbuf)
 
 	width = gdk_pixbuf_get_width (pixbuf);
 	height = gdk_pixbuf_get_height (pixbuf);
-	for (x = 0; x < width; x++) {
-		for (y = 0; y < height; y++) {
-			/* Calculate pixel's offset into the data array. */
-			p = data + x * n_channels + y * rowstride;
-			/* Change the RGB values*/
-			p[0] = 255 - p[0];
-			p[1] = 255 - p[1];
-			p[2] = 255 - p[2];
-		}
-	}
+
+	/* Change the RGB values, leaving the alpha channel untouched */
+	mask = n_channels == 4 ? GUINT32_FROM_BE (0xffffff00) : 0xffffffff;
+	for (y = 0; y < height; y++)
+		kernels->invert (data + y * rowstride, width * n_channels, mask);
 }
 
 gdouble
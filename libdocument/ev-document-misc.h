@@ -45,12 +45,34 @@ void       ev_document_misc_paint_one_page       (GdkDrawable  *drawable,
 						  GtkBorder    *border,
 						  gboolean      highlight);
 
+cairo_surface_t *ev_document_misc_surface_new         (cairo_format_t format,
+						       gint           width,
+						       gint           height);
 cairo_surface_t *ev_document_misc_surface_from_pixbuf (GdkPixbuf *pixbuf);
 GdkPixbuf       *ev_document_misc_pixbuf_from_surface (cairo_surface_t *surface);
+GdkPixbuf       *ev_document_misc_pixbuf_from_surface_scaled (cairo_surface_t *surface,
+							      gint             dest_width,
+							      gint             dest_height);
 cairo_surface_t *ev_document_misc_surface_rotate_and_scale (cairo_surface_t *surface,
 							    gint             dest_width,
 							    gint             dest_height,
 							    gint             dest_rotation);
+cairo_surface_t *ev_document_misc_surface_rotate_and_scale_full (cairo_surface_t *surface,
+								 gint             dest_width,
+								 gint             dest_height,
+								 gint             dest_rotation,
+								 cairo_filter_t   filter);
+void             ev_document_misc_paint_surface_scaled (cairo_t         *cr,
+							cairo_surface_t *surface,
+							gint             dest_width,
+							gint             dest_height,
+							gint             dest_rotation,
+							cairo_filter_t   filter);
+cairo_surface_t *ev_document_misc_surface_copy (cairo_surface_t *surface);
+gboolean         ev_document_misc_surface_is_monochrome (cairo_surface_t *surface);
+cairo_surface_t *ev_document_misc_surface_to_color      (cairo_surface_t *surface);
+void             ev_document_misc_paint_surface         (cairo_t         *cr,
+							 cairo_surface_t *surface);
 void             ev_document_misc_invert_surface (cairo_surface_t *surface);
 void		 ev_document_misc_invert_pixbuf  (GdkPixbuf       *pixbuf);
 
@@ -25,10 +25,17 @@
 #include <string.h>
 
 #include "ev-document.h"
+#include "ev-document-misc.h"
 #include "synctex_parser.h"
 
 #define EV_DOCUMENT_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), EV_TYPE_DOCUMENT, EvDocumentPrivate))
 
+/* Number of EvPage objects kept alive by the document so that
+ * render, page data, thumbnail and find jobs for the same page
+ * share the backend page instead of creating a new one each time.
+ */
+#define EV_DOCUMENT_PAGE_CACHE_SIZE 8
+
 typedef struct _EvPageSize
 {
 	gdouble width;
@@ -54,9 +61,15 @@ struct _EvDocumentPrivate
 	EvDocumentInfo *info;
 
 	synctex_scanner_t synctex_scanner;
+
+	/* Most recently used pages first */
+	GQueue          page_cache;
+	GMutex         *page_cache_mutex;
 };
 
 static gint            _ev_document_get_n_pages   (EvDocument  *document);
+static EvPage         *_ev_document_get_page      (EvDocument  *document,
+						   gint         index);
 static void            _ev_document_get_page_size (EvDocument *document,
 						   EvPage     *page,
 						   double     *width,
@@ -93,11 +106,37 @@ ev_document_impl_get_info (EvDocument *document)
 	return g_new0 (EvDocumentInfo, 1);
 }
 
+static void
+ev_document_page_cache_clear (EvDocument *document)
+{
+	EvDocumentPrivate *priv = document->priv;
+	EvPage            *page;
+
+	g_mutex_lock (priv->page_cache_mutex);
+	while ((page = g_queue_pop_head (&priv->page_cache)))
+		g_object_unref (page);
+	g_mutex_unlock (priv->page_cache_mutex);
+}
+
+/* Cached pages might hold backend objects, they must be released
+ * before the backend document is torn down, which backends do in
+ * their dispose or finalize handlers.
+ */
+static void
+ev_document_dispose (GObject *object)
+{
+	ev_document_page_cache_clear (EV_DOCUMENT (object));
+
+	G_OBJECT_CLASS (ev_document_parent_class)->dispose (object);
+}
+
 static void
 ev_document_finalize (GObject *object)
 {
 	EvDocument *document = EV_DOCUMENT (object);
 
+	g_mutex_free (document->priv->page_cache_mutex);
+
 	if (document->priv->uri) {
 		g_free (document->priv->uri);
 		document->priv->uri = NULL;
@@ -136,6 +175,9 @@ ev_document_init (EvDocument *document)
 
 	/* Assume all pages are the same size until proven otherwise */
 	document->priv->uniform = TRUE;
+
+	g_queue_init (&document->priv->page_cache);
+	document->priv->page_cache_mutex = g_mutex_new ();
 }
 
 static gboolean
@@ -144,6 +186,43 @@ ev_document_impl_synctex_enabled (EvDocument *doc)
 	return FALSE;
 }
 
+static gboolean
+ev_document_impl_is_thread_safe (EvDocument *document)
+{
+	return FALSE;
+}
+
+/* Backends that can't draw into a cairo context render the page
+ * and paint the resulting surface.
+ */
+static gboolean
+ev_document_impl_render_to (EvDocument      *document,
+			    EvRenderContext *rc,
+			    cairo_t         *cr)
+{
+	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+	cairo_surface_t *surface;
+
+	surface = klass->render (document, rc);
+	if (!surface)
+		return FALSE;
+
+	cairo_save (cr);
+	if (ev_document_misc_surface_is_monochrome (surface)) {
+		cairo_set_source_rgb (cr, 1., 1., 1.);
+		cairo_rectangle (cr, 0, 0,
+				 cairo_image_surface_get_width (surface),
+				 cairo_image_surface_get_height (surface));
+		cairo_fill (cr);
+	}
+	ev_document_misc_paint_surface (cr, surface);
+	cairo_restore (cr);
+
+	cairo_surface_destroy (surface);
+
+	return TRUE;
+}
+
 static void
 ev_document_class_init (EvDocumentClass *klass)
 {
@@ -155,7 +234,10 @@ ev_document_class_init (EvDocumentClass *klass)
 	klass->get_info = ev_document_impl_get_info;
 	klass->get_backend_info = NULL;
 	klass->synctex_enabled = ev_document_impl_synctex_enabled;
+	klass->render_to = ev_document_impl_render_to;
+	klass->is_thread_safe = ev_document_impl_is_thread_safe;
 
+	g_object_class->dispose = ev_document_dispose;
 	g_object_class->finalize = ev_document_finalize;
 }
 
@@ -234,11 +316,40 @@ gboolean
 ev_document_load (EvDocument  *document,
 		  const char  *uri,
 		  GError     **error)
+{
+	return ev_document_load_full (document, uri, EV_DOCUMENT_LOAD_FLAG_NONE, error);
+}
+
+/**
+ * ev_document_load_full:
+ * @document: a #EvDocument
+ * @uri: the document's URI
+ * @flags: a set of #EvDocumentLoadFlags
+ * @error: a #GError location to store an error, or %NULL
+ *
+ * Loads @document from @uri like ev_document_load().
+ *
+ * With %EV_DOCUMENT_LOAD_FLAG_FIRST_PAGE only the first page is
+ * inspected after loading, so the cost doesn't depend on the number
+ * of pages. This is meant for tools rendering just the first page,
+ * like thumbnailers: every page reports the size of the first one,
+ * there are no page labels, and the document info is empty.
+ *
+ * Returns: %TRUE on success, or %FALSE on failure.
+ */
+gboolean
+ev_document_load_full (EvDocument         *document,
+		       const char         *uri,
+		       EvDocumentLoadFlags flags,
+		       GError            **error)
 {
 	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
 	gboolean retval;
 	GError *err = NULL;
 
+	/* Pages from a previous load are no longer valid */
+	ev_document_page_cache_clear (document);
+
 	retval = klass->load (document, uri, &err);
 	if (!retval) {
 		if (err) {
@@ -254,7 +365,7 @@ ev_document_load (EvDocument  *document,
 					     "Internal error in backend");
 		}
 	} else {
-		gint i;
+		gint i, n_scanned_pages;
 		EvDocumentPrivate *priv = document->priv;
 
 		/* Cache some info about the document to avoid
@@ -263,8 +374,14 @@ ev_document_load (EvDocument  *document,
 		priv->uri = g_strdup (uri);
 		priv->n_pages = _ev_document_get_n_pages (document);
 
-		for (i = 0; i < priv->n_pages; i++) {
-			EvPage     *page = ev_document_get_page (document, i);
+		n_scanned_pages = (flags & EV_DOCUMENT_LOAD_FLAG_FIRST_PAGE) ?
+			MIN (priv->n_pages, 1) : priv->n_pages;
+
+		/* Don't go through the page cache here, walking
+		 * the whole document would only thrash it
+		 */
+		for (i = 0; i < n_scanned_pages; i++) {
+			EvPage     *page = _ev_document_get_page (document, i);
 			gdouble     page_width = 0;
 			gdouble     page_height = 0;
 			EvPageSize *page_size;
@@ -305,7 +422,11 @@ ev_document_load (EvDocument  *document,
 					priv->max_height = page_height;
 			}
 
-			page_label = _ev_document_get_page_label (document, page);
+			/* A label for the first page only would be
+			 * inconsistent with the other pages
+			 */
+			page_label = (flags & EV_DOCUMENT_LOAD_FLAG_FIRST_PAGE) ?
+				NULL : _ev_document_get_page_label (document, page);
 			if (page_label) {
 				if (!priv->page_labels)
 					priv->page_labels = g_new0 (gchar *, priv->n_pages);
@@ -318,6 +439,11 @@ ev_document_load (EvDocument  *document,
 			g_object_unref (page);
 		}
 
+		if (flags & EV_DOCUMENT_LOAD_FLAG_FIRST_PAGE) {
+			priv->info = g_new0 (EvDocumentInfo, 1);
+			return retval;
+		}
+
 		priv->info = _ev_document_get_info (document);
 		if (klass->synctex_enabled(document)) {
 			gchar *filename;
@@ -353,13 +479,60 @@ ev_document_save (EvDocument  *document,
 	return klass->save (document, uri, error);
 }
 
+static EvPage *
+_ev_document_get_page (EvDocument *document,
+		       gint        index)
+{
+	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+
+	return klass->get_page (document, index);
+}
+
+/**
+ * ev_document_get_page:
+ * @document: a #EvDocument
+ * @index: the page index
+ *
+ * Gets the #EvPage for @index. The document keeps a small cache of
+ * recently used pages, so that consecutive calls for the same page
+ * return the same object and the backend page is created only once.
+ *
+ * Returns: a new reference to the #EvPage, unref it when done.
+ */
 EvPage *
 ev_document_get_page (EvDocument *document,
 		      gint        index)
 {
-	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+	EvDocumentPrivate *priv = document->priv;
+	EvPage            *page = NULL;
+	GList             *l;
 
-	return klass->get_page (document, index);
+	g_mutex_lock (priv->page_cache_mutex);
+
+	for (l = priv->page_cache.head; l; l = g_list_next (l)) {
+		if (EV_PAGE (l->data)->index == index) {
+			page = EV_PAGE (l->data);
+			if (l != priv->page_cache.head) {
+				g_queue_unlink (&priv->page_cache, l);
+				g_queue_push_head_link (&priv->page_cache, l);
+			}
+			break;
+		}
+	}
+
+	if (!page) {
+		page = _ev_document_get_page (document, index);
+		g_queue_push_head (&priv->page_cache, page);
+
+		if (g_queue_get_length (&priv->page_cache) > EV_DOCUMENT_PAGE_CACHE_SIZE)
+			g_object_unref (g_queue_pop_tail (&priv->page_cache));
+	}
+
+	g_object_ref (page);
+
+	g_mutex_unlock (priv->page_cache_mutex);
+
+	return page;
 }
 
 gboolean
@@ -553,6 +726,66 @@ ev_document_render (EvDocument      *document,
 	return klass->render (document, rc);
 }
 
+/**
+ * ev_document_render_to:
+ * @document: an #EvDocument
+ * @rc: an #EvRenderContext
+ * @cr: a cairo context
+ *
+ * Renders the page of @rc into @cr, at the origin of its user space.
+ * The result is the same as painting the surface returned by
+ * ev_document_render(), with monochrome pages painted in black over
+ * a white page. Only the area inside the clip of @cr is guaranteed
+ * to be drawn.
+ *
+ * This allows rendering straight into a buffer owned by the caller,
+ * using cairo_image_surface_create_for_data(), instead of copying
+ * the surface returned by ev_document_render().
+ *
+ * Like ev_document_render(), it must be called with the document
+ * mutex held, see ev_document_doc_mutex_lock(), unless
+ * ev_document_is_thread_safe() returns %TRUE and no other thread
+ * uses @document. The fontconfig mutex must not be held, backends
+ * that need it take it themselves.
+ *
+ * Returns: %TRUE on success, %FALSE if the page couldn't be rendered,
+ * as when ev_document_render() returns %NULL
+ */
+gboolean
+ev_document_render_to (EvDocument      *document,
+		       EvRenderContext *rc,
+		       cairo_t         *cr)
+{
+	EvDocumentClass *klass = EV_DOCUMENT_GET_CLASS (document);
+
+	return klass->render_to (document, rc, cr);
+}
+
+/**
+ * ev_document_is_thread_safe:
+ * @document: an #EvDocument
+ *
+ * Whether the backend of @document keeps no state shared between
+ * documents, so that different documents of this backend can be used
+ * from different threads at the same time without holding the
+ * document mutex. A single document must still be used from one
+ * thread at a time.
+ *
+ * Returns: %TRUE if documents of this backend can be rendered
+ * concurrently
+ */
+gboolean
+ev_document_is_thread_safe (EvDocument *document)
+{
+	EvDocumentClass *klass;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), FALSE);
+
+	klass = EV_DOCUMENT_GET_CLASS (document);
+
+	return klass->is_thread_safe (document);
+}
+
 const gchar *
 ev_document_get_uri (EvDocument *document)
 {
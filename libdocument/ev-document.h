@@ -59,6 +59,12 @@ typedef enum
         EV_DOCUMENT_ERROR_ENCRYPTED
 } EvDocumentError;
 
+typedef enum
+{
+	EV_DOCUMENT_LOAD_FLAG_NONE       = 0,
+	EV_DOCUMENT_LOAD_FLAG_FIRST_PAGE = 1 << 0
+} EvDocumentLoadFlags;
+
 typedef struct {
         double x;
         double y;
@@ -112,6 +118,10 @@ struct _EvDocumentClass
         gboolean          (* get_backend_info)(EvDocument      *document,
                                                EvDocumentBackendInfo *info);
         gboolean	  (* synctex_enabled) (EvDocument      *document);
+        gboolean          (* render_to)       (EvDocument      *document,
+                                               EvRenderContext *rc,
+                                               cairo_t         *cr);
+        gboolean          (* is_thread_safe)  (EvDocument      *document);
 };
 
 GType            ev_document_get_type             (void) G_GNUC_CONST;
@@ -135,6 +145,10 @@ gboolean         ev_document_get_backend_info     (EvDocument      *document,
 gboolean         ev_document_load                 (EvDocument      *document,
 						   const char      *uri,
 						   GError         **error);
+gboolean         ev_document_load_full            (EvDocument      *document,
+						   const char      *uri,
+						   EvDocumentLoadFlags flags,
+						   GError         **error);
 gboolean         ev_document_save                 (EvDocument      *document,
 						   const char      *uri,
 						   GError         **error);
@@ -149,6 +163,10 @@ gchar           *ev_document_get_page_label       (EvDocument      *document,
 						   gint             page_index);
 cairo_surface_t *ev_document_render               (EvDocument      *document,
 						   EvRenderContext *rc);
+gboolean         ev_document_render_to            (EvDocument      *document,
+						   EvRenderContext *rc,
+						   cairo_t         *cr);
+gboolean         ev_document_is_thread_safe       (EvDocument      *document);
 const gchar     *ev_document_get_uri              (EvDocument      *document);
 const gchar     *ev_document_get_title            (EvDocument      *document);
 gboolean         ev_document_is_page_size_uniform (EvDocument      *document);
@@ -0,0 +1,651 @@
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "ev-pixel-kernels.h"
+
+/* SIMD implementations are only built for little endian targets, where
+ * the bytes of a cairo pixel are B, G, R, A in memory.
+ */
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#if defined(__SSE2__)
+#define HAVE_SSE2_KERNELS 1
+#include <emmintrin.h>
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) || defined(__clang__))
+#define HAVE_AVX2_KERNELS 1
+#include <immintrin.h>
+#endif
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define HAVE_NEON_KERNELS 1
+#include <arm_neon.h>
+#endif
+#endif
+
+/* Scalar reference */
+
+/* Unpremultiplies in single precision: both operands are exact and the
+ * division is correctly rounded, so vector units give the same result.
+ */
+static inline guint
+unpremultiply (guint c,
+	       guint a)
+{
+	guint v = (gfloat)(c * 255) / (gfloat)a + 0.5f;
+
+	return MIN (v, 255);
+}
+
+/* Rounded c * a / 255 */
+static inline guint
+premultiply (guint c,
+	     guint a)
+{
+	guint t = c * a + 128;
+
+	return (t + (t >> 8)) >> 8;
+}
+
+static void
+argb32_to_rgba_scalar (const guint32 *src,
+		       guchar        *dest,
+		       gint           n_pixels,
+		       gboolean       has_alpha)
+{
+	gint i;
+
+	for (i = 0; i < n_pixels; i++) {
+		guint32 p = src[i];
+		guint   a = has_alpha ? p >> 24 : 0xff;
+		guint   r = (p >> 16) & 0xff;
+		guint   g = (p >> 8) & 0xff;
+		guint   b = p & 0xff;
+
+		if (a == 0) {
+			r = g = b = 0;
+		} else if (a != 0xff) {
+			r = unpremultiply (r, a);
+			g = unpremultiply (g, a);
+			b = unpremultiply (b, a);
+		}
+
+		dest[0] = r;
+		dest[1] = g;
+		dest[2] = b;
+		dest[3] = a;
+		dest += 4;
+	}
+}
+
+static void
+rgba_to_argb32_scalar (const guchar *src,
+		       guint32      *dest,
+		       gint          n_pixels,
+		       gint          n_channels)
+{
+	gint i;
+
+	for (i = 0; i < n_pixels; i++) {
+		guint r = src[0];
+		guint g = src[1];
+		guint b = src[2];
+		guint a = n_channels == 4 ? src[3] : 0xff;
+
+		if (a != 0xff) {
+			r = premultiply (r, a);
+			g = premultiply (g, a);
+			b = premultiply (b, a);
+		}
+
+		dest[i] = (a << 24) | (r << 16) | (g << 8) | b;
+		src += n_channels;
+	}
+}
+
+static void
+invert_scalar (guchar  *data,
+	       gsize    n_bytes,
+	       guint32  mask)
+{
+	guchar m[4];
+	gsize  i;
+
+	memcpy (m, &mask, sizeof (m));
+	for (i = 0; i < n_bytes; i++)
+		data[i] ^= m[i & 3];
+}
+
+static void
+box_accumulate_scalar (const guint32 *row,
+		       const gint    *x_bounds,
+		       gint           dest_width,
+		       guint32       *sums)
+{
+	gint dest_x, x;
+
+	for (dest_x = 0; dest_x < dest_width; dest_x++) {
+		guint32 *sum = sums + dest_x * 4;
+
+		for (x = x_bounds[dest_x]; x < x_bounds[dest_x + 1]; x++) {
+			guint32 p = row[x];
+
+			sum[0] += (p >> 16) & 0xff;
+			sum[1] += (p >> 8) & 0xff;
+			sum[2] += p & 0xff;
+			sum[3] += p >> 24;
+		}
+	}
+}
+
+static const EvPixelKernels scalar_kernels = {
+	"scalar",
+	argb32_to_rgba_scalar,
+	rgba_to_argb32_scalar,
+	invert_scalar,
+	box_accumulate_scalar
+};
+
+/* SSE2 */
+#ifdef HAVE_SSE2_KERNELS
+
+static inline __m128i
+unpremultiply_sse2 (__m128i c,
+		    __m128  a)
+{
+	__m128 v;
+
+	v = _mm_mul_ps (_mm_cvtepi32_ps (c), _mm_set1_ps (255.0f));
+	v = _mm_add_ps (_mm_div_ps (v, a), _mm_set1_ps (0.5f));
+	v = _mm_min_ps (v, _mm_set1_ps (255.0f));
+
+	return _mm_cvttps_epi32 (v);
+}
+
+static void
+argb32_to_rgba_sse2 (const guint32 *src,
+		     guchar        *dest,
+		     gint           n_pixels,
+		     gboolean       has_alpha)
+{
+	const __m128i byte = _mm_set1_epi32 (0xff);
+	gint          i;
+
+	for (i = 0; i + 4 <= n_pixels; i += 4) {
+		__m128i p = _mm_loadu_si128 ((const __m128i *)(src + i));
+		__m128i r = _mm_and_si128 (_mm_srli_epi32 (p, 16), byte);
+		__m128i g = _mm_and_si128 (_mm_srli_epi32 (p, 8), byte);
+		__m128i b = _mm_and_si128 (p, byte);
+		__m128i a;
+		__m128i out;
+
+		if (has_alpha) {
+			__m128 af;
+
+			a = _mm_srli_epi32 (p, 24);
+			af = _mm_cvtepi32_ps (a);
+			r = unpremultiply_sse2 (r, af);
+			g = unpremultiply_sse2 (g, af);
+			b = unpremultiply_sse2 (b, af);
+		} else {
+			a = byte;
+		}
+
+		out = _mm_or_si128 (_mm_or_si128 (r, _mm_slli_epi32 (g, 8)),
+				    _mm_or_si128 (_mm_slli_epi32 (b, 16), _mm_slli_epi32 (a, 24)));
+		if (has_alpha) {
+			/* Fully transparent pixels are 0 */
+			out = _mm_andnot_si128 (_mm_cmpeq_epi32 (a, _mm_setzero_si128 ()), out);
+		}
+
+		_mm_storeu_si128 ((__m128i *)(dest + i * 4), out);
+	}
+
+	argb32_to_rgba_scalar (src + i, dest + i * 4, n_pixels - i, has_alpha);
+}
+
+/* Premultiplies two RGBA pixels unpacked to 16 bits, and swaps R and B */
+static inline __m128i
+premultiply_sse2 (__m128i p)
+{
+	const __m128i alpha_mask = _mm_set_epi16 (-1, 0, 0, 0, -1, 0, 0, 0);
+	__m128i       a, t;
+
+	a = _mm_shufflelo_epi16 (p, _MM_SHUFFLE (3, 3, 3, 3));
+	a = _mm_shufflehi_epi16 (a, _MM_SHUFFLE (3, 3, 3, 3));
+
+	t = _mm_add_epi16 (_mm_mullo_epi16 (p, a), _mm_set1_epi16 (128));
+	t = _mm_srli_epi16 (_mm_add_epi16 (t, _mm_srli_epi16 (t, 8)), 8);
+	t = _mm_or_si128 (_mm_andnot_si128 (alpha_mask, t),
+			  _mm_and_si128 (alpha_mask, p));
+
+	t = _mm_shufflelo_epi16 (t, _MM_SHUFFLE (3, 0, 1, 2));
+
+	return _mm_shufflehi_epi16 (t, _MM_SHUFFLE (3, 0, 1, 2));
+}
+
+static void
+rgba_to_argb32_sse2 (const guchar *src,
+		     guint32      *dest,
+		     gint          n_pixels,
+		     gint          n_channels)
+{
+	const __m128i zero = _mm_setzero_si128 ();
+	gint          i = 0;
+
+	if (n_channels == 4) {
+		for (; i + 4 <= n_pixels; i += 4) {
+			__m128i p = _mm_loadu_si128 ((const __m128i *)(src + i * 4));
+			__m128i lo = premultiply_sse2 (_mm_unpacklo_epi8 (p, zero));
+			__m128i hi = premultiply_sse2 (_mm_unpackhi_epi8 (p, zero));
+
+			_mm_storeu_si128 ((__m128i *)(dest + i),
+					  _mm_packus_epi16 (lo, hi));
+		}
+	}
+
+	rgba_to_argb32_scalar (src + i * n_channels, dest + i,
+			       n_pixels - i, n_channels);
+}
+
+static void
+invert_sse2 (guchar  *data,
+	     gsize    n_bytes,
+	     guint32  mask)
+{
+	const __m128i m = _mm_set1_epi32 ((gint32)mask);
+	gsize         i;
+
+	for (i = 0; i + 16 <= n_bytes; i += 16) {
+		__m128i *p = (__m128i *)(data + i);
+
+		_mm_storeu_si128 (p, _mm_xor_si128 (_mm_loadu_si128 (p), m));
+	}
+
+	invert_scalar (data + i, n_bytes - i, mask);
+}
+
+static void
+box_accumulate_sse2 (const guint32 *row,
+		     const gint    *x_bounds,
+		     gint           dest_width,
+		     guint32       *sums)
+{
+	const __m128i zero = _mm_setzero_si128 ();
+	gint          dest_x;
+
+	for (dest_x = 0; dest_x < dest_width; dest_x++) {
+		guint32 *sum = sums + dest_x * 4;
+		__m128i  acc = zero;
+		guint32  v[4];
+		gint     x = x_bounds[dest_x];
+		gint     end = x_bounds[dest_x + 1];
+
+		/* Two pixels at a time as 16 bit channels */
+		for (; x + 2 <= end; x += 2) {
+			__m128i p = _mm_loadl_epi64 ((const __m128i *)(row + x));
+			__m128i w = _mm_unpacklo_epi8 (p, zero);
+
+			acc = _mm_add_epi32 (acc, _mm_unpacklo_epi16 (w, zero));
+			acc = _mm_add_epi32 (acc, _mm_unpackhi_epi16 (w, zero));
+		}
+		if (x < end) {
+			__m128i p = _mm_cvtsi32_si128 ((gint32)row[x]);
+
+			acc = _mm_add_epi32 (acc, _mm_unpacklo_epi16 (_mm_unpacklo_epi8 (p, zero), zero));
+		}
+
+		/* Channels are accumulated in memory order: B, G, R, A */
+		_mm_storeu_si128 ((__m128i *)v, acc);
+		sum[0] += v[2];
+		sum[1] += v[1];
+		sum[2] += v[0];
+		sum[3] += v[3];
+	}
+}
+
+static const EvPixelKernels sse2_kernels = {
+	"sse2",
+	argb32_to_rgba_sse2,
+	rgba_to_argb32_sse2,
+	invert_sse2,
+	box_accumulate_sse2
+};
+
+#endif /* HAVE_SSE2_KERNELS */
+
+/* AVX2, built with a function target so that the rest of the file
+ * doesn't depend on it. Only used when the CPU supports it.
+ */
+#ifdef HAVE_AVX2_KERNELS
+
+#define AVX2_FUNC __attribute__ ((target ("avx2")))
+
+static inline AVX2_FUNC __m256i
+unpremultiply_avx2 (__m256i c,
+		    __m256  a)
+{
+	__m256 v;
+
+	v = _mm256_mul_ps (_mm256_cvtepi32_ps (c), _mm256_set1_ps (255.0f));
+	v = _mm256_add_ps (_mm256_div_ps (v, a), _mm256_set1_ps (0.5f));
+	v = _mm256_min_ps (v, _mm256_set1_ps (255.0f));
+
+	return _mm256_cvttps_epi32 (v);
+}
+
+static AVX2_FUNC void
+argb32_to_rgba_avx2 (const guint32 *src,
+		     guchar        *dest,
+		     gint           n_pixels,
+		     gboolean       has_alpha)
+{
+	const __m256i byte = _mm256_set1_epi32 (0xff);
+	gint          i;
+
+	for (i = 0; i + 8 <= n_pixels; i += 8) {
+		__m256i p = _mm256_loadu_si256 ((const __m256i *)(src + i));
+		__m256i r = _mm256_and_si256 (_mm256_srli_epi32 (p, 16), byte);
+		__m256i g = _mm256_and_si256 (_mm256_srli_epi32 (p, 8), byte);
+		__m256i b = _mm256_and_si256 (p, byte);
+		__m256i a;
+		__m256i out;
+
+		if (has_alpha) {
+			__m256 af;
+
+			a = _mm256_srli_epi32 (p, 24);
+			af = _mm256_cvtepi32_ps (a);
+			r = unpremultiply_avx2 (r, af);
+			g = unpremultiply_avx2 (g, af);
+			b = unpremultiply_avx2 (b, af);
+		} else {
+			a = byte;
+		}
+
+		out = _mm256_or_si256 (_mm256_or_si256 (r, _mm256_slli_epi32 (g, 8)),
+				       _mm256_or_si256 (_mm256_slli_epi32 (b, 16), _mm256_slli_epi32 (a, 24)));
+		if (has_alpha)
+			out = _mm256_andnot_si256 (_mm256_cmpeq_epi32 (a, _mm256_setzero_si256 ()), out);
+
+		_mm256_storeu_si256 ((__m256i *)(dest + i * 4), out);
+	}
+
+	argb32_to_rgba_sse2 (src + i, dest + i * 4, n_pixels - i, has_alpha);
+}
+
+static AVX2_FUNC void
+invert_avx2 (guchar  *data,
+	     gsize    n_bytes,
+	     guint32  mask)
+{
+	const __m256i m = _mm256_set1_epi32 ((gint32)mask);
+	gsize         i;
+
+	for (i = 0; i + 32 <= n_bytes; i += 32) {
+		__m256i *p = (__m256i *)(data + i);
+
+		_mm256_storeu_si256 (p, _mm256_xor_si256 (_mm256_loadu_si256 (p), m));
+	}
+
+	invert_sse2 (data + i, n_bytes - i, mask);
+}
+
+/* Premultiplying and box accumulation don't gain anything from the
+ * wider registers, they use the SSE2 implementations.
+ */
+static const EvPixelKernels avx2_kernels = {
+	"avx2",
+	argb32_to_rgba_avx2,
+	rgba_to_argb32_sse2,
+	invert_avx2,
+	box_accumulate_sse2
+};
+
+#endif /* HAVE_AVX2_KERNELS */
+
+/* NEON */
+#ifdef HAVE_NEON_KERNELS
+
+static inline uint32x4_t
+unpremultiply_neon (uint32x4_t  c,
+		    float32x4_t a)
+{
+	float32x4_t v;
+
+	v = vmulq_n_f32 (vcvtq_f32_u32 (c), 255.0f);
+	v = vaddq_f32 (vdivq_f32 (v, a), vdupq_n_f32 (0.5f));
+	v = vminq_f32 (v, vdupq_n_f32 (255.0f));
+
+	return vcvtq_u32_f32 (v);
+}
+
+static inline uint8x8_t
+unpremultiply_channel_neon (uint8x8_t   c,
+			    float32x4_t a_lo,
+			    float32x4_t a_hi)
+{
+	uint16x8_t w = vmovl_u8 (c);
+	uint32x4_t lo = unpremultiply_neon (vmovl_u16 (vget_low_u16 (w)), a_lo);
+	uint32x4_t hi = unpremultiply_neon (vmovl_u16 (vget_high_u16 (w)), a_hi);
+
+	return vmovn_u16 (vcombine_u16 (vmovn_u32 (lo), vmovn_u32 (hi)));
+}
+
+static void
+argb32_to_rgba_neon (const guint32 *src,
+		     guchar        *dest,
+		     gint           n_pixels,
+		     gboolean       has_alpha)
+{
+	gint i;
+
+	for (i = 0; i + 8 <= n_pixels; i += 8) {
+		/* Deinterleaves to B, G, R, A */
+		uint8x8x4_t p = vld4_u8 ((const guint8 *)(src + i));
+		uint8x8x4_t out;
+
+		if (has_alpha) {
+			uint16x8_t  a = vmovl_u8 (p.val[3]);
+			float32x4_t a_lo = vcvtq_f32_u32 (vmovl_u16 (vget_low_u16 (a)));
+			float32x4_t a_hi = vcvtq_f32_u32 (vmovl_u16 (vget_high_u16 (a)));
+			uint8x8_t   visible = vtst_u8 (p.val[3], p.val[3]);
+
+			out.val[0] = vand_u8 (unpremultiply_channel_neon (p.val[2], a_lo, a_hi), visible);
+			out.val[1] = vand_u8 (unpremultiply_channel_neon (p.val[1], a_lo, a_hi), visible);
+			out.val[2] = vand_u8 (unpremultiply_channel_neon (p.val[0], a_lo, a_hi), visible);
+			out.val[3] = p.val[3];
+		} else {
+			out.val[0] = p.val[2];
+			out.val[1] = p.val[1];
+			out.val[2] = p.val[0];
+			out.val[3] = vdup_n_u8 (0xff);
+		}
+
+		vst4_u8 (dest + i * 4, out);
+	}
+
+	argb32_to_rgba_scalar (src + i, dest + i * 4, n_pixels - i, has_alpha);
+}
+
+static inline uint8x8_t
+premultiply_neon (uint8x8_t c,
+		  uint8x8_t a)
+{
+	uint16x8_t t = vaddq_u16 (vmull_u8 (c, a), vdupq_n_u16 (128));
+
+	return vshrn_n_u16 (vsraq_n_u16 (t, t, 8), 8);
+}
+
+static void
+rgba_to_argb32_neon (const guchar *src,
+		     guint32      *dest,
+		     gint          n_pixels,
+		     gint          n_channels)
+{
+	gint i = 0;
+
+	if (n_channels == 4) {
+		for (; i + 8 <= n_pixels; i += 8) {
+			uint8x8x4_t p = vld4_u8 (src + i * 4);
+			uint8x8x4_t out;
+
+			out.val[0] = premultiply_neon (p.val[2], p.val[3]);
+			out.val[1] = premultiply_neon (p.val[1], p.val[3]);
+			out.val[2] = premultiply_neon (p.val[0], p.val[3]);
+			out.val[3] = p.val[3];
+
+			vst4_u8 ((guint8 *)(dest + i), out);
+		}
+	}
+
+	rgba_to_argb32_scalar (src + i * n_channels, dest + i,
+			       n_pixels - i, n_channels);
+}
+
+static void
+invert_neon (guchar  *data,
+	     gsize    n_bytes,
+	     guint32  mask)
+{
+	const uint8x16_t m = vreinterpretq_u8_u32 (vdupq_n_u32 (mask));
+	gsize            i;
+
+	for (i = 0; i + 16 <= n_bytes; i += 16)
+		vst1q_u8 (data + i, veorq_u8 (vld1q_u8 (data + i), m));
+
+	invert_scalar (data + i, n_bytes - i, mask);
+}
+
+static void
+box_accumulate_neon (const guint32 *row,
+		     const gint    *x_bounds,
+		     gint           dest_width,
+		     guint32       *sums)
+{
+	gint dest_x;
+
+	for (dest_x = 0; dest_x < dest_width; dest_x++) {
+		guint32   *sum = sums + dest_x * 4;
+		uint32x4_t acc = vdupq_n_u32 (0);
+		gint       x = x_bounds[dest_x];
+		gint       end = x_bounds[dest_x + 1];
+
+		for (; x + 2 <= end; x += 2) {
+			uint16x8_t w = vmovl_u8 (vld1_u8 ((const guint8 *)(row + x)));
+
+			acc = vaddw_u16 (acc, vget_low_u16 (w));
+			acc = vaddw_u16 (acc, vget_high_u16 (w));
+		}
+
+		/* Channels are accumulated in memory order: B, G, R, A */
+		sum[0] += vgetq_lane_u32 (acc, 2);
+		sum[1] += vgetq_lane_u32 (acc, 1);
+		sum[2] += vgetq_lane_u32 (acc, 0);
+		sum[3] += vgetq_lane_u32 (acc, 3);
+
+		if (x < end) {
+			guint32 p = row[x];
+
+			sum[0] += (p >> 16) & 0xff;
+			sum[1] += (p >> 8) & 0xff;
+			sum[2] += p & 0xff;
+			sum[3] += p >> 24;
+		}
+	}
+}
+
+static const EvPixelKernels neon_kernels = {
+	"neon",
+	argb32_to_rgba_neon,
+	rgba_to_argb32_neon,
+	invert_neon,
+	box_accumulate_neon
+};
+
+#endif /* HAVE_NEON_KERNELS */
+
+/**
+ * _ev_pixel_kernels_get_for_level:
+ * @level: the #EvPixelKernelsLevel
+ *
+ * Returns: the kernels implemented with @level, or %NULL when they
+ * are not built or not supported by the CPU
+ */
+const EvPixelKernels *
+_ev_pixel_kernels_get_for_level (EvPixelKernelsLevel level)
+{
+	switch (level) {
+	case EV_PIXEL_KERNELS_SCALAR:
+		return &scalar_kernels;
+#ifdef HAVE_SSE2_KERNELS
+	case EV_PIXEL_KERNELS_SSE2:
+		return &sse2_kernels;
+#endif
+#ifdef HAVE_AVX2_KERNELS
+	case EV_PIXEL_KERNELS_AVX2:
+		__builtin_cpu_init ();
+		return __builtin_cpu_supports ("avx2") ? &avx2_kernels : NULL;
+#endif
+#ifdef HAVE_NEON_KERNELS
+	case EV_PIXEL_KERNELS_NEON:
+		return &neon_kernels;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+static gpointer
+ev_pixel_kernels_init (gpointer data)
+{
+	const EvPixelKernels *kernels = NULL;
+	const gchar          *name;
+	gint                  level;
+
+	/* EV_PIXEL_KERNELS=scalar forces the reference implementation */
+	name = g_getenv ("EV_PIXEL_KERNELS");
+
+	for (level = EV_PIXEL_KERNELS_N_LEVELS - 1; level >= 0; level--) {
+		const EvPixelKernels *k = _ev_pixel_kernels_get_for_level (level);
+
+		if (!k)
+			continue;
+
+		if (!name || strcmp (name, k->name) == 0) {
+			kernels = k;
+			break;
+		}
+	}
+
+	return (gpointer)(kernels ? kernels : &scalar_kernels);
+}
+
+/**
+ * _ev_pixel_kernels_get:
+ *
+ * Returns: the fastest kernels supported by the CPU
+ */
+const EvPixelKernels *
+_ev_pixel_kernels_get (void)
+{
+	static GOnce once_init = G_ONCE_INIT;
+
+	return g_once (&once_init, ev_pixel_kernels_init, NULL);
+}
@@ -0,0 +1,75 @@
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (EVINCE_COMPILATION)
+#error "This is a private header."
+#endif
+
+#ifndef EV_PIXEL_KERNELS_H
+#define EV_PIXEL_KERNELS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+	EV_PIXEL_KERNELS_SCALAR,
+	EV_PIXEL_KERNELS_SSE2,
+	EV_PIXEL_KERNELS_AVX2,
+	EV_PIXEL_KERNELS_NEON,
+	EV_PIXEL_KERNELS_N_LEVELS
+} EvPixelKernelsLevel;
+
+/* Per row pixel conversions. Cairo pixels are native endian 32 bit
+ * ARGB words with premultiplied alpha, pixbuf pixels are RGB or RGBA
+ * bytes without premultiplication. Every implementation gives exactly
+ * the same results as the scalar one.
+ */
+typedef struct {
+	const gchar *name;
+
+	/* Cairo ARGB32 or RGB24 to RGBA, unpremultiplying when has_alpha */
+	void (* argb32_to_rgba) (const guint32 *src,
+				 guchar        *dest,
+				 gint           n_pixels,
+				 gboolean       has_alpha);
+	/* RGB or RGBA to cairo ARGB32, premultiplying the alpha */
+	void (* rgba_to_argb32) (const guchar  *src,
+				 guint32       *dest,
+				 gint           n_pixels,
+				 gint           n_channels);
+	/* XORs the bytes with mask, repeated every 4 bytes in memory
+	 * order. data must be the start of a pixel.
+	 */
+	void (* invert)         (guchar        *data,
+				 gsize          n_bytes,
+				 guint32        mask);
+	/* Adds the channels of the cairo pixels of row between
+	 * x_bounds[i] and x_bounds[i + 1] to sums[i * 4] in R, G, B, A order
+	 */
+	void (* box_accumulate) (const guint32 *row,
+				 const gint    *x_bounds,
+				 gint           dest_width,
+				 guint32       *sums);
+} EvPixelKernels;
+
+const EvPixelKernels *_ev_pixel_kernels_get           (void);
+const EvPixelKernels *_ev_pixel_kernels_get_for_level (EvPixelKernelsLevel level);
+
+G_END_DECLS
+
+#endif /* EV_PIXEL_KERNELS_H */
@@ -99,3 +99,16 @@ ev_render_context_set_scale (EvRenderContext *rc,
 	rc->scale = scale;
 }
 
+
+/* Drafts are requested while the view is moving: backends may skip
+ * antialiasing or use cheaper image scaling, but the surface must
+ * still have the usual size.
+ */
+void
+ev_render_context_set_quality (EvRenderContext *rc,
+			       EvRenderQuality  quality)
+{
+	g_return_if_fail (rc != NULL);
+
+	rc->quality = quality;
+}
@@ -30,6 +30,11 @@
 
 G_BEGIN_DECLS
 
+typedef enum {
+	EV_RENDER_QUALITY_FINAL,
+	EV_RENDER_QUALITY_DRAFT
+} EvRenderQuality;
+
 typedef struct _EvRenderContext EvRenderContext;
 typedef struct _EvRenderContextClass EvRenderContextClass;
 
@@ -47,9 +52,10 @@ struct _EvRenderContext
 {
 	GObject parent;
 	
-	EvPage *page;
-	gint    rotation;
-	gdouble scale;
+	EvPage         *page;
+	gint            rotation;
+	gdouble         scale;
+	EvRenderQuality quality;
 };
 
 
@@ -63,6 +69,8 @@ void             ev_render_context_set_rotation    (EvRenderContext *rc,
 						    gint             rotation);
 void             ev_render_context_set_scale       (EvRenderContext *rc,
 						    gdouble          scale);
+void             ev_render_context_set_quality     (EvRenderContext *rc,
+						    EvRenderQuality  quality);
 
 
 G_END_DECLS
@@ -20,59 +20,203 @@
 
 #include "ev-debug.h"
 #include "ev-job-scheduler.h"
+#include "ev-jobs-private.h"
 
 typedef struct _EvSchedulerJob {
 	EvJob         *job;
 	EvJobPriority  priority;
-	GSList        *job_link;
-} EvSchedulerJob;
+	/* Jobs with the same priority run in increasing order */
+	gdouble        order;
 
-G_LOCK_DEFINE_STATIC(job_list);
-static GSList *job_list = NULL;
+	/* Position in the job queue heap, -1 when the job
+	 * is not queued (running or main loop job)
+	 */
+	gint           queue_index;
+	/* Keeps FIFO order between jobs with the same priority */
+	guint64        sequence;
+} EvSchedulerJob;
 
 static gpointer ev_job_thread_proxy               (gpointer        data);
 static void     ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 						   GCancellable   *cancellable);
 
-/* EvJobQueue */
-static GQueue queue_urgent = G_QUEUE_INIT;
-static GQueue queue_high = G_QUEUE_INIT;
-static GQueue queue_low = G_QUEUE_INIT;
-static GQueue queue_none = G_QUEUE_INIT;
-
-static GCond *job_queue_cond = NULL;
-static GMutex *job_queue_mutex = NULL;
-static GQueue *job_queue[EV_JOB_N_PRIORITIES] = {
-	&queue_urgent,
-	&queue_high,
-	&queue_low,
-	&queue_none
-};
+/* EvJobQueue
+ *
+ * Thread jobs are kept in a binary heap ordered by priority, order
+ * and insertion order. Every EvSchedulerJob knows its position in the
+ * heap, and jobs are looked up from the EvJob in a hash table, so
+ * there's no need to walk the queue to cancel or reprioritize a job.
+ * Everything here is protected by job_queue_mutex.
+ */
+static GCond      *job_queue_cond = NULL;
+static GMutex     *job_queue_mutex = NULL;
+static GPtrArray  *job_queue = NULL;
+static GHashTable *job_table = NULL;
+static guint64     job_queue_sequence = 0;
+
+static inline gboolean
+ev_job_queue_job_before (EvSchedulerJob *a,
+			 EvSchedulerJob *b)
+{
+	if (a->priority != b->priority)
+		return a->priority < b->priority;
+
+	if (a->order != b->order)
+		return a->order < b->order;
+
+	return a->sequence < b->sequence;
+}
+
+static inline void
+ev_job_queue_set (guint           index,
+		  EvSchedulerJob *job)
+{
+	g_ptr_array_index (job_queue, index) = job;
+	job->queue_index = index;
+}
 
 static void
-ev_job_queue_push (EvSchedulerJob *job,
-		   EvJobPriority   priority)
+ev_job_queue_sift_up (guint index)
 {
-	ev_debug_message (DEBUG_JOBS, "%s priority %d", EV_GET_TYPE_NAME (job->job), priority);
-	
-	g_mutex_lock (job_queue_mutex);
+	EvSchedulerJob *job = g_ptr_array_index (job_queue, index);
+
+	while (index > 0) {
+		guint           parent = (index - 1) / 2;
+		EvSchedulerJob *parent_job = g_ptr_array_index (job_queue, parent);
+
+		if (!ev_job_queue_job_before (job, parent_job))
+			break;
+
+		ev_job_queue_set (index, parent_job);
+		index = parent;
+	}
+
+	ev_job_queue_set (index, job);
+}
+
+static void
+ev_job_queue_sift_down (guint index)
+{
+	EvSchedulerJob *job = g_ptr_array_index (job_queue, index);
+	guint           n_jobs = job_queue->len;
+
+	while (TRUE) {
+		guint           child = 2 * index + 1;
+		EvSchedulerJob *child_job;
+
+		if (child >= n_jobs)
+			break;
+
+		child_job = g_ptr_array_index (job_queue, child);
+		if (child + 1 < n_jobs &&
+		    ev_job_queue_job_before (g_ptr_array_index (job_queue, child + 1), child_job)) {
+			child++;
+			child_job = g_ptr_array_index (job_queue, child);
+		}
+
+		if (!ev_job_queue_job_before (child_job, job))
+			break;
+
+		ev_job_queue_set (index, child_job);
+		index = child;
+	}
+
+	ev_job_queue_set (index, job);
+}
+
+static void
+ev_job_queue_fix_unlocked (guint index)
+{
+	if (index > 0 &&
+	    ev_job_queue_job_before (g_ptr_array_index (job_queue, index),
+				     g_ptr_array_index (job_queue, (index - 1) / 2)))
+		ev_job_queue_sift_up (index);
+	else
+		ev_job_queue_sift_down (index);
+}
+
+static void
+ev_job_queue_remove_unlocked (EvSchedulerJob *job)
+{
+	guint           index = job->queue_index;
+	EvSchedulerJob *last;
+
+	g_assert (job->queue_index >= 0);
+
+	last = g_ptr_array_remove_index (job_queue, job_queue->len - 1);
+	if (last != job) {
+		ev_job_queue_set (index, last);
+		ev_job_queue_fix_unlocked (index);
+	}
+
+	job->queue_index = -1;
+}
+
+static void
+ev_job_queue_push_unlocked (EvSchedulerJob *job,
+			    EvJobPriority   priority,
+			    gdouble         order)
+{
+	ev_debug_message (DEBUG_JOBS, "%s priority %d order %f", EV_GET_TYPE_NAME (job->job), priority, order);
+
+	job->priority = priority;
+	job->order = order;
+	job->sequence = job_queue_sequence++;
+	_ev_job_trace (job->job, EV_TRACE_ASYNC_BEGIN, "queued", 0);
+
+	g_ptr_array_add (job_queue, job);
+	job->queue_index = job_queue->len - 1;
+	ev_job_queue_sift_up (job->queue_index);
 
-	g_queue_push_tail (job_queue[priority], job);
 	g_cond_broadcast (job_queue_cond);
-	
+}
+
+/* Moves a queued job to priority and order, running jobs are left alone */
+static void
+ev_job_queue_update_unlocked (EvSchedulerJob *job,
+			      EvJobPriority   priority,
+			      gdouble         order)
+{
+	if (job->queue_index < 0 ||
+	    (job->priority == priority && job->order == order))
+		return;
+
+	ev_debug_message (DEBUG_JOBS, "Moving job %s from pirority %d to %d",
+			  EV_GET_TYPE_NAME (job->job), job->priority, priority);
+
+	if (job->priority != priority) {
+		/* Moving to another priority puts the job at
+		 * the end of the new priority, like a push would
+		 */
+		job->priority = priority;
+		job->sequence = job_queue_sequence++;
+	}
+	job->order = order;
+	ev_job_queue_fix_unlocked (job->queue_index);
+
+	g_cond_broadcast (job_queue_cond);
+}
+
+static void
+ev_job_queue_push (EvSchedulerJob *job,
+		   EvJobPriority   priority,
+		   gdouble         order)
+{
+	g_mutex_lock (job_queue_mutex);
+	ev_job_queue_push_unlocked (job, priority, order);
 	g_mutex_unlock (job_queue_mutex);
 }
 
 static EvSchedulerJob *
 ev_job_queue_get_next_unlocked (void)
 {
-	gint i;
 	EvSchedulerJob *job = NULL;
-	
-	for (i = EV_JOB_PRIORITY_URGENT; i < EV_JOB_N_PRIORITIES; i++) {
-		job = (EvSchedulerJob *) g_queue_pop_head (job_queue[i]);
-		if (job)
-			break;
+
+	if (job_queue->len > 0) {
+		job = g_ptr_array_index (job_queue, 0);
+		ev_job_queue_remove_unlocked (job);
+
+		_ev_job_trace (job->job, EV_TRACE_ASYNC_END, "queued", 0);
 	}
 
 	ev_debug_message (DEBUG_JOBS, "%s", job ? EV_GET_TYPE_NAME (job->job) : "No jobs in queue");
@@ -85,34 +229,55 @@ ev_job_scheduler_init (gpointer data)
 {
 	job_queue_cond = g_cond_new ();
 	job_queue_mutex = g_mutex_new ();
+	job_queue = g_ptr_array_new ();
+	job_table = g_hash_table_new (g_direct_hash, g_direct_equal);
 	g_thread_create (ev_job_thread_proxy, NULL, FALSE, NULL);
 	
 	return NULL;
 }
 
 static void
-ev_scheduler_job_list_add (EvSchedulerJob *job)
+ev_job_scheduler_ensure_init (void)
+{
+	static GOnce once_init = G_ONCE_INIT;
+
+	g_once (&once_init, ev_job_scheduler_init, NULL);
+}
+
+/* Jobs are looked up by their EvJob, so a job can only be
+ * scheduled once at a time. Returns FALSE if it already is,
+ * the scheduled job is then moved to the priority and order
+ * of job instead.
+ */
+static gboolean
+ev_scheduler_job_table_add (EvSchedulerJob *job)
 {
+	EvSchedulerJob *scheduled;
+	gboolean        added = FALSE;
+
 	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job->job));
 	
-	G_LOCK (job_list);
+	g_mutex_lock (job_queue_mutex);
+	scheduled = g_hash_table_lookup (job_table, job->job);
+	if (!scheduled) {
+		g_hash_table_insert (job_table, job->job, job);
+		added = TRUE;
+	} else {
+		ev_job_queue_update_unlocked (scheduled, job->priority, job->order);
+	}
+	g_mutex_unlock (job_queue_mutex);
 
-	job_list = g_slist_prepend (job_list, job);
-	job->job_link = job_list;
-	
-	G_UNLOCK (job_list);
+	return added;
 }
 
 static void
-ev_scheduler_job_list_remove (EvSchedulerJob *job)
+ev_scheduler_job_table_remove (EvSchedulerJob *job)
 {
 	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job->job));
 	
-	G_LOCK (job_list);
-
-	job_list = g_slist_delete_link (job_list, job->job_link);
-	
-	G_UNLOCK (job_list);
+	g_mutex_lock (job_queue_mutex);
+	g_hash_table_remove (job_table, job->job);
+	g_mutex_unlock (job_queue_mutex);
 }
 
 static void
@@ -140,7 +305,7 @@ ev_scheduler_job_destroy (EvSchedulerJob *job)
 						      job);
 	}
 	
-	ev_scheduler_job_list_remove (job);
+	ev_scheduler_job_table_remove (job);
 	ev_scheduler_job_free (job);
 }
 
@@ -148,8 +313,6 @@ static void
 ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 				   GCancellable   *cancellable)
 {
-	GList   *list;
-	
 	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job->job));
 
 	g_mutex_lock (job_queue_mutex);
@@ -159,9 +322,8 @@ ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 	 * If the job is currently running, it will be
 	 * destroyed as soon as it finishes. 
 	 */
-	list = g_queue_find (job_queue[job->priority], job);
-	if (list) {
-		g_queue_delete_link (job_queue[job->priority], list);
+	if (job->queue_index >= 0) {
+		ev_job_queue_remove_unlocked (job);
 		g_mutex_unlock (job_queue_mutex);
 		ev_scheduler_job_destroy (job);
 	} else {
@@ -169,30 +331,65 @@ ev_scheduler_thread_job_cancelled (EvSchedulerJob *job,
 	}
 }
 
-static void
+/* Runs one step of job, returns whether it needs to run again */
+static gboolean
 ev_job_thread (EvJob *job)
 {
 	gboolean result;
+	gint64   start;
 
 	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job));
 
-	do {
-		if (g_cancellable_is_cancelled (job->cancellable))
-			result = FALSE;
-		else
-			result = ev_job_run (job);
-	} while (result);
+	if (g_cancellable_is_cancelled (job->cancellable))
+		return FALSE;
+
+	start = ev_trace_get_time ();
+	result = ev_job_run (job);
+	_ev_job_trace (job, EV_TRACE_SPAN, "run", start);
+
+	return result;
+}
+
+/* Jobs that run in several steps, like thumbnail ranges, go back to
+ * the queue after every step. Otherwise more urgent jobs pushed
+ * meanwhile, like the renders of the visible pages, would have to
+ * wait for the whole job. Returns FALSE if the job was cancelled.
+ */
+static gboolean
+ev_scheduler_job_requeue (EvSchedulerJob *job)
+{
+	gboolean requeued = FALSE;
+
+	g_mutex_lock (job_queue_mutex);
+	/* Cancelling a running job doesn't remove it from the queue,
+	 * checking it with the lock held makes sure that if it's
+	 * cancelled right after, it is removed.
+	 */
+	if (!g_cancellable_is_cancelled (job->job->cancellable)) {
+		ev_job_queue_push_unlocked (job, job->priority, job->order);
+		requeued = TRUE;
+	}
+	g_mutex_unlock (job_queue_mutex);
+
+	return requeued;
 }
 
 static gboolean
 ev_job_idle (EvJob *job)
 {
+	gboolean result;
+	gint64   start;
+
 	ev_debug_message (DEBUG_JOBS, "%s", EV_GET_TYPE_NAME (job));
 
 	if (g_cancellable_is_cancelled (job->cancellable))
 		return FALSE;
 
-	return ev_job_run (job);
+	start = ev_trace_get_time ();
+	result = ev_job_run (job);
+	_ev_job_trace (job, EV_TRACE_SPAN, "run", start);
+
+	return result;
 }
 
 static gpointer
@@ -210,36 +407,58 @@ ev_job_thread_proxy (gpointer data)
 		}
 		g_mutex_unlock (job_queue_mutex);
 		
-		ev_job_thread (job->job);
+		if (ev_job_thread (job->job) && ev_scheduler_job_requeue (job))
+			continue;
+
 		ev_scheduler_job_destroy (job);
 	}
 
 	return NULL;
 }
 
+/**
+ * ev_job_scheduler_push_job_with_order:
+ * @job: a #EvJob
+ * @priority: the #EvJobPriority
+ * @order: position of the job within @priority
+ *
+ * Schedules @job like ev_job_scheduler_push_job(), but jobs with the same
+ * @priority are run in increasing @order instead of in insertion order.
+ * This is used to render first the pages closer to the center of the view.
+ *
+ * Pushing a job that is already queued moves it to @priority and @order,
+ * like ev_job_scheduler_update_job_with_order().
+ */
 void
-ev_job_scheduler_push_job (EvJob         *job,
-			   EvJobPriority  priority)
+ev_job_scheduler_push_job_with_order (EvJob         *job,
+				      EvJobPriority  priority,
+				      gdouble        order)
 {
-	static GOnce once_init = G_ONCE_INIT;
 	EvSchedulerJob *s_job;
 
-	g_once (&once_init, ev_job_scheduler_init, NULL);
+	ev_job_scheduler_ensure_init ();
 
 	ev_debug_message (DEBUG_JOBS, "%s pirority %d", EV_GET_TYPE_NAME (job), priority);
 
 	s_job = g_new0 (EvSchedulerJob, 1);
 	s_job->job = g_object_ref (job);
 	s_job->priority = priority;
+	s_job->order = order;
+	s_job->queue_index = -1;
 
-	ev_scheduler_job_list_add (s_job);
+	if (!ev_scheduler_job_table_add (s_job)) {
+		ev_scheduler_job_free (s_job);
+		return;
+	}
 	
+	_ev_job_trace (job, EV_TRACE_INSTANT, "enqueue", 0);
+
 	switch (ev_job_get_run_mode (job)) {
 	case EV_JOB_RUN_THREAD:
 		g_signal_connect_swapped (job->cancellable, "cancelled",
 					  G_CALLBACK (ev_scheduler_thread_job_cancelled),
 					  s_job);
-		ev_job_queue_push (s_job, priority);
+		ev_job_queue_push (s_job, priority, order);
 		break;
 	case EV_JOB_RUN_MAIN_LOOP:
 		g_signal_connect_swapped (job, "finished",
@@ -259,47 +478,48 @@ ev_job_scheduler_push_job (EvJob         *job,
 }
 
 void
-ev_job_scheduler_update_job (EvJob         *job,
-			     EvJobPriority  priority)
+ev_job_scheduler_push_job (EvJob         *job,
+			   EvJobPriority  priority)
+{
+	ev_job_scheduler_push_job_with_order (job, priority, 0);
+}
+
+/**
+ * ev_job_scheduler_update_job_with_order:
+ * @job: a #EvJob
+ * @priority: the new #EvJobPriority
+ * @order: the new position of the job within @priority
+ *
+ * Moves a queued @job to @priority and @order. It does nothing if
+ * @job is already running.
+ */
+void
+ev_job_scheduler_update_job_with_order (EvJob         *job,
+					EvJobPriority  priority,
+					gdouble        order)
 {
-	GSList         *l;
-	EvSchedulerJob *s_job = NULL;
-	gboolean        need_resort = FALSE;
+	EvSchedulerJob *s_job;
 
 	/* Main loop jobs are scheduled inmediately */
 	if (ev_job_get_run_mode (job) == EV_JOB_RUN_MAIN_LOOP)
 		return;
 
-	ev_debug_message (DEBUG_JOBS, "%s pirority %d", EV_GET_TYPE_NAME (job), priority);
-	
-	G_LOCK (job_list);
+	ev_job_scheduler_ensure_init ();
 
-	for (l = job_list; l; l = l->next) {
-		s_job = (EvSchedulerJob *)l->data;
+	ev_debug_message (DEBUG_JOBS, "%s pirority %d order %f", EV_GET_TYPE_NAME (job), priority, order);
 
-		if (s_job->job == job) {
-			need_resort = (s_job->priority != priority);
-			break;
-		}
-	}
-	
-	G_UNLOCK (job_list);
+	g_mutex_lock (job_queue_mutex);
 
-	if (need_resort) {
-		GList *list;
-	
-		g_mutex_lock (job_queue_mutex);
-		
-		list = g_queue_find (job_queue[s_job->priority], s_job);
-		if (list) {
-			ev_debug_message (DEBUG_JOBS, "Moving job %s from pirority %d to %d",
-					  EV_GET_TYPE_NAME (job), s_job->priority, priority);
-			g_queue_delete_link (job_queue[s_job->priority], list);
-			g_queue_push_tail (job_queue[priority], s_job);
-			g_cond_broadcast (job_queue_cond);
-		}
-		
-		g_mutex_unlock (job_queue_mutex);
-	}
+	s_job = g_hash_table_lookup (job_table, job);
+	if (s_job)
+		ev_job_queue_update_unlocked (s_job, priority, order);
+
+	g_mutex_unlock (job_queue_mutex);
 }
 
+void
+ev_job_scheduler_update_job (EvJob         *job,
+			     EvJobPriority  priority)
+{
+	ev_job_scheduler_update_job_with_order (job, priority, 0);
+}
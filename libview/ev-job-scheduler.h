@@ -38,10 +38,16 @@ typedef enum {
 	EV_JOB_N_PRIORITIES
 } EvJobPriority;
 
-void ev_job_scheduler_push_job   (EvJob        *job,
-				  EvJobPriority priority);
-void ev_job_scheduler_update_job (EvJob        *job,
-				  EvJobPriority priority);
+void ev_job_scheduler_push_job              (EvJob         *job,
+					     EvJobPriority  priority);
+void ev_job_scheduler_push_job_with_order   (EvJob         *job,
+					     EvJobPriority  priority,
+					     gdouble        order);
+void ev_job_scheduler_update_job            (EvJob         *job,
+					     EvJobPriority  priority);
+void ev_job_scheduler_update_job_with_order (EvJob         *job,
+					     EvJobPriority  priority,
+					     gdouble        order);
 
 G_END_DECLS
 
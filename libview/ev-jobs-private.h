@@ -0,0 +1,40 @@
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_JOBS_PRIVATE_H
+#define EV_JOBS_PRIVATE_H
+
+#include "ev-jobs.h"
+#include "ev-debug.h"
+
+G_BEGIN_DECLS
+
+/* Records a trace event for job, tagged with the job type, document,
+ * and the page and scale of the jobs working on a single page.
+ */
+void _ev_job_trace (EvJob        *job,
+		    EvTracePhase  phase,
+		    const gchar  *name,
+		    gint64        start);
+
+G_END_DECLS
+
+#endif /* EV_JOBS_PRIVATE_H */
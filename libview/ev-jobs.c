@@ -21,6 +21,8 @@
 #include <config.h>
 
 #include "ev-jobs.h"
+#include "ev-jobs-private.h"
+#include "ev-render-registry.h"
 #include "ev-document-thumbnails.h"
 #include "ev-document-links.h"
 #include "ev-document-images.h"
@@ -55,6 +57,8 @@ static void ev_job_page_data_init         (EvJobPageData         *job);
 static void ev_job_page_data_class_init   (EvJobPageDataClass    *class);
 static void ev_job_thumbnail_init         (EvJobThumbnail        *job);
 static void ev_job_thumbnail_class_init   (EvJobThumbnailClass   *class);
+static void ev_job_thumbnails_init        (EvJobThumbnails       *job);
+static void ev_job_thumbnails_class_init  (EvJobThumbnailsClass  *class);
 static void ev_job_load_init    	  (EvJobLoad	         *job);
 static void ev_job_load_class_init 	  (EvJobLoadClass	 *class);
 static void ev_job_save_init              (EvJobSave             *job);
@@ -84,9 +88,15 @@ enum {
 	FIND_LAST_SIGNAL
 };
 
+enum {
+	THUMBNAILS_UPDATED,
+	THUMBNAILS_LAST_SIGNAL
+};
+
 static guint job_signals[LAST_SIGNAL] = { 0 };
 static guint job_fonts_signals[FONTS_LAST_SIGNAL] = { 0 };
 static guint job_find_signals[FIND_LAST_SIGNAL] = { 0 };
+static guint job_thumbnails_signals[THUMBNAILS_LAST_SIGNAL] = { 0 };
 
 G_DEFINE_ABSTRACT_TYPE (EvJob, ev_job, G_TYPE_OBJECT)
 G_DEFINE_TYPE (EvJobLinks, ev_job_links, EV_TYPE_JOB)
@@ -94,6 +104,7 @@ G_DEFINE_TYPE (EvJobAttachments, ev_job_attachments, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobRender, ev_job_render, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobPageData, ev_job_page_data, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobThumbnail, ev_job_thumbnail, EV_TYPE_JOB)
+G_DEFINE_TYPE (EvJobThumbnails, ev_job_thumbnails, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobFonts, ev_job_fonts, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobLoad, ev_job_load, EV_TYPE_JOB)
 G_DEFINE_TYPE (EvJobSave, ev_job_save, EV_TYPE_JOB)
@@ -172,6 +183,7 @@ emit_finished (EvJob *job)
 		ev_debug_message (DEBUG_JOBS, "%s (%p) job was cancelled, do not emit finished", EV_GET_TYPE_NAME (job), job);
 	} else {
 		ev_profiler_stop (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+		_ev_job_trace (job, EV_TRACE_INSTANT, "finish", 0);
 		g_signal_emit (job, job_signals[FINISHED], 0);
 	}
 	
@@ -198,10 +210,55 @@ ev_job_emit_finished (EvJob *job)
 					 (GDestroyNotify)g_object_unref);
 	} else {
 		ev_profiler_stop (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+		_ev_job_trace (job, EV_TRACE_INSTANT, "finish", 0);
 		g_signal_emit (job, job_signals[FINISHED], 0);
 	}
 }
 
+void
+_ev_job_trace (EvJob        *job,
+	       EvTracePhase  phase,
+	       const gchar  *name,
+	       gint64        start)
+{
+	gint    page = -1;
+	gdouble scale = 0;
+
+	if (G_LIKELY (!ev_trace_is_enabled ()))
+		return;
+
+	if (EV_IS_JOB_RENDER (job)) {
+		page = EV_JOB_RENDER (job)->page;
+		scale = EV_JOB_RENDER (job)->scale;
+	} else if (EV_IS_JOB_THUMBNAIL (job)) {
+		page = EV_JOB_THUMBNAIL (job)->page;
+		scale = EV_JOB_THUMBNAIL (job)->scale;
+	} else if (EV_IS_JOB_PAGE_DATA (job)) {
+		page = EV_JOB_PAGE_DATA (job)->page;
+	} else if (EV_IS_JOB_FIND (job)) {
+		page = EV_JOB_FIND (job)->current_page;
+	}
+
+	ev_trace_event (phase, name, start, job, EV_GET_TYPE_NAME (job),
+			page, scale, job->document);
+}
+
+/* Takes the document mutex for job. Waiting for it when it's
+ * contended is traced as a lock-wait span, tagged like the job.
+ */
+static void
+ev_job_doc_mutex_lock (EvJob *job)
+{
+	gint64 start;
+
+	if (ev_document_doc_mutex_trylock ())
+		return;
+
+	start = ev_trace_get_time ();
+	ev_document_doc_mutex_lock ();
+	_ev_job_trace (job, EV_TRACE_SPAN, "lock-wait", start);
+}
+
 gboolean
 ev_job_run (EvJob *job)
 {
@@ -336,7 +393,7 @@ ev_job_links_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 	
-	ev_document_doc_mutex_lock ();
+	ev_job_doc_mutex_lock (job);
 	job_links->model = ev_document_links_get_links_model (EV_DOCUMENT_LINKS (job->document));
 	ev_document_doc_mutex_unlock ();
 	
@@ -401,7 +458,7 @@ ev_job_attachments_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	ev_document_doc_mutex_lock ();
+	ev_job_doc_mutex_lock (job);
 	job_attachments->attachments =
 		ev_document_attachments_get_attachments (EV_DOCUMENT_ATTACHMENTS (job->document));
 	ev_document_doc_mutex_unlock ();
@@ -471,14 +528,41 @@ ev_job_render_dispose (GObject *object)
 static gboolean
 ev_job_render_run (EvJob *job)
 {
-	EvJobRender     *job_render = EV_JOB_RENDER (job);
-	EvPage          *ev_page;
-	EvRenderContext *rc;
+	EvJobRender          *job_render = EV_JOB_RENDER (job);
+	EvPage               *ev_page;
+	EvRenderContext      *rc;
 
 	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_render->page, job);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
+
+	/* Another view might have already rendered the very same page,
+	 * a final render is as good as a draft. Only final renders are
+	 * in the registry.
+	 */
+	job_render->surface = _ev_render_registry_lookup_surface (job->document,
+								  job_render->page,
+								  job_render->rotation,
+								  job_render->scale,
+								  EV_RENDER_REGISTRY_FLAGS_NONE);
+	if (job_render->surface)
+		job_render->quality = EV_RENDER_QUALITY_FINAL;
+
+	if (job_render->surface && !job_render->include_selection) {
+		ev_job_succeeded (job);
+
+		return FALSE;
+	}
 	
-	ev_document_doc_mutex_lock ();
+	ev_job_doc_mutex_lock (job);
+
+	/* Waiting for the document lock can take a while, the page
+	 * might no longer be needed, e.g. after zooming again
+	 */
+	if (g_cancellable_is_cancelled (job->cancellable)) {
+		ev_document_doc_mutex_unlock ();
+
+		return FALSE;
+	}
 
 	ev_profiler_start (EV_PROFILE_JOBS, "Rendering page %d", job_render->page);
 		
@@ -486,18 +570,39 @@ ev_job_render_run (EvJob *job)
 
 	ev_page = ev_document_get_page (job->document, job_render->page);
 	rc = ev_render_context_new (ev_page, job_render->rotation, job_render->scale);
+	ev_render_context_set_quality (rc, job_render->quality);
 	g_object_unref (ev_page);
 
-	job_render->surface = ev_document_render (job->document, rc);
-	/* If job was cancelled during the page rendering,
-	 * we return now, so that the thread is finished ASAP
-	 */
-	if (g_cancellable_is_cancelled (job->cancellable)) {
-		ev_document_fc_mutex_unlock ();
-		ev_document_doc_mutex_unlock ();
-		g_object_unref (rc);
+	if (!job_render->surface) {
+		gint64 start = ev_trace_get_time ();
+
+		job_render->surface = ev_document_render (job->document, rc);
+		_ev_job_trace (job, EV_TRACE_SPAN, "backend-render", start);
+
+		/* Drafts are not shared, other views would keep them
+		 * as final renders, and they would take the registry
+		 * budget from final ones.
+		 */
+		if (job_render->surface &&
+		    job_render->quality == EV_RENDER_QUALITY_FINAL) {
+			_ev_render_registry_add_surface (job->document,
+							 job_render->page,
+							 job_render->rotation,
+							 job_render->scale,
+							 EV_RENDER_REGISTRY_FLAGS_NONE,
+							 job_render->surface);
+		}
 
-		return FALSE;
+		/* If job was cancelled during the page rendering,
+		 * we return now, so that the thread is finished ASAP
+		 */
+		if (g_cancellable_is_cancelled (job->cancellable)) {
+			ev_document_fc_mutex_unlock ();
+			ev_document_doc_mutex_unlock ();
+			g_object_unref (rc);
+
+			return FALSE;
+		}
 	}
 
 	if (job_render->include_selection && EV_IS_SELECTION (job->document)) {
@@ -550,6 +655,7 @@ ev_job_render_new (EvDocument   *document,
 	job = g_object_new (EV_TYPE_JOB_RENDER, NULL);
 
 	EV_JOB (job)->document = g_object_ref (document);
+	_ev_render_registry_register (document);
 	job->page = page;
 	job->rotation = rotation;
 	job->scale = scale;
@@ -574,6 +680,13 @@ ev_job_render_set_selection_info (EvJobRender     *job,
 	job->base = *base;
 }
 
+void
+ev_job_render_set_quality (EvJobRender    *job,
+			   EvRenderQuality quality)
+{
+	job->quality = quality;
+}
+
 /* EvJobPageData */
 static void
 ev_job_page_data_init (EvJobPageData *job)
@@ -590,7 +703,7 @@ ev_job_page_data_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, "page: %d (%p)", job_pd->page, job);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 
-	ev_document_doc_mutex_lock ();
+	ev_job_doc_mutex_lock (job);
 	ev_page = ev_document_get_page (job->document, job_pd->page);
 
 	if ((job_pd->flags & EV_PAGE_DATA_INCLUDE_TEXT) && EV_IS_SELECTION (job->document))
@@ -669,26 +782,89 @@ ev_job_thumbnail_dispose (GObject *object)
 	(* G_OBJECT_CLASS (ev_job_thumbnail_parent_class)->dispose) (object);
 }
 
+/* Shared by EvJobThumbnail and EvJobThumbnails. The render context
+ * is created on demand and reused for the following pages.
+ */
+static GdkPixbuf *
+ev_job_get_thumbnail_for_page (EvJob            *job,
+			       gint              page_index,
+			       gint              rotation,
+			       gdouble           scale,
+			       EvRenderContext **rc)
+{
+	EvDocument      *document = job->document;
+	GdkPixbuf       *thumbnail;
+	EvPage          *page;
+	cairo_surface_t *surface;
+	gdouble          surface_scale;
+
+	thumbnail = _ev_render_registry_lookup_thumbnail (document, page_index,
+							  rotation, scale);
+	if (thumbnail)
+		return thumbnail;
+
+	/* Downscale the page if it has already been rendered for a view */
+	surface = _ev_render_registry_lookup_page_surface (document, page_index,
+							   rotation, scale,
+							   &surface_scale);
+	if (surface) {
+		GdkPixbuf *pixbuf;
+		gint       width, height;
+
+		width = MAX ((gint)(cairo_image_surface_get_width (surface) * scale / surface_scale + 0.5), 1);
+		height = MAX ((gint)(cairo_image_surface_get_height (surface) * scale / surface_scale + 0.5), 1);
+		pixbuf = ev_document_misc_pixbuf_from_surface_scaled (surface, width, height);
+		cairo_surface_destroy (surface);
+
+		thumbnail = ev_document_misc_get_thumbnail_frame (-1, -1, pixbuf);
+		g_object_unref (pixbuf);
+	} else {
+		gint64 start;
+
+		ev_job_doc_mutex_lock (job);
+
+		start = ev_trace_get_time ();
+		page = ev_document_get_page (document, page_index);
+		if (!*rc) {
+			*rc = ev_render_context_new (page, rotation, scale);
+		} else {
+			ev_render_context_set_page (*rc, page);
+			ev_render_context_set_scale (*rc, scale);
+		}
+		g_object_unref (page);
+
+		thumbnail = ev_document_thumbnails_get_thumbnail (EV_DOCUMENT_THUMBNAILS (document),
+								  *rc, TRUE);
+		ev_trace_event (EV_TRACE_SPAN, "backend-thumbnail", start, job,
+				EV_GET_TYPE_NAME (job), page_index, scale, document);
+		ev_document_doc_mutex_unlock ();
+	}
+
+	if (thumbnail) {
+		_ev_render_registry_add_thumbnail (document, page_index,
+						   rotation, scale,
+						   thumbnail);
+	}
+
+	return thumbnail;
+}
+
 static gboolean
 ev_job_thumbnail_run (EvJob *job)
 {
 	EvJobThumbnail  *job_thumb = EV_JOB_THUMBNAIL (job);
-	EvRenderContext *rc;
-	EvPage          *page;
+	EvRenderContext *rc = NULL;
 
 	ev_debug_message (DEBUG_JOBS, "%d (%p)", job_thumb->page, job);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
-	
-	ev_document_doc_mutex_lock ();
-
-	page = ev_document_get_page (job->document, job_thumb->page);
-	rc = ev_render_context_new (page, job_thumb->rotation, job_thumb->scale);
-	g_object_unref (page);
 
-	job_thumb->thumbnail = ev_document_thumbnails_get_thumbnail (EV_DOCUMENT_THUMBNAILS (job->document),
-								     rc, TRUE);
-	g_object_unref (rc);
-	ev_document_doc_mutex_unlock ();
+	job_thumb->thumbnail = ev_job_get_thumbnail_for_page (job,
+							      job_thumb->page,
+							      job_thumb->rotation,
+							      job_thumb->scale,
+							      &rc);
+	if (rc)
+		g_object_unref (rc);
 
 	ev_job_succeeded (job);
 	
@@ -718,6 +894,7 @@ ev_job_thumbnail_new (EvDocument *document,
 	job = g_object_new (EV_TYPE_JOB_THUMBNAIL, NULL);
 
 	EV_JOB (job)->document = g_object_ref (document);
+	_ev_render_registry_register (document);
 	job->page = page;
 	job->rotation = rotation;
 	job->scale = scale;
@@ -725,6 +902,258 @@ ev_job_thumbnail_new (EvDocument *document,
 	return EV_JOB (job);
 }
 
+/* EvJobThumbnails */
+
+/* Results are delivered to the main thread in batches, at most once
+ * every THUMBNAILS_UPDATE_INTERVAL milliseconds.
+ */
+#define THUMBNAILS_UPDATE_INTERVAL 100
+
+static void
+ev_job_thumbnails_init (EvJobThumbnails *job)
+{
+	EV_JOB (job)->run_mode = EV_JOB_RUN_THREAD;
+
+	job->mutex = g_mutex_new ();
+}
+
+static void
+ev_job_thumbnails_results_free (GList *results)
+{
+	GList *l;
+
+	for (l = results; l; l = g_list_next (l)) {
+		EvJobThumbnailsResult *result = l->data;
+
+		g_object_unref (result->thumbnail);
+		g_slice_free (EvJobThumbnailsResult, result);
+	}
+	g_list_free (results);
+}
+
+static void
+ev_job_thumbnails_dispose (GObject *object)
+{
+	EvJobThumbnails *job = EV_JOB_THUMBNAILS (object);
+
+	ev_debug_message (DEBUG_JOBS, "%d-%d (%p)", job->start_page, job->end_page, job);
+
+	if (job->updated_id > 0) {
+		g_source_remove (job->updated_id);
+		job->updated_id = 0;
+	}
+
+	if (job->results) {
+		ev_job_thumbnails_results_free (job->results);
+		job->results = NULL;
+	}
+
+	if (job->rc) {
+		g_object_unref (job->rc);
+		job->rc = NULL;
+	}
+
+	(* G_OBJECT_CLASS (ev_job_thumbnails_parent_class)->dispose) (object);
+}
+
+static void
+ev_job_thumbnails_finalize (GObject *object)
+{
+	EvJobThumbnails *job = EV_JOB_THUMBNAILS (object);
+
+	g_mutex_free (job->mutex);
+
+	(* G_OBJECT_CLASS (ev_job_thumbnails_parent_class)->finalize) (object);
+}
+
+/* Called in the main thread */
+static void
+ev_job_thumbnails_emit_updated (EvJobThumbnails *job)
+{
+	GList *results;
+
+	g_mutex_lock (job->mutex);
+	if (job->updated_id > 0) {
+		g_source_remove (job->updated_id);
+		job->updated_id = 0;
+	}
+	results = g_list_reverse (job->results);
+	job->results = NULL;
+	g_mutex_unlock (job->mutex);
+
+	if (!results)
+		return;
+
+	if (!EV_JOB (job)->cancelled)
+		g_signal_emit (job, job_thumbnails_signals[THUMBNAILS_UPDATED], 0, results);
+
+	ev_job_thumbnails_results_free (results);
+}
+
+static gboolean
+emit_updated (EvJobThumbnails *job)
+{
+	g_mutex_lock (job->mutex);
+	job->updated_id = 0;
+	g_mutex_unlock (job->mutex);
+
+	ev_job_thumbnails_emit_updated (job);
+
+	return FALSE;
+}
+
+static gboolean
+ev_job_thumbnails_run (EvJob *job)
+{
+	EvJobThumbnails       *job_thumbs = EV_JOB_THUMBNAILS (job);
+	EvJobThumbnailsResult *result;
+	GdkPixbuf             *thumbnail;
+	gdouble                page_width;
+	gint                   page;
+
+	g_mutex_lock (job_thumbs->mutex);
+	page = job_thumbs->next_page++;
+	if (page > job_thumbs->last_page) {
+		g_mutex_unlock (job_thumbs->mutex);
+		ev_job_succeeded (job);
+
+		return FALSE;
+	}
+	g_mutex_unlock (job_thumbs->mutex);
+
+	ev_debug_message (DEBUG_JOBS, "%d (%p)", page, job);
+
+	ev_document_get_page_size (job->document, page, &page_width, NULL);
+	thumbnail = ev_job_get_thumbnail_for_page (job, page,
+						   job_thumbs->rotation,
+						   (gdouble)job_thumbs->size / page_width,
+						   &job_thumbs->rc);
+	if (!thumbnail)
+		return TRUE;
+
+	result = g_slice_new (EvJobThumbnailsResult);
+	result->page = page;
+	result->thumbnail = thumbnail;
+
+	g_mutex_lock (job_thumbs->mutex);
+	job_thumbs->results = g_list_prepend (job_thumbs->results, result);
+	if (job_thumbs->updated_id == 0) {
+		job_thumbs->updated_id =
+			g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE,
+					    THUMBNAILS_UPDATE_INTERVAL,
+					    (GSourceFunc)emit_updated,
+					    g_object_ref (job),
+					    (GDestroyNotify)g_object_unref);
+	}
+	g_mutex_unlock (job_thumbs->mutex);
+
+	return TRUE;
+}
+
+static void
+ev_job_thumbnails_finished (EvJob *job)
+{
+	/* Deliver the last batch before finished is emitted */
+	ev_job_thumbnails_emit_updated (EV_JOB_THUMBNAILS (job));
+}
+
+static void
+ev_job_thumbnails_class_init (EvJobThumbnailsClass *class)
+{
+	GObjectClass *oclass = G_OBJECT_CLASS (class);
+	EvJobClass   *job_class = EV_JOB_CLASS (class);
+
+	oclass->dispose = ev_job_thumbnails_dispose;
+	oclass->finalize = ev_job_thumbnails_finalize;
+	job_class->run = ev_job_thumbnails_run;
+	job_class->finished = ev_job_thumbnails_finished;
+
+	job_thumbnails_signals[THUMBNAILS_UPDATED] =
+		g_signal_new ("updated",
+			      EV_TYPE_JOB_THUMBNAILS,
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (EvJobThumbnailsClass, updated),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE,
+			      1, G_TYPE_POINTER);
+}
+
+/**
+ * ev_job_thumbnails_new:
+ * @document: an #EvDocument
+ * @start_page: the first page
+ * @end_page: the last page
+ * @rotation: the rotation of the thumbnails
+ * @size: the width of the thumbnails, in pixels
+ *
+ * Creates a job rendering the thumbnails of the pages in the range
+ * [@start_page, @end_page]. Thumbnails are delivered in batches with
+ * the "updated" signal, as a #GList of #EvJobThumbnailsResult that is
+ * only valid during the signal emission.
+ *
+ * Returns: a new #EvJobThumbnails
+ */
+EvJob *
+ev_job_thumbnails_new (EvDocument *document,
+		       gint        start_page,
+		       gint        end_page,
+		       gint        rotation,
+		       gint        size)
+{
+	EvJobThumbnails *job;
+
+	ev_debug_message (DEBUG_JOBS, "%d-%d", start_page, end_page);
+
+	job = g_object_new (EV_TYPE_JOB_THUMBNAILS, NULL);
+
+	EV_JOB (job)->document = g_object_ref (document);
+	_ev_render_registry_register (document);
+	job->start_page = start_page;
+	job->end_page = end_page;
+	job->rotation = rotation;
+	job->size = size;
+	job->next_page = start_page;
+	job->last_page = end_page;
+
+	return EV_JOB (job);
+}
+
+/**
+ * ev_job_thumbnails_trim_range:
+ * @job: an #EvJobThumbnails
+ * @start_page: the first page still needed
+ * @end_page: the last page still needed
+ * @pending_start: return location for the first page that hadn't been
+ *   rendered yet before trimming, or %NULL
+ * @pending_end: return location for the last page that hadn't been
+ *   rendered yet before trimming, or %NULL
+ *
+ * Restricts the pages that haven't been rendered yet to the ones
+ * in [@start_page, @end_page]. The job finishes as soon as there
+ * are no pages left. The pages of [@pending_start, @pending_end]
+ * outside [@start_page, @end_page] are abandoned by the job, their
+ * thumbnails won't be rendered.
+ */
+void
+ev_job_thumbnails_trim_range (EvJobThumbnails *job,
+			      gint             start_page,
+			      gint             end_page,
+			      gint            *pending_start,
+			      gint            *pending_end)
+{
+	g_return_if_fail (EV_IS_JOB_THUMBNAILS (job));
+
+	g_mutex_lock (job->mutex);
+	if (pending_start)
+		*pending_start = job->next_page;
+	if (pending_end)
+		*pending_end = job->last_page;
+	job->next_page = MAX (job->next_page, start_page);
+	job->last_page = MIN (job->last_page, end_page);
+	g_mutex_unlock (job->mutex);
+}
+
 /* EvJobFonts */
 static void
 ev_job_fonts_init (EvJobFonts *job)
@@ -830,12 +1259,15 @@ ev_job_load_run (EvJob *job)
 {
 	EvJobLoad *job_load = EV_JOB_LOAD (job);
 	GError    *error = NULL;
+	gint64     start;
 	
 	ev_debug_message (DEBUG_JOBS, "%s", job_load->uri);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 	
 	ev_document_fc_mutex_lock ();
 
+	start = ev_trace_get_time ();
+
 	/* This job may already have a document even if the job didn't complete
 	   because, e.g., a password is required - if so, just reload rather than
 	   creating a new instance */
@@ -861,6 +1293,8 @@ ev_job_load_run (EvJob *job)
 								  &error);
 	}
 
+	_ev_job_trace (job, EV_TRACE_SPAN, "backend-load", start);
+
 	ev_document_fc_mutex_unlock ();
 
 	if (error) {
@@ -963,7 +1397,7 @@ ev_job_save_run (EvJob *job)
 		return FALSE;
 	}
 
-	ev_document_doc_mutex_lock ();
+	ev_job_doc_mutex_lock (job);
 
 	/* Save document to temp filename */
 	local_uri = g_filename_to_uri (tmp_filename, NULL, &error);
@@ -1105,6 +1539,7 @@ ev_job_find_run (EvJob *job)
 	EvDocumentFind *find = EV_DOCUMENT_FIND (job->document);
 	EvPage         *ev_page;
 	GList          *matches;
+	gint64          start;
 
 	ev_debug_message (DEBUG_JOBS, NULL);
 	
@@ -1118,10 +1553,12 @@ ev_job_find_run (EvJob *job)
 		ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 #endif
 
+	start = ev_trace_get_time ();
 	ev_page = ev_document_get_page (job->document, job_find->current_page);
 	matches = ev_document_find_find_text (find, ev_page, job_find->text,
 					      job_find->case_sensitive);
 	g_object_unref (ev_page);
+	_ev_job_trace (job, EV_TRACE_SPAN, "backend-find", start);
 	
 	ev_document_doc_mutex_unlock ();
 
@@ -1256,7 +1693,7 @@ ev_job_layers_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 	
-	ev_document_doc_mutex_lock ();
+	ev_job_doc_mutex_lock (job);
 	job_layers->model = ev_document_layers_get_layers (EV_DOCUMENT_LAYERS (job->document));
 	ev_document_doc_mutex_unlock ();
 	
@@ -1324,7 +1761,7 @@ ev_job_export_run (EvJob *job)
 	ev_debug_message (DEBUG_JOBS, NULL);
 	ev_profiler_start (EV_PROFILE_JOBS, "%s (%p)", EV_GET_TYPE_NAME (job), job);
 	
-	ev_document_doc_mutex_lock ();
+	ev_job_doc_mutex_lock (job);
 	
 	ev_page = ev_document_get_page (job->document, job_export->page);
 	if (job_export->rc) {
@@ -1419,7 +1856,7 @@ ev_job_print_run (EvJob *job)
 	job->finished = FALSE;
 	g_clear_error (&job->error);
 
-	ev_document_doc_mutex_lock ();
+	ev_job_doc_mutex_lock (job);
 
 	ev_page = ev_document_get_page (job->document, job_print->page);
 	ev_document_print_print_page (EV_DOCUMENT_PRINT (job->document),
@@ -45,6 +45,10 @@ typedef struct _EvJobPageDataClass EvJobPageDataClass;
 typedef struct _EvJobThumbnail EvJobThumbnail;
 typedef struct _EvJobThumbnailClass EvJobThumbnailClass;
 
+typedef struct _EvJobThumbnails EvJobThumbnails;
+typedef struct _EvJobThumbnailsClass EvJobThumbnailsClass;
+typedef struct _EvJobThumbnailsResult EvJobThumbnailsResult;
+
 typedef struct _EvJobLinks EvJobLinks;
 typedef struct _EvJobLinksClass EvJobLinksClass;
 
@@ -103,6 +107,11 @@ typedef struct _EvJobPrintClass EvJobPrintClass;
 #define EV_JOB_THUMBNAIL_CLASS(klass)	     (G_TYPE_CHECK_CLASS_CAST((klass), EV_TYPE_JOB_THUMBNAIL, EvJobThumbnailClass))
 #define EV_IS_JOB_THUMBNAIL(object)	     (G_TYPE_CHECK_INSTANCE_TYPE((object), EV_TYPE_JOB_THUMBNAIL))
 
+#define EV_TYPE_JOB_THUMBNAILS		     (ev_job_thumbnails_get_type())
+#define EV_JOB_THUMBNAILS(object)	     (G_TYPE_CHECK_INSTANCE_CAST((object), EV_TYPE_JOB_THUMBNAILS, EvJobThumbnails))
+#define EV_JOB_THUMBNAILS_CLASS(klass)	     (G_TYPE_CHECK_CLASS_CAST((klass), EV_TYPE_JOB_THUMBNAILS, EvJobThumbnailsClass))
+#define EV_IS_JOB_THUMBNAILS(object)	     (G_TYPE_CHECK_INSTANCE_TYPE((object), EV_TYPE_JOB_THUMBNAILS))
+
 #define EV_TYPE_JOB_FONTS		     (ev_job_fonts_get_type())
 #define EV_JOB_FONTS(object)	     	     (G_TYPE_CHECK_INSTANCE_CAST((object), EV_TYPE_JOB_FONTS, EvJobFonts))
 #define EV_JOB_FONTS_CLASS(klass)	     (G_TYPE_CHECK_CLASS_CAST((klass), EV_TYPE_JOB_FONTS, EvJobFontsClass))
@@ -204,6 +213,7 @@ struct _EvJobRender
 	gint page;
 	gint rotation;
 	gdouble scale;
+	EvRenderQuality quality;
 
 	gboolean page_ready;
 	gint target_width;
@@ -269,6 +279,39 @@ struct _EvJobThumbnailClass
 	EvJobClass parent_class;
 };
 
+struct _EvJobThumbnailsResult
+{
+	gint       page;
+	GdkPixbuf *thumbnail;
+};
+
+struct _EvJobThumbnails
+{
+	EvJob parent;
+
+	gint start_page;
+	gint end_page;
+	gint rotation;
+	gint size;
+
+	/*< private >*/
+	GMutex          *mutex;
+	gint             next_page;
+	gint             last_page;
+	GList           *results;
+	guint            updated_id;
+	EvRenderContext *rc;
+};
+
+struct _EvJobThumbnailsClass
+{
+	EvJobClass parent_class;
+
+	/* Signals */
+	void (* updated) (EvJobThumbnails *job,
+			  GList           *results);
+};
+
 struct _EvJobFonts
 {
 	EvJob parent;
@@ -409,6 +452,8 @@ void     ev_job_render_set_selection_info (EvJobRender     *job,
 					   EvSelectionStyle selection_style,
 					   GdkColor        *text,
 					   GdkColor        *base);
+void     ev_job_render_set_quality        (EvJobRender     *job,
+					   EvRenderQuality  quality);
 /* EvJobPageData */
 GType           ev_job_page_data_get_type (void) G_GNUC_CONST;
 EvJob          *ev_job_page_data_new      (EvDocument      *document,
@@ -421,6 +466,20 @@ EvJob          *ev_job_thumbnail_new      (EvDocument      *document,
 					   gint             page,
 					   gint             rotation,
 					   gdouble          scale);
+
+/* EvJobThumbnails */
+GType           ev_job_thumbnails_get_type   (void) G_GNUC_CONST;
+EvJob          *ev_job_thumbnails_new        (EvDocument      *document,
+					      gint             start_page,
+					      gint             end_page,
+					      gint             rotation,
+					      gint             size);
+void            ev_job_thumbnails_trim_range (EvJobThumbnails *job,
+					      gint             start_page,
+					      gint             end_page,
+					      gint            *pending_start,
+					      gint            *pending_end);
+
 /* EvJobFonts */
 GType 		ev_job_fonts_get_type 	  (void) G_GNUC_CONST;
 EvJob 	       *ev_job_fonts_new 	  (EvDocument      *document);
@@ -0,0 +1,303 @@
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "ev-page-store.h"
+#include "ev-document-misc.h"
+#include "ev-debug.h"
+
+/* Surfaces are encoded as a sequence of 32 bit words: a header with
+ * RLE_RUN_FLAG set is followed by a single word repeated count times,
+ * otherwise it's followed by count literal words. Cairo strides are
+ * always a multiple of 4 bytes, so this works for every format, and
+ * the background of text pages collapses into a few runs per row.
+ */
+#define RLE_RUN_FLAG  0x80000000
+#define RLE_MAX_COUNT 0x7fffffff
+#define RLE_MIN_RUN   3
+
+typedef struct {
+	gint            page;
+	gint            rotation;
+	cairo_format_t  format;
+	gint            width;
+	gint            height;
+	gint            stride;
+
+	guint32        *data;
+	gsize           n_words;
+} PageEntry;
+
+struct _EvPageStore {
+	GQueue entries; /* Most recently used first */
+	gsize  size;
+	gsize  max_size;
+};
+
+static guint32 *
+rle_encode (const guint32 *src,
+	    gsize          n_words,
+	    gsize         *n_encoded)
+{
+	guint32 *dest;
+	gsize    i = 0, o = 0;
+	gsize    literal = G_MAXSIZE;
+
+	/* Every literal header but the first one follows a run,
+	 * which is at least one word shorter than its pixels.
+	 */
+	dest = g_new (guint32, n_words + n_words / RLE_MAX_COUNT + 2);
+
+	while (i < n_words) {
+		gsize run = 1;
+
+		while (i + run < n_words && run < RLE_MAX_COUNT &&
+		       src[i + run] == src[i])
+			run++;
+
+		if (run >= RLE_MIN_RUN) {
+			dest[o++] = RLE_RUN_FLAG | run;
+			dest[o++] = src[i];
+			i += run;
+			literal = G_MAXSIZE;
+
+			continue;
+		}
+
+		if (literal == G_MAXSIZE || dest[literal] == RLE_MAX_COUNT) {
+			literal = o;
+			dest[o++] = 0;
+		}
+		dest[literal]++;
+		dest[o++] = src[i++];
+	}
+
+	*n_encoded = o;
+
+	return g_renew (guint32, dest, MAX (o, 1));
+}
+
+static void
+rle_decode (const guint32 *src,
+	    gsize          n_encoded,
+	    guint32       *dest)
+{
+	gsize i = 0;
+
+	while (i < n_encoded) {
+		guint32 header = src[i++];
+		guint32 count = header & RLE_MAX_COUNT;
+
+		if (header & RLE_RUN_FLAG) {
+			guint32 value = src[i++];
+
+			while (count--)
+				*dest++ = value;
+		} else {
+			memcpy (dest, src + i, count * sizeof (guint32));
+			dest += count;
+			i += count;
+		}
+	}
+}
+
+static void
+page_entry_free (PageEntry *entry)
+{
+	g_free (entry->data);
+	g_slice_free (PageEntry, entry);
+}
+
+static void
+ev_page_store_remove_link (EvPageStore *store,
+			   GList       *link)
+{
+	PageEntry *entry = link->data;
+
+	store->size -= entry->n_words * sizeof (guint32);
+	g_queue_delete_link (&store->entries, link);
+	page_entry_free (entry);
+}
+
+static GList *
+ev_page_store_find (EvPageStore *store,
+		    gint         page,
+		    gint         rotation,
+		    gint         width,
+		    gint         height)
+{
+	GList *l;
+
+	for (l = store->entries.head; l; l = g_list_next (l)) {
+		PageEntry *entry = l->data;
+
+		if (entry->page == page &&
+		    entry->rotation == rotation &&
+		    entry->width == width &&
+		    entry->height == height)
+			return l;
+	}
+
+	return NULL;
+}
+
+EvPageStore *
+_ev_page_store_new (gsize max_size)
+{
+	EvPageStore *store;
+
+	store = g_slice_new0 (EvPageStore);
+	g_queue_init (&store->entries);
+	store->max_size = max_size;
+
+	return store;
+}
+
+void
+_ev_page_store_free (EvPageStore *store)
+{
+	_ev_page_store_clear (store);
+	g_slice_free (EvPageStore, store);
+}
+
+void
+_ev_page_store_add (EvPageStore     *store,
+		    gint             page,
+		    gint             rotation,
+		    cairo_surface_t *surface)
+{
+	PageEntry *entry;
+	GList     *link;
+	gint       width, height, stride;
+	gsize      n_words;
+	gsize      size;
+
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return;
+
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+	stride = cairo_image_surface_get_stride (surface);
+
+	/* Already stored, it hasn't changed since it was restored */
+	link = ev_page_store_find (store, page, rotation, width, height);
+	if (link) {
+		g_queue_unlink (&store->entries, link);
+		g_queue_push_head_link (&store->entries, link);
+		return;
+	}
+
+	cairo_surface_flush (surface);
+
+	entry = g_slice_new (PageEntry);
+	entry->page = page;
+	entry->rotation = rotation;
+	entry->format = cairo_image_surface_get_format (surface);
+	entry->width = width;
+	entry->height = height;
+	entry->stride = stride;
+
+	n_words = (gsize) stride * height / sizeof (guint32);
+	entry->data = rle_encode ((const guint32 *) cairo_image_surface_get_data (surface),
+				  n_words, &entry->n_words);
+	size = entry->n_words * sizeof (guint32);
+
+	/* Don't let a single page that doesn't compress
+	 * well push all the other ones out
+	 */
+	if (size > store->max_size / 4) {
+		page_entry_free (entry);
+		return;
+	}
+
+	ev_debug_message (DEBUG_JOBS, "page: %d stored (%" G_GSIZE_FORMAT " -> %" G_GSIZE_FORMAT " bytes)",
+			  page, n_words * sizeof (guint32), size);
+
+	g_queue_push_head (&store->entries, entry);
+	store->size += size;
+
+	while (store->size > store->max_size)
+		ev_page_store_remove_link (store, store->entries.tail);
+}
+
+/* Returns a new surface with the contents of page, or NULL if it's
+ * not stored for the given rotation and size. The page is kept in
+ * the store, so adding it again while unchanged is cheap.
+ */
+cairo_surface_t *
+_ev_page_store_lookup (EvPageStore *store,
+		       gint         page,
+		       gint         rotation,
+		       gint         width,
+		       gint         height)
+{
+	PageEntry       *entry;
+	GList           *link;
+	cairo_surface_t *surface;
+
+	link = ev_page_store_find (store, page, rotation, width, height);
+	if (!link)
+		return NULL;
+
+	entry = link->data;
+
+	surface = ev_document_misc_surface_new (entry->format, width, height);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS ||
+	    cairo_image_surface_get_stride (surface) != entry->stride) {
+		cairo_surface_destroy (surface);
+		ev_page_store_remove_link (store, link);
+
+		return NULL;
+	}
+
+	cairo_surface_flush (surface);
+	rle_decode (entry->data, entry->n_words,
+		    (guint32 *) cairo_image_surface_get_data (surface));
+	cairo_surface_mark_dirty (surface);
+
+	g_queue_unlink (&store->entries, link);
+	g_queue_push_head_link (&store->entries, link);
+
+	ev_debug_message (DEBUG_JOBS, "page: %d restored", page);
+
+	return surface;
+}
+
+void
+_ev_page_store_remove_page (EvPageStore *store,
+			    gint         page)
+{
+	GList *l = store->entries.head;
+
+	while (l) {
+		GList *next = l->next;
+
+		if (((PageEntry *) l->data)->page == page)
+			ev_page_store_remove_link (store, l);
+		l = next;
+	}
+}
+
+void
+_ev_page_store_clear (EvPageStore *store)
+{
+	while (!g_queue_is_empty (&store->entries))
+		ev_page_store_remove_link (store, store->entries.head);
+}
@@ -0,0 +1,55 @@
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_PAGE_STORE_H
+#define EV_PAGE_STORE_H
+
+#include <cairo.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Rendered pages that are no longer on screen, kept run length
+ * encoded so that scrolling back to them doesn't need to render
+ * them again. The least recently used pages are dropped when the
+ * compressed data exceeds the size limit. Only to be used from
+ * the main thread.
+ */
+typedef struct _EvPageStore EvPageStore;
+
+EvPageStore     *_ev_page_store_new         (gsize            max_size);
+void             _ev_page_store_free        (EvPageStore     *store);
+void             _ev_page_store_add         (EvPageStore     *store,
+					     gint             page,
+					     gint             rotation,
+					     cairo_surface_t *surface);
+cairo_surface_t *_ev_page_store_lookup      (EvPageStore     *store,
+					     gint             page,
+					     gint             rotation,
+					     gint             width,
+					     gint             height);
+void             _ev_page_store_remove_page (EvPageStore     *store,
+					     gint             page);
+void             _ev_page_store_clear       (EvPageStore     *store);
+
+G_END_DECLS
+
+#endif /* EV_PAGE_STORE_H */
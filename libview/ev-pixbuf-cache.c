@@ -1,5 +1,7 @@
 #include <config.h>
 #include "ev-pixbuf-cache.h"
+#include "ev-render-registry.h"
+#include "ev-page-store.h"
 #include "ev-job-scheduler.h"
 #include "ev-mapping.h"
 #include "ev-document-forms.h"
@@ -17,6 +19,14 @@ typedef struct _CacheJobInfo
 
 	/* Data we get from rendering */
 	cairo_surface_t *surface;
+	gint rotation;
+	EvRenderQuality quality;
+
+	/* Shown until the page is rendered, see
+	 * ev_pixbuf_cache_get_placeholder() */
+	cairo_surface_t *placeholder;
+	gboolean placeholder_looked_up;
+	gint placeholder_serial;
 
 	/* Selection data. 
 	 * Selection_points are the coordinates encapsulated in selection.
@@ -49,6 +59,20 @@ struct _EvPixbufCache
 	CacheJobInfo *prev_job;
 	CacheJobInfo *job_list;
 	CacheJobInfo *next_job;
+
+	/* Position of the center of the view, in pages, and scroll
+	 * velocity, in pages per second. They are used to order the
+	 * render jobs, so that pages closer to the center and ahead
+	 * of the scroll direction are rendered first.
+	 */
+	gdouble center_page;
+	gdouble velocity;
+
+	/* Whether the scale is still changing */
+	gboolean zooming;
+
+	/* Pages that left the cache range, compressed */
+	EvPageStore *page_store;
 };
 
 struct _EvPixbufCacheClass
@@ -75,6 +99,15 @@ static void          job_finished_cb            (EvJob              *job,
 						 EvPixbufCache      *pixbuf_cache);
 static CacheJobInfo *find_job_cache             (EvPixbufCache      *pixbuf_cache,
 						 int                 page);
+static void          add_job                    (EvPixbufCache      *pixbuf_cache,
+						 CacheJobInfo       *job_info,
+						 GdkRegion          *region,
+						 gint                width,
+						 gint                height,
+						 gint                page,
+						 gint                rotation,
+						 gfloat              scale,
+						 EvJobPriority       priority);
 static gboolean      new_selection_surface_needed(EvPixbufCache      *pixbuf_cache,
 						  CacheJobInfo       *job_info,
 						  gint                page,
@@ -89,6 +122,18 @@ static gboolean      new_selection_surface_needed(EvPixbufCache      *pixbuf_cac
 #define PAGE_CACHE_LEN(pixbuf_cache) \
 	((pixbuf_cache->end_page - pixbuf_cache->start_page) + 1)
 
+/* How much the scroll velocity (in pages per second) favours
+ * the pages ahead of the scroll direction over the ones behind.
+ */
+#define SCROLL_LOOKAHEAD_FACTOR 0.5
+/* Scroll velocity (in pages per second) above which we stop
+ * preloading the pages we are scrolling away from, and render
+ * drafts that are replaced once the view settles.
+ */
+#define FAST_SCROLL_VELOCITY 2.0
+/* Maximum size of the compressed pages kept by each cache */
+#define PAGE_STORE_MAX_SIZE (32 * 1024 * 1024)
+
 G_DEFINE_TYPE (EvPixbufCache, ev_pixbuf_cache, G_TYPE_OBJECT)
 
 static void
@@ -101,6 +146,8 @@ ev_pixbuf_cache_init (EvPixbufCache *pixbuf_cache)
 	pixbuf_cache->preload_cache_size = 2;
 	pixbuf_cache->prev_job = g_new0 (CacheJobInfo, pixbuf_cache->preload_cache_size);
 	pixbuf_cache->next_job = g_new0 (CacheJobInfo, pixbuf_cache->preload_cache_size);
+
+	pixbuf_cache->page_store = _ev_page_store_new (PAGE_STORE_MAX_SIZE);
 }
 
 static void
@@ -135,9 +182,21 @@ ev_pixbuf_cache_finalize (GObject *object)
 	g_free (pixbuf_cache->job_list);
 	g_free (pixbuf_cache->next_job);
 
+	_ev_page_store_free (pixbuf_cache->page_store);
+
 	G_OBJECT_CLASS (ev_pixbuf_cache_parent_class)->finalize (object);
 }
 
+static void
+clear_job_info_placeholder (CacheJobInfo *job_info)
+{
+	if (job_info->placeholder) {
+		cairo_surface_destroy (job_info->placeholder);
+		job_info->placeholder = NULL;
+	}
+	job_info->placeholder_looked_up = FALSE;
+}
+
 static void
 dispose_cache_job_info (CacheJobInfo *job_info,
 			gpointer      data)
@@ -169,6 +228,7 @@ dispose_cache_job_info (CacheJobInfo *job_info,
 		gdk_region_destroy (job_info->selection_region);
 		job_info->selection_region = NULL;
 	}
+	clear_job_info_placeholder (job_info);
 
 	job_info->points_set = FALSE;
 }
@@ -208,6 +268,31 @@ ev_pixbuf_cache_new (GtkWidget  *view,
 	return pixbuf_cache;
 }
 
+/* Monochrome surfaces are masks, they are inverted as color surfaces */
+static cairo_surface_t *
+copy_and_invert_surface (cairo_surface_t *surface)
+{
+	cairo_surface_t *inverted;
+
+	if (ev_document_misc_surface_is_monochrome (surface))
+		inverted = ev_document_misc_surface_to_color (surface);
+	else
+		inverted = ev_document_misc_surface_copy (surface);
+	ev_document_misc_invert_surface (inverted);
+
+	return inverted;
+}
+
+static EvRenderQuality
+get_render_quality (EvPixbufCache *pixbuf_cache)
+{
+	if (pixbuf_cache->zooming ||
+	    ABS (pixbuf_cache->velocity) >= FAST_SCROLL_VELOCITY)
+		return EV_RENDER_QUALITY_DRAFT;
+
+	return EV_RENDER_QUALITY_FINAL;
+}
+
 static void
 copy_job_to_job_info (EvJobRender   *job_render,
 		      CacheJobInfo  *job_info,
@@ -216,10 +301,17 @@ copy_job_to_job_info (EvJobRender   *job_render,
 	if (job_info->surface) {
 		cairo_surface_destroy (job_info->surface);
 	}
-	job_info->surface = cairo_surface_reference (job_render->surface);
+	/* Rendered surfaces are shared with other views, so
+	 * never modify them in place
+	 */
 	if (pixbuf_cache->inverted_colors) {
-		ev_document_misc_invert_surface (job_info->surface);
+		job_info->surface = copy_and_invert_surface (job_render->surface);
+	} else {
+		job_info->surface = cairo_surface_reference (job_render->surface);
 	}
+	job_info->rotation = job_render->rotation;
+	job_info->quality = job_render->quality;
+	clear_job_info_placeholder (job_info);
 
 	job_info->points_set = FALSE;
 	if (job_render->include_selection) {
@@ -257,6 +349,8 @@ job_finished_cb (EvJob         *job,
 {
 	CacheJobInfo *job_info;
 	EvJobRender *job_render = EV_JOB_RENDER (job);
+	gint page, rotation, width, height;
+	gdouble scale;
 
 	/* If the job is outside of our interest, we silently discard it */
 	if ((job_render->page < (pixbuf_cache->start_page - pixbuf_cache->preload_cache_size)) ||
@@ -267,8 +361,27 @@ job_finished_cb (EvJob         *job,
 
 	job_info = find_job_cache (pixbuf_cache, job_render->page);
 
+	/* The job is released when copied */
+	page = job_render->page;
+	rotation = job_render->rotation;
+	scale = job_render->scale;
+	width = job_render->target_width;
+	height = job_render->target_height;
+
 	copy_job_to_job_info (job_render, job_info, pixbuf_cache);
 	g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, job_info->region);
+
+	/* The view settled while the draft was being rendered */
+	if (job_info->quality == EV_RENDER_QUALITY_DRAFT &&
+	    get_render_quality (pixbuf_cache) == EV_RENDER_QUALITY_FINAL) {
+		gboolean visible;
+
+		visible = page >= pixbuf_cache->start_page &&
+			page <= pixbuf_cache->end_page;
+		add_job (pixbuf_cache, job_info, NULL,
+			 width, height, page, rotation, scale,
+			 visible ? EV_JOB_PRIORITY_URGENT : EV_JOB_PRIORITY_LOW);
+	}
 }
 
 /* This checks a job to see if the job would generate the right sized pixbuf
@@ -303,6 +416,22 @@ check_job_size_and_unref (EvPixbufCache *pixbuf_cache,
 	job_info->job = NULL;
 }
 
+/* Keeps the surface of a page leaving the cache range, unless
+ * it's outdated and being rendered again, or just a draft.
+ */
+static void
+store_cache_job_info (EvPixbufCache *pixbuf_cache,
+		      CacheJobInfo  *job_info,
+		      gint           page)
+{
+	if (!job_info->surface || job_info->job ||
+	    job_info->quality == EV_RENDER_QUALITY_DRAFT)
+		return;
+
+	_ev_page_store_add (pixbuf_cache->page_store, page,
+			    job_info->rotation, job_info->surface);
+}
+
 /* Do all function that copies a job from an older cache to it's position in the
  * new cache.  It clears the old job if it doesn't have a place.
  */
@@ -314,15 +443,14 @@ move_one_job (CacheJobInfo  *job_info,
 	      CacheJobInfo  *new_prev_job,
 	      CacheJobInfo  *new_next_job,
 	      int            start_page,
-	      int            end_page,
-	      gint           priority)
+	      int            end_page)
 {
 	CacheJobInfo *target_page = NULL;
 	int page_offset;
-	gint new_priority;
 
 	if (page < (start_page - pixbuf_cache->preload_cache_size) ||
 	    page > (end_page + pixbuf_cache->preload_cache_size)) {
+		store_cache_job_info (pixbuf_cache, job_info, page);
 		dispose_cache_job_info (job_info, pixbuf_cache);
 		return;
 	}
@@ -334,19 +462,16 @@ move_one_job (CacheJobInfo  *job_info,
 		g_assert (page_offset >= 0 &&
 			  page_offset < pixbuf_cache->preload_cache_size);
 		target_page = new_prev_job + page_offset;
-		new_priority = EV_JOB_PRIORITY_LOW;
 	} else if (page > end_page) {
 		page_offset = (page - (end_page + 1));
 
 		g_assert (page_offset >= 0 &&
 			  page_offset < pixbuf_cache->preload_cache_size);
 		target_page = new_next_job + page_offset;
-		new_priority = EV_JOB_PRIORITY_LOW;
 	} else {
 		page_offset = page - start_page;
 		g_assert (page_offset >= 0 &&
 			  page_offset <= ((end_page - start_page) + 1));
-		new_priority = EV_JOB_PRIORITY_URGENT;
 		target_page = new_job_list + page_offset;
 	}
 
@@ -354,10 +479,7 @@ move_one_job (CacheJobInfo  *job_info,
 	job_info->job = NULL;
 	job_info->region = NULL;
 	job_info->surface = NULL;
-
-	if (new_priority != priority && target_page->job) {
-		ev_job_scheduler_update_job (target_page->job, new_priority);
-	}
+	job_info->placeholder = NULL;
 }
 
 static void
@@ -390,7 +512,7 @@ ev_pixbuf_cache_update_range (EvPixbufCache *pixbuf_cache,
 			move_one_job (pixbuf_cache->prev_job + i,
 				      pixbuf_cache, page,
 				      new_job_list, new_prev_job, new_next_job,
-				      start_page, end_page, EV_JOB_PRIORITY_LOW);
+				      start_page, end_page);
 		}
 		page ++;
 	}
@@ -400,7 +522,7 @@ ev_pixbuf_cache_update_range (EvPixbufCache *pixbuf_cache,
 		move_one_job (pixbuf_cache->job_list + i,
 			      pixbuf_cache, page,
 			      new_job_list, new_prev_job, new_next_job,
-			      start_page, end_page, EV_JOB_PRIORITY_URGENT);
+			      start_page, end_page);
 		page ++;
 	}
 
@@ -411,7 +533,7 @@ ev_pixbuf_cache_update_range (EvPixbufCache *pixbuf_cache,
 			move_one_job (pixbuf_cache->next_job + i,
 				      pixbuf_cache, page,
 				      new_job_list, new_prev_job, new_next_job,
-				      start_page, end_page, EV_JOB_PRIORITY_LOW);
+				      start_page, end_page);
 		}
 		page ++;
 	}
@@ -476,6 +598,84 @@ ev_pixbuf_cache_clear_job_sizes (EvPixbufCache *pixbuf_cache,
 	}
 }
 
+/* Jobs with the same priority are run in increasing order, which is
+ * the distance to the center of the view, shortened for the pages
+ * ahead of the scroll direction and stretched for the ones behind.
+ */
+static gdouble
+get_job_order (EvPixbufCache *pixbuf_cache,
+	       gint           page)
+{
+	gdouble distance = (page + 0.5) - pixbuf_cache->center_page;
+	gdouble factor = 1.0 + ABS (pixbuf_cache->velocity) * SCROLL_LOOKAHEAD_FACTOR;
+
+	if (distance * pixbuf_cache->velocity >= 0)
+		return ABS (distance) / factor;
+
+	return ABS (distance) * factor;
+}
+
+/* When scrolling fast there's no point in preloading
+ * the pages we are leaving behind.
+ */
+static gboolean
+page_is_left_behind (EvPixbufCache *pixbuf_cache,
+		     gint           page)
+{
+	if (page >= pixbuf_cache->start_page && page <= pixbuf_cache->end_page)
+		return FALSE;
+
+	if (ABS (pixbuf_cache->velocity) < FAST_SCROLL_VELOCITY)
+		return FALSE;
+
+	return ((page + 0.5) - pixbuf_cache->center_page) * pixbuf_cache->velocity < 0;
+}
+
+static void
+update_job_order (EvPixbufCache *pixbuf_cache,
+		  CacheJobInfo  *job_info,
+		  gint           page,
+		  EvJobPriority  priority)
+{
+	if (job_info->job == NULL)
+		return;
+
+	if (page_is_left_behind (pixbuf_cache, page)) {
+		g_signal_handlers_disconnect_by_func (job_info->job,
+						      G_CALLBACK (job_finished_cb),
+						      pixbuf_cache);
+		ev_job_cancel (job_info->job);
+		g_object_unref (job_info->job);
+		job_info->job = NULL;
+
+		return;
+	}
+
+	ev_job_scheduler_update_job_with_order (job_info->job, priority,
+						get_job_order (pixbuf_cache, page));
+}
+
+static void
+ev_pixbuf_cache_update_job_orders (EvPixbufCache *pixbuf_cache)
+{
+	int i;
+
+	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
+		update_job_order (pixbuf_cache, pixbuf_cache->job_list + i,
+				  pixbuf_cache->start_page + i,
+				  EV_JOB_PRIORITY_URGENT);
+	}
+
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+		update_job_order (pixbuf_cache, pixbuf_cache->prev_job + i,
+				  pixbuf_cache->start_page - pixbuf_cache->preload_cache_size + i,
+				  EV_JOB_PRIORITY_LOW);
+		update_job_order (pixbuf_cache, pixbuf_cache->next_job + i,
+				  pixbuf_cache->end_page + 1 + i,
+				  EV_JOB_PRIORITY_LOW);
+	}
+}
+
 static void
 get_selection_colors (GtkWidget *widget, GdkColor **text, GdkColor **base)
 {
@@ -508,6 +708,8 @@ add_job (EvPixbufCache *pixbuf_cache,
 	job_info->job = ev_job_render_new (pixbuf_cache->document,
 					   page, rotation, scale,
 					   width, height);
+	ev_job_render_set_quality (EV_JOB_RENDER (job_info->job),
+				   get_render_quality (pixbuf_cache));
 
 	if (new_selection_surface_needed (pixbuf_cache, job_info, page, scale)) {
 		GdkColor *text, *base;
@@ -523,7 +725,39 @@ add_job (EvPixbufCache *pixbuf_cache,
 	g_signal_connect (job_info->job, "finished",
 			  G_CALLBACK (job_finished_cb),
 			  pixbuf_cache);
-	ev_job_scheduler_push_job (job_info->job, priority);
+	ev_job_scheduler_push_job_with_order (job_info->job, priority,
+					      get_job_order (pixbuf_cache, page));
+}
+
+/* Decompressing a page seen recently is much cheaper than
+ * rendering it again.
+ */
+static gboolean
+restore_cache_job_info (EvPixbufCache *pixbuf_cache,
+			CacheJobInfo  *job_info,
+			gint           page,
+			gint           rotation,
+			gint           width,
+			gint           height)
+{
+	cairo_surface_t *surface;
+
+	surface = _ev_page_store_lookup (pixbuf_cache->page_store,
+					 page, rotation, width, height);
+	if (!surface)
+		return FALSE;
+
+	if (job_info->surface)
+		cairo_surface_destroy (job_info->surface);
+	job_info->surface = surface;
+	job_info->rotation = rotation;
+	job_info->quality = EV_RENDER_QUALITY_FINAL;
+	job_info->page_ready = TRUE;
+	clear_job_info_placeholder (job_info);
+
+	g_signal_emit (pixbuf_cache, signals[JOB_FINISHED], 0, NULL);
+
+	return TRUE;
 }
 
 static void
@@ -539,13 +773,26 @@ add_job_if_needed (EvPixbufCache *pixbuf_cache,
 	if (job_info->job)
 		return;
 
+	if (page_is_left_behind (pixbuf_cache, page))
+		return;
+
+	/* The view scales the surface we have until the zoom settles */
+	if (job_info->surface && pixbuf_cache->zooming)
+		return;
+
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page, scale, rotation,
 					       &width, &height);
 
+	/* Drafts are kept until the view settles */
 	if (job_info->surface &&
 	    cairo_image_surface_get_width (job_info->surface) == width &&
-	    cairo_image_surface_get_height (job_info->surface) == height)
+	    cairo_image_surface_get_height (job_info->surface) == height &&
+	    (job_info->quality == EV_RENDER_QUALITY_FINAL ||
+	     get_render_quality (pixbuf_cache) == EV_RENDER_QUALITY_DRAFT))
+		return;
+
+	if (restore_cache_job_info (pixbuf_cache, job_info, page, rotation, width, height))
 		return;
 
 	add_job (pixbuf_cache, job_info, NULL,
@@ -613,6 +860,9 @@ ev_pixbuf_cache_set_page_range (EvPixbufCache  *pixbuf_cache,
 	 * size, we remove them if we need to. */
 	ev_pixbuf_cache_clear_job_sizes (pixbuf_cache, scale);
 
+	/* Reorder the remaining jobs for the new view position */
+	ev_pixbuf_cache_update_job_orders (pixbuf_cache);
+
 	/* Next, we update the target selection for our pages */
 	ev_pixbuf_cache_set_selection_list (pixbuf_cache, selection_list);
 
@@ -621,6 +871,50 @@ ev_pixbuf_cache_set_page_range (EvPixbufCache  *pixbuf_cache,
 	ev_pixbuf_cache_add_jobs_if_needed (pixbuf_cache, rotation, scale);
 }
 
+/* Sets the position of the center of the view, as a fractional page
+ * number, and the scroll velocity in pages per second (negative when
+ * scrolling backwards). It takes effect on the next call to
+ * ev_pixbuf_cache_set_page_range().
+ */
+void
+ev_pixbuf_cache_set_viewport (EvPixbufCache *pixbuf_cache,
+			      gdouble        center_page,
+			      gdouble        velocity)
+{
+	g_return_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache));
+
+	pixbuf_cache->center_page = center_page;
+	pixbuf_cache->velocity = velocity;
+}
+
+/* While zooming, pages that have already been rendered at another
+ * scale aren't rendered again, and the other ones are rendered as
+ * drafts. Jobs for other scales are cancelled anyway. It takes effect
+ * on the next call to ev_pixbuf_cache_set_page_range().
+ */
+void
+ev_pixbuf_cache_set_zooming (EvPixbufCache *pixbuf_cache,
+			     gboolean       zooming)
+{
+	g_return_if_fail (EV_IS_PIXBUF_CACHE (pixbuf_cache));
+
+	pixbuf_cache->zooming = zooming;
+}
+
+static void
+invert_job_info_surface (CacheJobInfo *job_info)
+{
+	cairo_surface_t *surface;
+
+	if (!job_info->surface)
+		return;
+
+	/* The surface might be shared with other views */
+	surface = copy_and_invert_surface (job_info->surface);
+	cairo_surface_destroy (job_info->surface);
+	job_info->surface = surface;
+}
+
 void
 ev_pixbuf_cache_set_inverted_colors (EvPixbufCache *pixbuf_cache,
 				     gboolean       inverted_colors)
@@ -631,26 +925,67 @@ ev_pixbuf_cache_set_inverted_colors (EvPixbufCache *pixbuf_cache,
 		return;
 
 	pixbuf_cache->inverted_colors = inverted_colors;
+	_ev_page_store_clear (pixbuf_cache->page_store);
 
 	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
-		CacheJobInfo *job_info;
+		invert_job_info_surface (pixbuf_cache->prev_job + i);
+		invert_job_info_surface (pixbuf_cache->next_job + i);
+	}
 
-		job_info = pixbuf_cache->prev_job + i;
-		if (job_info->surface)
-			ev_document_misc_invert_surface (job_info->surface);
+	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++)
+		invert_job_info_surface (pixbuf_cache->job_list + i);
+}
 
-		job_info = pixbuf_cache->next_job + i;
-		if (job_info->surface)
-			ev_document_misc_invert_surface (job_info->surface);
+static void
+rotate_job_info_surface (EvPixbufCache *pixbuf_cache,
+			 CacheJobInfo  *job_info,
+			 gint           rotation)
+{
+	cairo_surface_t *surface;
+
+	/* Pending jobs render the old rotation */
+	if (job_info->job) {
+		g_signal_handlers_disconnect_by_func (job_info->job,
+						      G_CALLBACK (job_finished_cb),
+						      pixbuf_cache);
+		ev_job_cancel (job_info->job);
+		g_object_unref (job_info->job);
+		job_info->job = NULL;
 	}
+	clear_job_info_placeholder (job_info);
 
-	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
-		CacheJobInfo *job_info;
+	if (!job_info->surface || job_info->rotation == rotation)
+		return;
 
-		job_info = pixbuf_cache->job_list + i;
-		if (job_info->surface)
-			ev_document_misc_invert_surface (job_info->surface);
+	/* The surface might be shared with other views */
+	surface = ev_document_misc_surface_rotate_and_scale (job_info->surface,
+							     cairo_image_surface_get_width (job_info->surface),
+							     cairo_image_surface_get_height (job_info->surface),
+							     (rotation - job_info->rotation + 360) % 360);
+	cairo_surface_destroy (job_info->surface);
+	job_info->surface = surface;
+	job_info->rotation = rotation;
+	job_info->page_ready = TRUE;
+}
+
+/* Rotating a page by a multiple of 90 degrees only moves its pixels
+ * around, so the rendered surfaces are rotated instead of rendering
+ * the pages again. Selections are rendered unrotated, so they stay
+ * as they are.
+ */
+void
+ev_pixbuf_cache_set_rotation (EvPixbufCache *pixbuf_cache,
+			      gint           rotation)
+{
+	gint i;
+
+	for (i = 0; i < pixbuf_cache->preload_cache_size; i++) {
+		rotate_job_info_surface (pixbuf_cache, pixbuf_cache->prev_job + i, rotation);
+		rotate_job_info_surface (pixbuf_cache, pixbuf_cache->next_job + i, rotation);
 	}
+
+	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++)
+		rotate_job_info_surface (pixbuf_cache, pixbuf_cache->job_list + i, rotation);
 }
 
 cairo_surface_t *
@@ -676,6 +1011,40 @@ ev_pixbuf_cache_get_surface (EvPixbufCache *pixbuf_cache,
 	return job_info->surface;
 }
 
+/* Returns the surface to show while page is being rendered. It's
+ * looked up in the render registry once, and kept until the page is
+ * rendered; pages without any are looked up again only when new
+ * results are added to the registry.
+ */
+cairo_surface_t *
+ev_pixbuf_cache_get_placeholder (EvPixbufCache *pixbuf_cache,
+				 gint           page,
+				 gint           rotation,
+				 gdouble        scale)
+{
+	CacheJobInfo *job_info;
+	gint          serial;
+
+	job_info = find_job_cache (pixbuf_cache, page);
+	if (job_info == NULL)
+		return NULL;
+
+	if (job_info->placeholder)
+		return job_info->placeholder;
+
+	serial = _ev_render_registry_get_serial ();
+	if (job_info->placeholder_looked_up &&
+	    job_info->placeholder_serial == serial)
+		return NULL;
+
+	job_info->placeholder = _ev_render_registry_lookup_placeholder (pixbuf_cache->document,
+									page, rotation, scale);
+	job_info->placeholder_looked_up = TRUE;
+	job_info->placeholder_serial = serial;
+
+	return job_info->placeholder;
+}
+
 static gboolean
 new_selection_surface_needed (EvPixbufCache *pixbuf_cache,
 			      CacheJobInfo  *job_info,
@@ -732,6 +1101,8 @@ ev_pixbuf_cache_clear (EvPixbufCache *pixbuf_cache)
 	for (i = 0; i < PAGE_CACHE_LEN (pixbuf_cache); i++) {
 		dispose_cache_job_info (pixbuf_cache->job_list + i, pixbuf_cache);
 	}
+
+	_ev_page_store_clear (pixbuf_cache->page_store);
 }
 
 
@@ -1030,10 +1401,15 @@ ev_pixbuf_cache_reload_page (EvPixbufCache *pixbuf_cache,
 	CacheJobInfo *job_info;
         gint width, height;
 
+	/* Page contents changed, don't let any job reuse old results */
+	_ev_render_registry_invalidate_page (pixbuf_cache->document, page);
+	_ev_page_store_remove_page (pixbuf_cache->page_store, page);
+
 	job_info = find_job_cache (pixbuf_cache, page);
 	if (job_info == NULL)
 		return;
 
+	clear_job_info_placeholder (job_info);
 	_get_page_size_for_scale_and_rotation (pixbuf_cache->document,
 					       page, scale, rotation,
 					       &width, &height);
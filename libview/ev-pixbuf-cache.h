@@ -62,8 +62,17 @@ void           ev_pixbuf_cache_set_page_range       (EvPixbufCache *pixbuf_cache
 						     gint	    rotation,
 						     gfloat         scale,
 						     GList          *selection_list);
+void           ev_pixbuf_cache_set_viewport         (EvPixbufCache *pixbuf_cache,
+						     gdouble        center_page,
+						     gdouble        velocity);
+void           ev_pixbuf_cache_set_zooming          (EvPixbufCache *pixbuf_cache,
+						     gboolean       zooming);
 cairo_surface_t *ev_pixbuf_cache_get_surface        (EvPixbufCache *pixbuf_cache,
 						     gint           page);
+cairo_surface_t *ev_pixbuf_cache_get_placeholder    (EvPixbufCache *pixbuf_cache,
+						     gint           page,
+						     gint           rotation,
+						     gdouble        scale);
 void           ev_pixbuf_cache_clear                (EvPixbufCache *pixbuf_cache);
 void           ev_pixbuf_cache_style_changed        (EvPixbufCache *pixbuf_cache);
 void           ev_pixbuf_cache_reload_page 	    (EvPixbufCache *pixbuf_cache,
@@ -73,6 +82,8 @@ void           ev_pixbuf_cache_reload_page 	    (EvPixbufCache *pixbuf_cache,
 						     gdouble        scale);
 void           ev_pixbuf_cache_set_inverted_colors  (EvPixbufCache *pixbuf_cache,
 						     gboolean       inverted_colors);
+void           ev_pixbuf_cache_set_rotation         (EvPixbufCache *pixbuf_cache,
+						     gint           rotation);
 /* Selection */
 cairo_surface_t *ev_pixbuf_cache_get_selection_surface (EvPixbufCache *pixbuf_cache,
 							gint           page,
@@ -0,0 +1,507 @@
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include "ev-render-registry.h"
+#include "ev-debug.h"
+
+/* Maximum amount of memory kept alive by the registry of a single
+ * document. Results still referenced by a view don't cost anything
+ * extra, this only limits what the registry keeps for others. A single
+ * result can take most of it, so that pages rendered for presentations
+ * on high resolution screens can be shared too.
+ */
+#define RENDER_REGISTRY_MAX_SIZE        (64 * 1024 * 1024)
+#define RENDER_REGISTRY_MAX_RESULT_SIZE (RENDER_REGISTRY_MAX_SIZE / 4 * 3)
+
+typedef enum {
+	RENDER_RESULT_SURFACE,
+	RENDER_RESULT_THUMBNAIL
+} RenderResultType;
+
+/* Results are keyed by the size in pixels of the page rather than the
+ * scale, views computing the scale differently, like the main view and
+ * the presentation one, end up asking for the same size anyway.
+ */
+typedef struct {
+	RenderResultType      type;
+	gint                  page;
+	gint                  rotation;
+	EvRenderRegistryFlags flags;
+	gint                  width;
+	gint                  height;
+	gdouble               scale;
+
+	gpointer              result;
+	gsize                 size;
+	GList                *link;
+} RenderResult;
+
+typedef struct {
+	GHashTable *results;
+	GQueue      lru;    /* Most recently used first */
+	gsize       size;
+} EvRenderRegistry;
+
+G_LOCK_DEFINE_STATIC (render_registry);
+static GHashTable *registries = NULL;
+/* Bumped every time a result is added */
+static volatile gint render_registry_serial = 0;
+
+static void
+render_result_init_key (RenderResult         *r,
+			EvDocument           *document,
+			RenderResultType      type,
+			gint                  page,
+			gint                  rotation,
+			gdouble               scale,
+			EvRenderRegistryFlags flags)
+{
+	gdouble width, height;
+
+	/* Page sizes don't change once the document is loaded,
+	 * they can be read without the document lock.
+	 */
+	ev_document_get_page_size (document, page, &width, &height);
+
+	r->type = type;
+	r->page = page;
+	r->rotation = rotation;
+	r->flags = flags;
+	r->width = (gint)(width * scale + 0.5);
+	r->height = (gint)(height * scale + 0.5);
+	r->scale = scale;
+}
+
+static guint
+render_result_hash (gconstpointer v)
+{
+	const RenderResult *r = v;
+
+	return (r->page << 8) ^ (r->rotation << 2) ^ r->type ^
+		(r->flags << 4) ^ (r->width << 16) ^ r->height;
+}
+
+static gboolean
+render_result_equal (gconstpointer a,
+		     gconstpointer b)
+{
+	const RenderResult *ra = a;
+	const RenderResult *rb = b;
+
+	return ra->type == rb->type &&
+		ra->page == rb->page &&
+		ra->rotation == rb->rotation &&
+		ra->flags == rb->flags &&
+		ra->width == rb->width &&
+		ra->height == rb->height;
+}
+
+static void
+render_result_free (RenderResult *r)
+{
+	if (r->type == RENDER_RESULT_SURFACE)
+		cairo_surface_destroy (r->result);
+	else
+		g_object_unref (r->result);
+	g_slice_free (RenderResult, r);
+}
+
+static void
+ev_render_registry_remove_unlocked (EvRenderRegistry *registry,
+				    RenderResult     *r)
+{
+	g_hash_table_remove (registry->results, r);
+	g_queue_delete_link (&registry->lru, r->link);
+	registry->size -= r->size;
+	render_result_free (r);
+}
+
+static void
+ev_render_registry_free (EvRenderRegistry *registry)
+{
+	while (!g_queue_is_empty (&registry->lru))
+		ev_render_registry_remove_unlocked (registry, registry->lru.head->data);
+	g_hash_table_destroy (registry->results);
+	g_slice_free (EvRenderRegistry, registry);
+}
+
+static void
+document_finalized_cb (gpointer  data,
+		       GObject  *document)
+{
+	G_LOCK (render_registry);
+	g_hash_table_remove (registries, document);
+	G_UNLOCK (render_registry);
+}
+
+/* Called in the main thread when a job is created, so that the
+ * registry lifetime is bound to the document one.
+ */
+void
+_ev_render_registry_register (EvDocument *document)
+{
+	EvRenderRegistry *registry;
+
+	G_LOCK (render_registry);
+
+	if (!registries) {
+		registries = g_hash_table_new_full (g_direct_hash,
+						    g_direct_equal,
+						    NULL,
+						    (GDestroyNotify)ev_render_registry_free);
+	}
+
+	if (g_hash_table_lookup (registries, document)) {
+		G_UNLOCK (render_registry);
+		return;
+	}
+
+	registry = g_slice_new0 (EvRenderRegistry);
+	registry->results = g_hash_table_new (render_result_hash,
+					      render_result_equal);
+	g_queue_init (&registry->lru);
+	g_hash_table_insert (registries, document, registry);
+
+	G_UNLOCK (render_registry);
+
+	g_object_weak_ref (G_OBJECT (document), document_finalized_cb, NULL);
+}
+
+static gpointer
+ev_render_registry_lookup_unlocked (EvRenderRegistry *registry,
+				    RenderResult     *key)
+{
+	RenderResult *r;
+
+	r = g_hash_table_lookup (registry->results, key);
+	if (!r)
+		return NULL;
+
+	g_queue_unlink (&registry->lru, r->link);
+	g_queue_push_head_link (&registry->lru, r->link);
+
+	ev_debug_message (DEBUG_JOBS, "page: %d reused", key->page);
+
+	if (r->type == RENDER_RESULT_SURFACE)
+		return cairo_surface_reference (r->result);
+	return g_object_ref (r->result);
+}
+
+static gpointer
+ev_render_registry_lookup (EvDocument           *document,
+			   RenderResultType      type,
+			   gint                  page,
+			   gint                  rotation,
+			   gdouble               scale,
+			   EvRenderRegistryFlags flags)
+{
+	EvRenderRegistry *registry;
+	RenderResult      key;
+	gpointer          result = NULL;
+
+	render_result_init_key (&key, document, type, page, rotation, scale, flags);
+
+	G_LOCK (render_registry);
+
+	registry = registries ? g_hash_table_lookup (registries, document) : NULL;
+	if (registry)
+		result = ev_render_registry_lookup_unlocked (registry, &key);
+
+	G_UNLOCK (render_registry);
+
+	return result;
+}
+
+static void
+ev_render_registry_add (EvDocument           *document,
+			RenderResultType      type,
+			gint                  page,
+			gint                  rotation,
+			gdouble               scale,
+			EvRenderRegistryFlags flags,
+			gpointer              result,
+			gsize                 size)
+{
+	EvRenderRegistry *registry;
+	RenderResult     *r;
+	RenderResult     *old;
+
+	r = g_slice_new (RenderResult);
+	render_result_init_key (r, document, type, page, rotation, scale, flags);
+	r->size = size;
+	if (type == RENDER_RESULT_SURFACE)
+		r->result = cairo_surface_reference (result);
+	else
+		r->result = g_object_ref (result);
+
+	G_LOCK (render_registry);
+
+	registry = registries ? g_hash_table_lookup (registries, document) : NULL;
+	if (!registry || size > RENDER_REGISTRY_MAX_RESULT_SIZE) {
+		G_UNLOCK (render_registry);
+		render_result_free (r);
+		return;
+	}
+
+	old = g_hash_table_lookup (registry->results, r);
+	if (old)
+		ev_render_registry_remove_unlocked (registry, old);
+
+	g_queue_push_head (&registry->lru, r);
+	r->link = registry->lru.head;
+	g_hash_table_insert (registry->results, r, r);
+	registry->size += size;
+
+	while (registry->size > RENDER_REGISTRY_MAX_SIZE)
+		ev_render_registry_remove_unlocked (registry, registry->lru.tail->data);
+
+	g_atomic_int_inc (&render_registry_serial);
+
+	G_UNLOCK (render_registry);
+}
+
+cairo_surface_t *
+_ev_render_registry_lookup_surface (EvDocument           *document,
+				    gint                  page,
+				    gint                  rotation,
+				    gdouble               scale,
+				    EvRenderRegistryFlags flags)
+{
+	return ev_render_registry_lookup (document, RENDER_RESULT_SURFACE,
+					  page, rotation, scale, flags);
+}
+
+void
+_ev_render_registry_add_surface (EvDocument           *document,
+				 gint                  page,
+				 gint                  rotation,
+				 gdouble               scale,
+				 EvRenderRegistryFlags flags,
+				 cairo_surface_t      *surface)
+{
+	gsize size;
+
+	size = cairo_image_surface_get_stride (surface) *
+		cairo_image_surface_get_height (surface);
+	ev_render_registry_add (document, RENDER_RESULT_SURFACE,
+				page, rotation, scale, flags,
+				surface, size);
+}
+
+/* Returns the smallest surface rendered for page with scale not
+ * lower than min_scale, so that it can be downscaled into a thumbnail
+ */
+cairo_surface_t *
+_ev_render_registry_lookup_page_surface (EvDocument *document,
+					 gint        page,
+					 gint        rotation,
+					 gdouble     min_scale,
+					 gdouble    *scale)
+{
+	EvRenderRegistry *registry;
+	RenderResult     *best = NULL;
+	cairo_surface_t  *surface = NULL;
+	GList            *l;
+
+	G_LOCK (render_registry);
+
+	registry = registries ? g_hash_table_lookup (registries, document) : NULL;
+	if (registry) {
+		for (l = registry->lru.head; l; l = g_list_next (l)) {
+			RenderResult *r = l->data;
+
+			if (r->type != RENDER_RESULT_SURFACE ||
+			    r->flags != EV_RENDER_REGISTRY_FLAGS_NONE ||
+			    r->page != page ||
+			    r->rotation != rotation ||
+			    r->scale < min_scale)
+				continue;
+
+			if (!best || r->scale < best->scale)
+				best = r;
+		}
+	}
+
+	if (best) {
+		surface = cairo_surface_reference (best->result);
+		if (scale)
+			*scale = best->scale;
+	}
+
+	G_UNLOCK (render_registry);
+
+	return surface;
+}
+
+/* Whether a is a better placeholder than b for a page at scale:
+ * surfaces are preferred over thumbnails, then the smallest scale
+ * not lower than the wanted one, then the highest scale.
+ */
+static gboolean
+placeholder_is_better (RenderResult *a,
+		       RenderResult *b,
+		       gdouble       scale)
+{
+	if (!b)
+		return TRUE;
+
+	if (a->type != b->type)
+		return a->type == RENDER_RESULT_SURFACE;
+
+	if (a->scale >= scale && b->scale >= scale)
+		return a->scale < b->scale;
+
+	return a->scale > b->scale;
+}
+
+/* Returns the best rendition of page available to be upscaled or
+ * downscaled while the page is being rendered at scale: a surface
+ * rendered at another scale or, failing that, a thumbnail, without
+ * its frame.
+ */
+cairo_surface_t *
+_ev_render_registry_lookup_placeholder (EvDocument *document,
+					gint        page,
+					gint        rotation,
+					gdouble     scale)
+{
+	EvRenderRegistry *registry;
+	RenderResult     *best = NULL;
+	cairo_surface_t  *surface = NULL;
+	GdkPixbuf        *thumbnail = NULL;
+	GList            *l;
+
+	G_LOCK (render_registry);
+
+	registry = registries ? g_hash_table_lookup (registries, document) : NULL;
+	if (registry) {
+		for (l = registry->lru.head; l; l = g_list_next (l)) {
+			RenderResult *r = l->data;
+
+			if (r->page != page || r->rotation != rotation)
+				continue;
+
+			if (placeholder_is_better (r, best, scale))
+				best = r;
+		}
+	}
+
+	if (best) {
+		if (best->type == RENDER_RESULT_SURFACE)
+			surface = cairo_surface_reference (best->result);
+		else
+			thumbnail = g_object_ref (best->result);
+	}
+
+	G_UNLOCK (render_registry);
+
+	if (thumbnail) {
+		gint width = gdk_pixbuf_get_width (thumbnail) - 4;
+		gint height = gdk_pixbuf_get_height (thumbnail) - 4;
+
+		/* See ev_document_misc_get_thumbnail_frame() */
+		if (width > 0 && height > 0) {
+			GdkPixbuf *contents;
+
+			contents = gdk_pixbuf_new_subpixbuf (thumbnail, 1, 1, width, height);
+			surface = ev_document_misc_surface_from_pixbuf (contents);
+			g_object_unref (contents);
+		}
+		g_object_unref (thumbnail);
+	}
+
+	return surface;
+}
+
+/* Changes whenever a result is added to any registry, so that callers
+ * that found nothing know when it's worth looking again.
+ */
+gint
+_ev_render_registry_get_serial (void)
+{
+	return g_atomic_int_get (&render_registry_serial);
+}
+
+GdkPixbuf *
+_ev_render_registry_lookup_thumbnail (EvDocument *document,
+				      gint        page,
+				      gint        rotation,
+				      gdouble     scale)
+{
+	return ev_render_registry_lookup (document, RENDER_RESULT_THUMBNAIL,
+					  page, rotation, scale,
+					  EV_RENDER_REGISTRY_FLAGS_NONE);
+}
+
+void
+_ev_render_registry_add_thumbnail (EvDocument *document,
+				   gint        page,
+				   gint        rotation,
+				   gdouble     scale,
+				   GdkPixbuf  *thumbnail)
+{
+	gsize size;
+
+	size = gdk_pixbuf_get_rowstride (thumbnail) *
+		gdk_pixbuf_get_height (thumbnail);
+	ev_render_registry_add (document, RENDER_RESULT_THUMBNAIL,
+				page, rotation, scale,
+				EV_RENDER_REGISTRY_FLAGS_NONE,
+				thumbnail, size);
+}
+
+void
+_ev_render_registry_invalidate_page (EvDocument *document,
+				     gint        page)
+{
+	EvRenderRegistry *registry;
+	GList            *l;
+
+	G_LOCK (render_registry);
+
+	registry = registries ? g_hash_table_lookup (registries, document) : NULL;
+	if (registry) {
+		l = registry->lru.head;
+		while (l) {
+			RenderResult *r = l->data;
+
+			l = l->next;
+			if (r->page == page)
+				ev_render_registry_remove_unlocked (registry, r);
+		}
+	}
+
+	G_UNLOCK (render_registry);
+}
+
+void
+_ev_render_registry_invalidate (EvDocument *document)
+{
+	EvRenderRegistry *registry;
+
+	G_LOCK (render_registry);
+
+	registry = registries ? g_hash_table_lookup (registries, document) : NULL;
+	if (registry) {
+		while (!g_queue_is_empty (&registry->lru))
+			ev_render_registry_remove_unlocked (registry, registry->lru.head->data);
+	}
+
+	G_UNLOCK (render_registry);
+}
@@ -0,0 +1,81 @@
+/* this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#if !defined (__EV_EVINCE_VIEW_H_INSIDE__) && !defined (EVINCE_COMPILATION)
+#error "Only <evince-view.h> can be included directly."
+#endif
+
+#ifndef EV_RENDER_REGISTRY_H
+#define EV_RENDER_REGISTRY_H
+
+#include <cairo.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <evince-document.h>
+
+G_BEGIN_DECLS
+
+/* Variants of the same page rendered at the same size. Anything that
+ * changes the contents of the rendered surface needs its own flag, so
+ * that different variants are never mixed up.
+ */
+typedef enum {
+	EV_RENDER_REGISTRY_FLAGS_NONE = 0
+} EvRenderRegistryFlags;
+
+/* Results of render and thumbnail jobs, shared between all the jobs
+ * requesting the same page of the same document with the same
+ * parameters. Returned objects are shared and must be treated as
+ * read-only: copy them before modifying their contents.
+ */
+void             _ev_render_registry_register         (EvDocument      *document);
+cairo_surface_t *_ev_render_registry_lookup_surface   (EvDocument      *document,
+						       gint             page,
+						       gint             rotation,
+						       gdouble          scale,
+						       EvRenderRegistryFlags flags);
+void             _ev_render_registry_add_surface      (EvDocument      *document,
+						       gint             page,
+						       gint             rotation,
+						       gdouble          scale,
+						       EvRenderRegistryFlags flags,
+						       cairo_surface_t *surface);
+cairo_surface_t *_ev_render_registry_lookup_page_surface (EvDocument *document,
+							  gint        page,
+							  gint        rotation,
+							  gdouble     min_scale,
+							  gdouble    *scale);
+cairo_surface_t *_ev_render_registry_lookup_placeholder (EvDocument *document,
+							 gint        page,
+							 gint        rotation,
+							 gdouble     scale);
+gint             _ev_render_registry_get_serial       (void);
+GdkPixbuf       *_ev_render_registry_lookup_thumbnail (EvDocument      *document,
+						       gint             page,
+						       gint             rotation,
+						       gdouble          scale);
+void             _ev_render_registry_add_thumbnail    (EvDocument      *document,
+						       gint             page,
+						       gint             rotation,
+						       gdouble          scale,
+						       GdkPixbuf       *thumbnail);
+void             _ev_render_registry_invalidate_page  (EvDocument      *document,
+						       gint             page);
+void             _ev_render_registry_invalidate       (EvDocument      *document);
+
+G_END_DECLS
+
+#endif /* EV_RENDER_REGISTRY_H */
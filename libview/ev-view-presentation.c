@@ -325,8 +325,27 @@ job_finished_cb (EvJob              *job,
 {
 	EvJobRender *job_render = EV_JOB_RENDER (job);
 
-	if (pview->inverted_colors)
-		ev_document_misc_invert_surface (job_render->surface);
+	/* The rendered surface might be shared with other views.
+	 * Monochrome surfaces are converted, transitions need color.
+	 */
+	if (pview->inverted_colors) {
+		cairo_surface_t *surface;
+
+		surface = ev_document_misc_surface_to_color (job_render->surface);
+		if (surface == job_render->surface) {
+			cairo_surface_destroy (surface);
+			surface = ev_document_misc_surface_copy (job_render->surface);
+		}
+		ev_document_misc_invert_surface (surface);
+		cairo_surface_destroy (job_render->surface);
+		job_render->surface = surface;
+	} else if (ev_document_misc_surface_is_monochrome (job_render->surface)) {
+		cairo_surface_t *surface;
+
+		surface = ev_document_misc_surface_to_color (job_render->surface);
+		cairo_surface_destroy (job_render->surface);
+		job_render->surface = surface;
+	}
 
 	if (job != pview->curr_job)
 		return;
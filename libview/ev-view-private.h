@@ -136,6 +136,19 @@ struct _EvView {
 	gboolean      pending_resize;
 	EvPoint       pending_point;
 
+	/* Scroll motion, in pages, used to schedule rendering */
+	gdouble       scroll_center_page;
+	gdouble       scroll_velocity;
+	GTimeVal      scroll_time;
+	guint         scroll_settle_id;
+
+	/* Pages are rendered at a new scale once it stops changing.
+	 * Zooming starts with the second scale change that comes in
+	 * less than ZOOM_SETTLE_TIME after the previous one.
+	 */
+	guint         zoom_settle_id;
+	gboolean      zooming;
+
 	/* Current geometry */
     
 	gint start_page;
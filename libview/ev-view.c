@@ -34,6 +34,7 @@
 #include "ev-document-links.h"
 #include "ev-document-misc.h"
 #include "ev-pixbuf-cache.h"
+#include "ev-render-registry.h"
 #include "ev-page-cache.h"
 #include "ev-view-marshal.h"
 #include "ev-document-annotations.h"
@@ -75,6 +76,11 @@ typedef enum {
 
 #define SCROLL_TIME 150
 
+/* Time (in ms) without scrolling after which the view is considered still */
+#define SCROLL_SETTLE_TIME 200
+/* Time (in ms) the scale must stay the same before pages are rendered at it */
+#define ZOOM_SETTLE_TIME 150
+
 /*** Scrolling ***/
 static void       ev_view_set_scroll_adjustments             (GtkLayout          *layout,
 							      GtkAdjustment      *hadjustment,
@@ -612,11 +618,78 @@ view_set_adjustment_values (EvView         *view,
 	gtk_adjustment_changed (adjustment);
 }
 
+static gboolean
+scroll_settled_cb (EvView *view)
+{
+	view->scroll_settle_id = 0;
+	view->scroll_velocity = 0;
+	if (view->document)
+		view_update_range_and_current_page (view);
+
+	return FALSE;
+}
+
+static gboolean
+zoom_settled_cb (EvView *view)
+{
+	view->zoom_settle_id = 0;
+	if (!view->zooming)
+		return FALSE;
+
+	view->zooming = FALSE;
+	if (view->document)
+		view_update_range_and_current_page (view);
+
+	return FALSE;
+}
+
 static void
-view_update_range_and_current_page (EvView *view)
+view_update_scroll_velocity (EvView *view,
+			     gdouble center_page)
+{
+	GTimeVal now;
+	gdouble  elapsed;
+
+	g_get_current_time (&now);
+	elapsed = (now.tv_sec - view->scroll_time.tv_sec) +
+		(now.tv_usec - view->scroll_time.tv_usec) / (gdouble)G_USEC_PER_SEC;
+
+	if (elapsed > 0 && elapsed * 1000 < SCROLL_SETTLE_TIME) {
+		gdouble velocity;
+
+		/* Smooth it out a bit, scroll events don't come evenly */
+		velocity = (center_page - view->scroll_center_page) / elapsed;
+		view->scroll_velocity = (view->scroll_velocity + velocity) / 2;
+	} else {
+		view->scroll_velocity = 0;
+	}
+
+	view->scroll_center_page = center_page;
+	view->scroll_time = now;
+
+	if (view->scroll_settle_id)
+		g_source_remove (view->scroll_settle_id);
+	view->scroll_settle_id = 0;
+
+	/* Make sure we notice when the scrolling stops */
+	if (view->scroll_velocity != 0)
+		view->scroll_settle_id =
+			g_timeout_add (SCROLL_SETTLE_TIME,
+				       (GSourceFunc)scroll_settled_cb,
+				       view);
+}
+
+/* scrolled is TRUE when the range changes because the view was scrolled,
+ * the scroll velocity is only updated then. Zooming or resizing also moves
+ * the center page, but that's not the user scrolling through the document.
+ */
+static void
+view_update_range_and_current_page_full (EvView  *view,
+					 gboolean scrolled)
 {
 	gint start = view->start_page;
 	gint end = view->end_page;
+	gdouble center_page = 0;
 
 	if (ev_document_get_n_pages (view->document) <= 0 ||
 	    !ev_document_check_dimensions (view->document))
@@ -628,6 +701,7 @@ view_update_range_and_current_page (EvView *view)
 		gboolean found = FALSE;
 		gint area_max = -1, area;
 		gint best_current_page = -1;
+		gint center_y;
 		int i, j = 0;
 
 		if (!(view->vadjustment && view->hadjustment))
@@ -638,6 +712,8 @@ view_update_range_and_current_page (EvView *view)
 		current_area.y = view->vadjustment->value;
 		current_area.height = view->vadjustment->page_size;
 
+		center_y = current_area.y + current_area.height / 2;
+
 		for (i = 0; i < ev_document_get_n_pages (view->document); i++) {
 
 			get_page_extents (view, i, &page_area, &border);
@@ -658,6 +734,10 @@ view_update_range_and_current_page (EvView *view)
 
 				view->end_page = i;
 				j = 0;
+
+				if (page_area.y <= center_y && page_area.height > 0)
+					center_page = i + CLAMP ((gdouble)(center_y - page_area.y) /
+								 page_area.height, 0, 1);
 			} else if (found && view->current_page <= view->end_page) {
 				if (view->dual_page && j < 1) {
 					/* In dual mode  we stop searching
@@ -700,6 +780,13 @@ view_update_range_and_current_page (EvView *view)
 	if (view->start_page == -1 || view->end_page == -1)
 		return;
 
+	if (!view->continuous)
+		center_page = (view->start_page + view->end_page + 1) / 2.0;
+	if (scrolled)
+		view_update_scroll_velocity (view, center_page);
+	else
+		view->scroll_center_page = center_page;
+
 	if (start != view->start_page || end != view->end_page) {
 		gint i;
 
@@ -715,6 +802,10 @@ view_update_range_and_current_page (EvView *view)
 	ev_page_cache_set_page_range (view->page_cache,
 				      view->start_page,
 				      view->end_page);
+	ev_pixbuf_cache_set_viewport (view->pixbuf_cache,
+				      view->scroll_center_page,
+				      view->scroll_velocity);
+	ev_pixbuf_cache_set_zooming (view->pixbuf_cache, view->zooming);
 	ev_pixbuf_cache_set_page_range (view->pixbuf_cache,
 					view->start_page,
 					view->end_page,
@@ -726,6 +817,12 @@ view_update_range_and_current_page (EvView *view)
 	    gtk_widget_queue_draw (GTK_WIDGET (view));
 }
 
+static void
+view_update_range_and_current_page (EvView *view)
+{
+	view_update_range_and_current_page_full (view, FALSE);
+}
+
 static void
 set_scroll_adjustment (EvView *view,
 		       GtkOrientation  orientation,
@@ -4022,6 +4119,41 @@ draw_loading_text (EvView       *view,
 	cairo_destroy (cr);
 }
 
+/* While a page is being rendered, show a rendition of it at another
+ * scale, or its thumbnail, scaled to the page size. Placeholders are
+ * not inverted, so they aren't used with inverted colors.
+ */
+static gboolean
+draw_placeholder (EvView       *view,
+		  gint          page,
+		  cairo_t      *cr,
+		  GdkRectangle *page_area,
+		  GdkRectangle *overlap)
+{
+	cairo_surface_t *surface;
+
+	if (ev_document_model_get_inverted_colors (view->model))
+		return FALSE;
+
+	surface = ev_pixbuf_cache_get_placeholder (view->pixbuf_cache, page,
+						   view->rotation,
+						   view->scale);
+	if (!surface)
+		return FALSE;
+
+	cairo_save (cr);
+	gdk_cairo_rectangle (cr, overlap);
+	cairo_clip (cr);
+	cairo_translate (cr, page_area->x, page_area->y);
+	cairo_scale (cr,
+		     (gdouble)page_area->width / cairo_image_surface_get_width (surface),
+		     (gdouble)page_area->height / cairo_image_surface_get_height (surface));
+	ev_document_misc_paint_surface (cr, surface);
+	cairo_restore (cr);
+
+	return TRUE;
+}
+
 static void
 draw_one_page (EvView       *view,
 	       gint          page,
@@ -4065,9 +4197,12 @@ draw_one_page (EvView       *view,
 		page_surface = ev_pixbuf_cache_get_surface (view->pixbuf_cache, page);
 
 		if (!page_surface) {
-			draw_loading_text (view,
-					   &real_page_area,
-					   expose_area);
+			if (!draw_placeholder (view, page, cr,
+					       &real_page_area, &overlap)) {
+				draw_loading_text (view,
+						   &real_page_area,
+						   expose_area);
+			}
 
 			*page_ready = FALSE;
 
@@ -4082,9 +4217,11 @@ draw_one_page (EvView       *view,
 		cairo_save (cr);
 		cairo_translate (cr, overlap.x, overlap.y);
 
+		/* The page hasn't been rendered at the current scale yet.
+		 * The surface is painted with cairo's default filter, which
+		 * looks much better than CAIRO_FILTER_FAST while zooming.
+		 */
 		if (width != page_width || height != page_height) {
-			cairo_pattern_set_filter (cairo_get_source (cr),
-						  CAIRO_FILTER_FAST);
 			cairo_scale (cr,
 				     (gdouble)width / page_width,
 				     (gdouble)height / page_height);
@@ -4093,8 +4230,7 @@ draw_one_page (EvView       *view,
 		cairo_surface_set_device_offset (page_surface,
 						 overlap.x - real_page_area.x,
 						 overlap.y - real_page_area.y);
-		cairo_set_source_surface (cr, page_surface, 0, 0);
-		cairo_paint (cr);
+		ev_document_misc_paint_surface (cr, page_surface);
 		cairo_restore (cr);
 		
 		/* Get the selection pixbuf iff we have something to draw */
@@ -4118,8 +4254,6 @@ draw_one_page (EvView       *view,
 		cairo_translate (cr, overlap.x, overlap.y);
 
 		if (width != selection_width || height != selection_height) {
-			cairo_pattern_set_filter (cairo_get_source (cr),
-						  CAIRO_FILTER_FAST);
 			cairo_scale (cr,
 				     (gdouble)width / selection_width,
 				     (gdouble)height / selection_height);
@@ -4188,6 +4322,17 @@ ev_view_destroy (GtkObject *object)
 	    view->selection_update_id = 0;
 	}
 
+	if (view->scroll_settle_id) {
+		g_source_remove (view->scroll_settle_id);
+		view->scroll_settle_id = 0;
+	}
+
+	if (view->zoom_settle_id) {
+		g_source_remove (view->zoom_settle_id);
+		view->zoom_settle_id = 0;
+	}
+	view->zooming = FALSE;
+
 	if (view->loading_text) {
 		cairo_surface_destroy (view->loading_text);
 		view->loading_text = NULL;
@@ -4487,8 +4632,13 @@ on_adjustment_value_changed (GtkAdjustment *adjustment,
 	gtk_widget_get_pointer (GTK_WIDGET (view), &x, &y);
 	ev_view_handle_cursor_over_xy (view, x, y);
 
+	/* The adjustments also change when the view is
+	 * allocated after zooming, that's not scrolling.
+	 */
 	if (view->document)
-		view_update_range_and_current_page (view);
+		view_update_range_and_current_page_full (view,
+							 adjustment != NULL &&
+							 !view->pending_resize);
 }
 
 GtkWidget*
@@ -4655,7 +4805,7 @@ ev_view_rotation_changed_cb (EvDocumentModel *model,
 	view->rotation = rotation;
 
 	if (view->pixbuf_cache) {
-		ev_pixbuf_cache_clear (view->pixbuf_cache);
+		ev_pixbuf_cache_set_rotation (view->pixbuf_cache, rotation);
 		if (!ev_document_is_page_size_uniform (view->document))
 			view->pending_scroll = SCROLL_TO_PAGE_POSITION;
 		gtk_widget_queue_resize (GTK_WIDGET (view));
@@ -4711,6 +4861,18 @@ ev_view_scale_changed_cb (EvDocumentModel *model,
 
 	view->scale = scale;
 
+	/* Window resizes in fit modes and fast zooming change the scale
+	 * many times in a row, the pages already rendered are scaled
+	 * meanwhile. A single zoom step renders the pages right away.
+	 */
+	if (view->zoom_settle_id) {
+		g_source_remove (view->zoom_settle_id);
+		view->zooming = TRUE;
+	}
+	view->zoom_settle_id = g_timeout_add (ZOOM_SETTLE_TIME,
+					      (GSourceFunc)zoom_settled_cb,
+					      view);
+
 	view->pending_resize = TRUE;
 	if (view->sizing_mode == EV_SIZING_FREE)
 		gtk_widget_queue_resize (GTK_WIDGET (view));
@@ -4828,6 +4990,7 @@ ev_view_reload_page (EvView    *view,
 void
 ev_view_reload (EvView *view)
 {
+	_ev_render_registry_invalidate (view->document);
 	ev_pixbuf_cache_clear (view->pixbuf_cache);
 	view_update_range_and_current_page (view);
 }
@@ -0,0 +1,400 @@
+/* evince-render.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include <evince-document.h>
+
+#include <gio/gio.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_OUTPUT "page-%d.png"
+
+static gdouble       dpi = 72.0;
+static gint          rotation = 0;
+static gint          n_threads = 1;
+static const gchar  *page_ranges = NULL;
+static const gchar  *output_pattern = DEFAULT_OUTPUT;
+static const gchar **file_arguments;
+
+static const GOptionEntry goption_options[] = {
+	{ "pages", 'p', 0, G_OPTION_ARG_STRING, &page_ranges, "Pages to render, like 1-3,7 (default: all)", "RANGES" },
+	{ "dpi", 'r', 0, G_OPTION_ARG_DOUBLE, &dpi, "Resolution in dots per inch (default: 72)", "DPI" },
+	{ "rotation", 'R', 0, G_OPTION_ARG_INT, &rotation, "Rotation in degrees: 0, 90, 180 or 270", "DEGREES" },
+	{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &output_pattern, "Output file name, %d is replaced by the page number. "
+	  "Pages are saved as PPM when it ends in .ppm and as PNG otherwise (default: " DEFAULT_OUTPUT ")", "PATTERN" },
+	{ "threads", 't', 0, G_OPTION_ARG_INT, &n_threads, "Number of threads (default: 1)", "N" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "<input>" },
+	{ NULL }
+};
+
+typedef enum {
+	OUTPUT_FORMAT_PNG,
+	OUTPUT_FORMAT_PPM
+} OutputFormat;
+
+/* Documents not in use by a render thread */
+static GAsyncQueue  *documents = NULL;
+static gboolean      thread_safe = FALSE;
+static OutputFormat  output_format = OUTPUT_FORMAT_PNG;
+
+G_LOCK_DEFINE_STATIC (output);
+static gint n_failed = 0;
+
+/* Adds the pages in ranges, a comma separated list of 1-based page
+ * numbers or ranges of page numbers, to pages as 0-based indexes.
+ */
+static gboolean
+parse_page_ranges (const gchar *ranges,
+		   gint         n_pages,
+		   GArray      *pages)
+{
+	gchar **items;
+	gint    i;
+
+	items = g_strsplit (ranges, ",", -1);
+	for (i = 0; items[i]; i++) {
+		gchar *end;
+		gint   first, last, page;
+
+		first = last = strtol (items[i], &end, 10);
+		if (*end == '-') {
+			gchar *start = end + 1;
+
+			last = *start ? strtol (start, &end, 10) : n_pages;
+		}
+
+		if (end == items[i] || *end != '\0' ||
+		    first < 1 || last > n_pages || first > last) {
+			g_printerr ("Invalid page range: %s\n", items[i]);
+			g_strfreev (items);
+
+			return FALSE;
+		}
+
+		for (page = first; page <= last; page++) {
+			gint index = page - 1;
+
+			g_array_append_val (pages, index);
+		}
+	}
+	g_strfreev (items);
+
+	return TRUE;
+}
+
+/* Replaces the first %d in the output pattern by the page number */
+static gchar *
+get_output_filename (gint page)
+{
+	const gchar *p;
+
+	p = strstr (output_pattern, "%d");
+	if (!p)
+		return g_strdup_printf ("%s-%d", output_pattern, page);
+
+	return g_strdup_printf ("%.*s%d%s",
+				(gint)(p - output_pattern), output_pattern,
+				page, p + 2);
+}
+
+static gboolean
+write_ppm (cairo_surface_t *surface,
+	   const gchar     *filename)
+{
+	FILE   *file;
+	guchar *data;
+	guchar *row;
+	gint    width, height, stride;
+	gint    x, y;
+	gboolean has_alpha;
+	gboolean retval;
+
+	file = fopen (filename, "wb");
+	if (!file)
+		return FALSE;
+
+	width = cairo_image_surface_get_width (surface);
+	height = cairo_image_surface_get_height (surface);
+	stride = cairo_image_surface_get_stride (surface);
+	data = cairo_image_surface_get_data (surface);
+	/* The top byte of RGB24 pixels is undefined */
+	has_alpha = cairo_image_surface_get_format (surface) == CAIRO_FORMAT_ARGB32;
+
+	fprintf (file, "P6\n%d %d\n255\n", width, height);
+
+	row = g_malloc (width * 3);
+	for (y = 0; y < height; y++) {
+		guint32 *src = (guint32 *)(data + y * stride);
+
+		/* Composite the premultiplied pixels over white */
+		for (x = 0; x < width; x++) {
+			guint32 pixel = src[x];
+			guchar  alpha = has_alpha ? 0xff - (pixel >> 24) : 0;
+
+			row[x * 3 + 0] = ((pixel >> 16) & 0xff) + alpha;
+			row[x * 3 + 1] = ((pixel >> 8) & 0xff) + alpha;
+			row[x * 3 + 2] = (pixel & 0xff) + alpha;
+		}
+		fwrite (row, 1, width * 3, file);
+	}
+	g_free (row);
+
+	retval = !ferror (file);
+	if (fclose (file) != 0)
+		retval = FALSE;
+
+	return retval;
+}
+
+static void
+render_page (gpointer data,
+	     gpointer user_data)
+{
+	gint             index = GPOINTER_TO_INT (data) - 1;
+	EvDocument      *document;
+	EvPage          *page;
+	EvRenderContext *rc;
+	cairo_surface_t *surface;
+	gchar           *filename;
+	gboolean         success = FALSE;
+	GTimer          *timer;
+	gdouble          render_time;
+
+	document = g_async_queue_pop (documents);
+
+	/* Every thread renders its own document when the backend is
+	 * thread safe, otherwise only one page is rendered at a time
+	 * and only the output files are written in parallel.
+	 */
+	if (!thread_safe)
+		ev_document_doc_mutex_lock ();
+
+	timer = g_timer_new ();
+
+	page = ev_document_get_page (document, index);
+	rc = ev_render_context_new (page, rotation, dpi / 72.0);
+	g_object_unref (page);
+	surface = ev_document_render (document, rc);
+	g_object_unref (rc);
+
+	if (!thread_safe)
+		ev_document_doc_mutex_unlock ();
+	g_async_queue_push (documents, document);
+
+	render_time = g_timer_elapsed (timer, NULL);
+
+	filename = get_output_filename (index + 1);
+	if (surface) {
+		cairo_surface_t *image;
+
+		/* Monochrome pages are rendered as masks */
+		image = ev_document_misc_surface_to_color (surface);
+		cairo_surface_destroy (surface);
+		surface = image;
+
+		if (output_format == OUTPUT_FORMAT_PPM)
+			success = write_ppm (surface, filename);
+		else
+			success = cairo_surface_write_to_png (surface, filename) == CAIRO_STATUS_SUCCESS;
+		cairo_surface_destroy (surface);
+	}
+
+	G_LOCK (output);
+	if (success) {
+		g_print ("%d\t%s\t%.1f ms render\t%.1f ms write\n",
+			 index + 1, filename, render_time * 1000,
+			 (g_timer_elapsed (timer, NULL) - render_time) * 1000);
+	} else {
+		g_printerr ("Error rendering page %d to %s\n", index + 1, filename);
+		n_failed++;
+	}
+	G_UNLOCK (output);
+
+	g_free (filename);
+	g_timer_destroy (timer);
+}
+
+static void
+print_usage (GOptionContext *context)
+{
+	gchar *help;
+
+	help = g_option_context_get_help (context, TRUE, NULL);
+	g_print ("%s", help);
+	g_free (help);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	EvDocument     *document;
+	GFile          *file;
+	gchar          *uri;
+	GArray         *pages;
+	GThreadPool    *pool;
+	GTimer         *timer;
+	GError         *error = NULL;
+	gint            n_pages;
+	guint           i;
+
+	context = g_option_context_new ("- Render document pages to image files");
+	g_option_context_add_main_entries (context, goption_options, NULL);
+
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		print_usage (context);
+		g_option_context_free (context);
+
+		return -1;
+	}
+
+	if (!file_arguments || !file_arguments[0]) {
+		print_usage (context);
+		g_option_context_free (context);
+
+		return -1;
+	}
+
+	g_option_context_free (context);
+
+	if (dpi <= 0) {
+		g_printerr ("Resolution must be positive\n");
+		return -1;
+	}
+
+	if (rotation != 0 && rotation != 90 && rotation != 180 && rotation != 270) {
+		g_printerr ("Rotation must be 0, 90, 180 or 270\n");
+		return -1;
+	}
+
+	if (g_str_has_suffix (output_pattern, ".ppm"))
+		output_format = OUTPUT_FORMAT_PPM;
+
+	g_type_init ();
+
+	if (!g_thread_supported ())
+		g_thread_init (NULL);
+
+	if (!ev_init ())
+		return -1;
+
+	file = g_file_new_for_commandline_arg (file_arguments[0]);
+	uri = g_file_get_uri (file);
+	g_object_unref (file);
+
+	document = ev_document_factory_get_document (uri, &error);
+	if (error) {
+		g_printerr ("Error loading document: %s\n", error->message);
+		g_error_free (error);
+		if (document)
+			g_object_unref (document);
+		g_free (uri);
+		ev_shutdown ();
+
+		return -2;
+	}
+
+	n_pages = ev_document_get_n_pages (document);
+	pages = g_array_new (FALSE, FALSE, sizeof (gint));
+	if (page_ranges) {
+		if (!parse_page_ranges (page_ranges, n_pages, pages)) {
+			g_array_free (pages, TRUE);
+			g_object_unref (document);
+			g_free (uri);
+			ev_shutdown ();
+
+			return -1;
+		}
+	} else {
+		gint index;
+
+		for (index = 0; index < n_pages; index++)
+			g_array_append_val (pages, index);
+	}
+
+	documents = g_async_queue_new ();
+	g_async_queue_push (documents, document);
+
+	/* Load the document once per thread, so that pages are
+	 * rendered without taking the document mutex.
+	 */
+	thread_safe = ev_document_is_thread_safe (document);
+	if (thread_safe) {
+		gint n_documents;
+
+		for (n_documents = 1; n_documents < n_threads; n_documents++) {
+			EvDocument *copy;
+
+			copy = ev_document_factory_get_document (uri, &error);
+			if (error) {
+				/* Render with the documents already loaded */
+				g_error_free (error);
+				error = NULL;
+				if (copy)
+					g_object_unref (copy);
+				break;
+			}
+			g_async_queue_push (documents, copy);
+		}
+	}
+	g_free (uri);
+
+	/* Make sure the mutex is created before the threads */
+	ev_document_get_doc_mutex ();
+
+	pool = g_thread_pool_new (render_page, NULL, MAX (n_threads, 1), TRUE, &error);
+	if (!pool) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_array_free (pages, TRUE);
+		while ((document = g_async_queue_try_pop (documents)))
+			g_object_unref (document);
+		g_async_queue_unref (documents);
+		ev_shutdown ();
+
+		return -1;
+	}
+
+	timer = g_timer_new ();
+
+	/* Indexes are offset by one, a NULL pointer can't be pushed */
+	for (i = 0; i < pages->len; i++) {
+		g_thread_pool_push (pool,
+				    GINT_TO_POINTER (g_array_index (pages, gint, i) + 1),
+				    NULL);
+	}
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	g_printerr ("%u pages, %d failed, %.1f s\n",
+		    pages->len, n_failed, g_timer_elapsed (timer, NULL));
+	g_timer_destroy (timer);
+
+	g_array_free (pages, TRUE);
+	while ((document = g_async_queue_try_pop (documents)))
+		g_object_unref (document);
+	g_async_queue_unref (documents);
+	ev_shutdown ();
+
+	return n_failed > 0 ? -2 : 0;
+}
@@ -79,8 +79,24 @@ struct _EvApplication {
 
 	gchar *filechooser_open_uri;
 	gchar *filechooser_save_uri;
+
+	GHashTable *documents;
 };
 
+/* Loaded documents, shared by all the windows showing the same file.
+ * Entries are removed when the last window showing the document
+ * releases it. The last reference to a document can be dropped by a
+ * job in the job thread, so the registry doesn't rely on weak
+ * references: it keeps its own reference and counts the windows
+ * using the document, all of it in the main thread.
+ */
+typedef struct {
+	gchar      *uri;
+	EvDocument *document;
+	guint64     mtime;
+	guint       n_windows;
+} EvApplicationDocument;
+
 struct _EvApplicationClass {
 	GObjectClass base_class;
 };
@@ -905,12 +921,162 @@ ev_application_shutdown (EvApplication *application)
 	g_free (application->filechooser_save_uri);
 	application->filechooser_save_uri = NULL;
 
+	if (application->documents) {
+		g_hash_table_destroy (application->documents);
+		application->documents = NULL;
+	}
+
 	g_object_unref (application);
         instance = NULL;
 	
 	gtk_main_quit ();
 }
 
+static gboolean
+get_file_mtime (const gchar *uri,
+		guint64     *mtime)
+{
+	GFile     *file;
+	GFileInfo *info;
+
+	file = g_file_new_for_uri (uri);
+	if (!g_file_is_native (file)) {
+		g_object_unref (file);
+
+		return FALSE;
+	}
+
+	info = g_file_query_info (file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+				  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	g_object_unref (file);
+	if (!info)
+		return FALSE;
+
+	*mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	g_object_unref (info);
+
+	return TRUE;
+}
+
+static void
+ev_application_document_free (EvApplicationDocument *app_doc)
+{
+	g_object_unref (app_doc->document);
+	g_free (app_doc->uri);
+	g_slice_free (EvApplicationDocument, app_doc);
+}
+
+/**
+ * ev_application_add_document:
+ * @application: The instance of the application.
+ * @uri: The uri of the file the document was loaded from.
+ * @document: The loaded #EvDocument.
+ *
+ * Called by windows when they start showing @document. Makes @document
+ * available to other windows opening @uri while the file is not
+ * modified, until every window showing it calls
+ * ev_application_release_document(). Only local files are shared.
+ */
+void
+ev_application_add_document (EvApplication *application,
+			     const gchar   *uri,
+			     EvDocument    *document)
+{
+	EvApplicationDocument *app_doc;
+	guint64                mtime;
+
+	g_return_if_fail (uri != NULL);
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	if (!application->documents)
+		return;
+
+	app_doc = g_hash_table_lookup (application->documents, uri);
+	if (app_doc && app_doc->document == document) {
+		app_doc->n_windows++;
+		return;
+	}
+
+	if (!get_file_mtime (uri, &mtime))
+		return;
+
+	app_doc = g_slice_new0 (EvApplicationDocument);
+	app_doc->uri = g_strdup (uri);
+	app_doc->document = g_object_ref (document);
+	app_doc->mtime = mtime;
+	app_doc->n_windows = 1;
+
+	g_hash_table_replace (application->documents, app_doc->uri, app_doc);
+}
+
+static gboolean
+app_doc_has_document (const gchar           *uri,
+		      EvApplicationDocument *app_doc,
+		      EvDocument            *document)
+{
+	return app_doc->document == document;
+}
+
+/**
+ * ev_application_release_document:
+ * @application: The instance of the application.
+ * @document: An #EvDocument
+ *
+ * Called by windows when they stop showing @document.
+ */
+void
+ev_application_release_document (EvApplication *application,
+				 EvDocument    *document)
+{
+	EvApplicationDocument *app_doc;
+
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+
+	if (!application->documents)
+		return;
+
+	/* The window might already be showing another uri */
+	app_doc = g_hash_table_find (application->documents,
+				     (GHRFunc)app_doc_has_document,
+				     document);
+	if (!app_doc)
+		return;
+
+	if (--app_doc->n_windows == 0)
+		g_hash_table_remove (application->documents, app_doc->uri);
+}
+
+/**
+ * ev_application_get_document:
+ * @application: The instance of the application.
+ * @uri: The uri of the file.
+ *
+ * Returns: a new reference to the #EvDocument already loaded from
+ * @uri by another window, or %NULL if there isn't any or the file has
+ * been modified since it was loaded.
+ */
+EvDocument *
+ev_application_get_document (EvApplication *application,
+			     const gchar   *uri)
+{
+	EvApplicationDocument *app_doc;
+	guint64                mtime;
+
+	g_return_val_if_fail (uri != NULL, NULL);
+
+	if (!application->documents)
+		return NULL;
+
+	app_doc = g_hash_table_lookup (application->documents, uri);
+	if (!app_doc)
+		return NULL;
+
+	if (!get_file_mtime (uri, &mtime) || mtime != app_doc->mtime)
+		return NULL;
+
+	return g_object_ref (app_doc->document);
+}
+
 static void
 ev_application_class_init (EvApplicationClass *ev_application_class)
 {
@@ -952,6 +1118,11 @@ ev_application_init (EvApplication *ev_application)
 
 	ev_application->scr_saver = totem_scrsaver_new ();
 
+	ev_application->documents = g_hash_table_new_full (g_str_hash,
+							   g_str_equal,
+							   NULL,
+							   (GDestroyNotify)ev_application_document_free);
+
 #ifdef ENABLE_DBUS
 	ev_application->connection = dbus_g_bus_get (DBUS_BUS_STARTER, &error);
 	if (ev_application->connection) {
@@ -82,6 +82,13 @@ void		  ev_application_screensaver_disable (EvApplication   *application);
 const gchar      *ev_application_get_dot_dir         (EvApplication   *application,
                                                       gboolean         create);
 const gchar      *ev_application_get_data_dir        (EvApplication   *application);
+void              ev_application_add_document        (EvApplication   *application,
+						      const gchar     *uri,
+						      EvDocument      *document);
+void              ev_application_release_document    (EvApplication   *application,
+						      EvDocument      *document);
+EvDocument       *ev_application_get_document        (EvApplication   *application,
+						      const gchar     *uri);
 
 G_END_DECLS
 
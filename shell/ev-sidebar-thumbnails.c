@@ -38,36 +38,41 @@
 #include "ev-sidebar-thumbnails.h"
 #include "ev-utils.h"
 #include "ev-window.h"
+#include "ev-thumbnail-store.h"
+#include "ev-thumbnails-model.h"
 
 #define THUMBNAIL_WIDTH 100
 
-/* The IconView doesn't scale nearly as well as the TreeView, so we arbitrarily
- * limit its use */
-#define MAX_ICON_VIEW_PAGE_COUNT 1500
-
-typedef struct _EvThumbsSize
-{
-	gint width;
-	gint height;
-} EvThumbsSize;
+/* Number of pages around the visible range whose thumbnails are kept
+ * when scrolling, all others are dropped from the model */
+#define VISIBLE_RANGE_MARGIN 10
 
+/* Thumbnail dimensions are derived from the page sizes already
+ * cached by the document, so creating it doesn't touch the backend.
+ */
 typedef struct _EvThumbsSizeCache {
+	EvDocument *document;
 	gboolean uniform;
 	gint uniform_width;
 	gint uniform_height;
-	EvThumbsSize *sizes;
+	/* Largest thumbnail, unrotated */
+	gint max_width;
+	gint max_height;
 } EvThumbsSizeCache;
 
 struct _EvSidebarThumbnailsPrivate {
 	GtkWidget *swindow;
 	GtkWidget *icon_view;
-	GtkWidget *tree_view;
+	GtkCellRenderer *pixbuf_renderer;
+	GtkCellRenderer *text_renderer;
 	GtkAdjustment *vadjustment;
-	GtkListStore *list_store;
+	EvThumbnailsModel *thumbnails_model;
 	GHashTable *loading_icons;
 	EvDocument *document;
 	EvDocumentModel *model;
 	EvThumbsSizeCache *size_cache;
+	EvThumbnailStore *thumbnail_store;
+	GList *thumbnail_jobs;
 
 	gint n_pages, pages_done;
 
@@ -78,25 +83,22 @@ struct _EvSidebarThumbnailsPrivate {
 	gint start_page, end_page;
 };
 
-enum {
-	COLUMN_PAGE_STRING,
-	COLUMN_PIXBUF,
-	COLUMN_THUMBNAIL_SET,
-	COLUMN_JOB,
-	NUM_COLUMNS
-};
-
 enum {
 	PROP_0,
 	PROP_WIDGET,
 };
 
 static void         ev_sidebar_thumbnails_clear_model      (EvSidebarThumbnails *sidebar);
+static void         ev_sidebar_thumbnails_set_view_model   (EvSidebarThumbnails *sidebar,
+							    GtkTreeModel        *model);
 static gboolean     ev_sidebar_thumbnails_support_document (EvSidebarPage       *sidebar_page,
 							    EvDocument          *document);
 static void         ev_sidebar_thumbnails_page_iface_init  (EvSidebarPageIface  *iface);
 static const gchar* ev_sidebar_thumbnails_get_label        (EvSidebarPage       *sidebar_page);
-static void         thumbnail_job_completed_callback       (EvJobThumbnail      *job,
+static void         thumbnails_job_updated_callback        (EvJobThumbnails     *job,
+							    GList               *results,
+							    EvSidebarThumbnails *sidebar_thumbnails);
+static void         thumbnails_job_finished_callback       (EvJobThumbnails     *job,
 							    EvSidebarThumbnails *sidebar_thumbnails);
 static void         adjustment_changed_cb                  (EvSidebarThumbnails *sidebar_thumbnails);
 
@@ -113,72 +115,52 @@ G_DEFINE_TYPE_EXTENDED (EvSidebarThumbnails,
 /* Thumbnails dimensions cache */
 #define EV_THUMBNAILS_SIZE_CACHE_KEY "ev-thumbnails-size-cache"
 
+static void
+ev_thumbnails_size_for_page_size (gdouble  page_width,
+				  gdouble  page_height,
+				  gint    *width,
+				  gint    *height)
+{
+	gdouble scale = (gdouble)THUMBNAIL_WIDTH / page_width;
+
+	*width = MAX ((gint)(page_width * scale + 0.5), 1);
+	*height = MAX ((gint)(page_height * scale + 0.5), 1);
+}
+
 static EvThumbsSizeCache *
 ev_thumbnails_size_cache_new (EvDocument *document)
 {
 	EvThumbsSizeCache *cache;
-	EvRenderContext *rc = NULL;
-	gint i, n_pages;
-	EvThumbsSize *thumb_size;
 
 	cache = g_new0 (EvThumbsSizeCache, 1);
 
-	n_pages = ev_document_get_n_pages (document);
+	/* The cache is attached to the document, so don't ref it */
+	cache->document = document;
+	cache->uniform = ev_document_is_page_size_uniform (document);
 
-	/* Assume all pages are the same size until proven otherwise */
-	cache->uniform = TRUE;
-
-	for (i = 0; i < n_pages; i++) {
-		EvPage *page;
+	if (cache->uniform) {
 		gdouble page_width, page_height;
-		gint    thumb_width = 0;
-		gint    thumb_height = 0;
-
-		page = ev_document_get_page (document, i);
-
-		ev_document_get_page_size (document, i, &page_width, &page_height);
-
-		if (!rc) {
-			rc = ev_render_context_new (page, 0, (gdouble)THUMBNAIL_WIDTH / page_width);
-		} else {
-			ev_render_context_set_page (rc, page);
-			ev_render_context_set_scale (rc, (gdouble)THUMBNAIL_WIDTH / page_width);
-		}
-
-		ev_document_thumbnails_get_dimensions (EV_DOCUMENT_THUMBNAILS (document),
-						       rc, &thumb_width, &thumb_height);
-
-		if (i == 0) {
-			cache->uniform_width = thumb_width;
-			cache->uniform_height = thumb_height;
-		} else if (cache->uniform &&
-			   (cache->uniform_width != thumb_width ||
-			    cache->uniform_height != thumb_height)) {
-			/* It's a different thumbnail size.  Backfill the array. */
-			int j;
-
-			cache->sizes = g_new0 (EvThumbsSize, n_pages);
-
-			for (j = 0; j < i; j++) {
-				thumb_size = &(cache->sizes[j]);
-				thumb_size->width = cache->uniform_width;
-				thumb_size->height = cache->uniform_height;
-			}
-			cache->uniform = FALSE;
-		}
 
-		if (! cache->uniform) {
-			thumb_size = &(cache->sizes[i]);
-
-			thumb_size->width = thumb_width;
-			thumb_size->height = thumb_height;
+		ev_document_get_page_size (document, 0, &page_width, &page_height);
+		ev_thumbnails_size_for_page_size (page_width, page_height,
+						  &cache->uniform_width,
+						  &cache->uniform_height);
+		cache->max_width = cache->uniform_width;
+		cache->max_height = cache->uniform_height;
+	} else {
+		gint n_pages = ev_document_get_n_pages (document);
+		gint i;
+
+		for (i = 0; i < n_pages; i++) {
+			gdouble page_width, page_height;
+			gint    width, height;
+
+			ev_document_get_page_size (document, i, &page_width, &page_height);
+			ev_thumbnails_size_for_page_size (page_width, page_height,
+							  &width, &height);
+			cache->max_width = MAX (cache->max_width, width);
+			cache->max_height = MAX (cache->max_height, height);
 		}
-
-		g_object_unref (page);
-	}
-
-	if (rc) {
-		g_object_unref (rc);
 	}
 
 	return cache;
@@ -197,12 +179,11 @@ ev_thumbnails_size_cache_get_size (EvThumbsSizeCache *cache,
 		w = cache->uniform_width;
 		h = cache->uniform_height;
 	} else {
-		EvThumbsSize *thumb_size;
-
-		thumb_size = &(cache->sizes[page]);
+		gdouble page_width, page_height;
 
-		w = thumb_size->width;
-		h = thumb_size->height;
+		ev_document_get_page_size (cache->document, page,
+					   &page_width, &page_height);
+		ev_thumbnails_size_for_page_size (page_width, page_height, &w, &h);
 	}
 
 	if (rotation == 0 || rotation == 180) {
@@ -217,11 +198,6 @@ ev_thumbnails_size_cache_get_size (EvThumbsSizeCache *cache,
 static void
 ev_thumbnails_size_cache_free (EvThumbsSizeCache *cache)
 {
-	if (cache->sizes) {
-		g_free (cache->sizes);
-		cache->sizes = NULL;
-	}
-
 	g_free (cache);
 }
 
@@ -248,16 +224,17 @@ ev_sidebar_thumbnails_dispose (GObject *object)
 {
 	EvSidebarThumbnails *sidebar_thumbnails = EV_SIDEBAR_THUMBNAILS (object);
 	
+	if (sidebar_thumbnails->priv->thumbnails_model) {
+		ev_sidebar_thumbnails_clear_model (sidebar_thumbnails);
+		ev_sidebar_thumbnails_set_view_model (sidebar_thumbnails, NULL);
+		g_object_unref (sidebar_thumbnails->priv->thumbnails_model);
+		sidebar_thumbnails->priv->thumbnails_model = NULL;
+	}
+
 	if (sidebar_thumbnails->priv->loading_icons) {
 		g_hash_table_destroy (sidebar_thumbnails->priv->loading_icons);
 		sidebar_thumbnails->priv->loading_icons = NULL;
 	}
-	
-	if (sidebar_thumbnails->priv->list_store) {
-		ev_sidebar_thumbnails_clear_model (sidebar_thumbnails);
-		g_object_unref (sidebar_thumbnails->priv->list_store);
-		sidebar_thumbnails->priv->list_store = NULL;
-	}
 
 	G_OBJECT_CLASS (ev_sidebar_thumbnails_parent_class)->dispose (object);
 }
@@ -272,10 +249,7 @@ ev_sidebar_thumbnails_get_property (GObject    *object,
 
 	switch (prop_id) {
 	case PROP_WIDGET:
-		if (sidebar->priv->tree_view)
-			g_value_set_object (value, sidebar->priv->tree_view);
-		else
-			g_value_set_object (value, sidebar->priv->icon_view);
+		g_value_set_object (value, sidebar->priv->icon_view);
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -348,120 +322,155 @@ ev_sidebar_thumbnails_get_loading_icon (EvSidebarThumbnails *sidebar_thumbnails,
 	return icon;
 }
 
+static GdkPixbuf *
+ev_sidebar_thumbnails_get_placeholder (gint     page,
+				       gpointer data)
+{
+	EvSidebarThumbnails *sidebar_thumbnails = EV_SIDEBAR_THUMBNAILS (data);
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	gint width, height;
+
+	ev_thumbnails_size_cache_get_size (priv->size_cache, page,
+					  priv->rotation,
+					  &width, &height);
+
+	return ev_sidebar_thumbnails_get_loading_icon (sidebar_thumbnails,
+						       width, height);
+}
+
 static void
 clear_range (EvSidebarThumbnails *sidebar_thumbnails,
 	     gint                 start_page,
 	     gint                 end_page)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreePath *path;
-	GtkTreeIter iter;
-	gboolean result;
-	gint prev_width = -1;
-	gint prev_height = -1;
 
 	g_assert (start_page <= end_page);
 
-	path = gtk_tree_path_new_from_indices (start_page, -1);
-	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->list_store), &iter, path);
-	     result && start_page <= end_page;
-	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->list_store), &iter), start_page ++) {
-		EvJobThumbnail *job;
-		GdkPixbuf *loading_icon = NULL;
-		gint width, height;
-
-		gtk_tree_model_get (GTK_TREE_MODEL (priv->list_store),
-				    &iter,
-				    COLUMN_JOB, &job,
-				    -1);
-
-		if (job) {
-			g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, sidebar_thumbnails);
-			ev_job_cancel (EV_JOB (job));
-			g_object_unref (job);
-		}
+	/* Range jobs are trimmed in update_visible_range(),
+	 * results for rows without job are ignored.
+	 */
+	for (; start_page <= end_page; start_page++)
+		ev_thumbnails_model_clear_page (priv->thumbnails_model, start_page);
+}
 
-		ev_thumbnails_size_cache_get_size (priv->size_cache, start_page,
-						  priv->rotation,
-						  &width, &height);
-		if (!loading_icon || (width != prev_width && height != prev_height)) {
-			loading_icon =
-				ev_sidebar_thumbnails_get_loading_icon (sidebar_thumbnails,
-									width, height);
-		}
+static gboolean
+page_needs_thumbnail (EvSidebarThumbnails *sidebar_thumbnails,
+		      gint                 page)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
 
-		prev_width = width;
-		prev_height = height;
+	return !ev_thumbnails_model_get_job (priv->thumbnails_model, page) &&
+		!ev_thumbnails_model_get_thumbnail_set (priv->thumbnails_model, page);
+}
+
+/* Finds the first and last pages of the range that need a thumbnail */
+static gboolean
+get_missing_range (EvSidebarThumbnails *sidebar_thumbnails,
+		   gint                 start_page,
+		   gint                 end_page,
+		   gint                *first_missing,
+		   gint                *last_missing)
+{
+	gint page;
 
-		gtk_list_store_set (priv->list_store, &iter,
-				    COLUMN_JOB, NULL,
-				    COLUMN_THUMBNAIL_SET, FALSE,
-				    COLUMN_PIXBUF, loading_icon,
-				    -1);
+	*first_missing = *last_missing = -1;
+	for (page = start_page; page <= end_page; page++) {
+		if (!page_needs_thumbnail (sidebar_thumbnails, page))
+			continue;
+
+		if (*first_missing == -1)
+			*first_missing = page;
+		*last_missing = page;
 	}
-	gtk_tree_path_free (path);
+
+	return *first_missing != -1;
 }
 
-static gdouble
-get_scale_for_page (EvSidebarThumbnails *sidebar_thumbnails,
-		    gint                 page)
+/* Sets the stored thumbnails of the pages from start_page to
+ * end_page that need one, all read in a single lookup.
+ */
+static void
+set_thumbnails_from_store (EvSidebarThumbnails *sidebar_thumbnails,
+			   gint                 start_page,
+			   gint                 end_page)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	gdouble width;
-
-	ev_document_get_page_size (priv->document, page, &width, NULL);
+	GdkPixbuf **thumbnails;
+	gint page;
+
+	thumbnails = g_new (GdkPixbuf *, end_page - start_page + 1);
+	ev_thumbnail_store_lookup_range (priv->thumbnail_store,
+					 start_page, end_page,
+					 priv->rotation, THUMBNAIL_WIDTH,
+					 thumbnails);
+
+	for (page = start_page; page <= end_page; page++) {
+		GdkPixbuf *thumbnail = thumbnails[page - start_page];
+
+		if (!thumbnail)
+			continue;
+
+		if (page_needs_thumbnail (sidebar_thumbnails, page)) {
+			if (priv->inverted_colors)
+				ev_document_misc_invert_pixbuf (thumbnail);
+			ev_thumbnails_model_set_thumbnail (priv->thumbnails_model,
+							   page, thumbnail);
+		}
+		g_object_unref (thumbnail);
+	}
 
-	return (gdouble)THUMBNAIL_WIDTH / width;
+	g_free (thumbnails);
 }
 
+/* Thumbnails missing in the range are rendered by a single
+ * EvJobThumbnails, so that results can be delivered in batches.
+ */
 static void
 add_range (EvSidebarThumbnails *sidebar_thumbnails,
 	   gint                 start_page,
 	   gint                 end_page)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreePath *path;
-	GtkTreeIter iter;
-	gboolean result;
-	gint page = start_page;
+	gint page;
+	gint first_missing;
+	gint last_missing;
+	EvJob *job;
 
 	g_assert (start_page <= end_page);
 
-	path = gtk_tree_path_new_from_indices (start_page, -1);
-	for (result = gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->list_store), &iter, path);
-	     result && page <= end_page;
-	     result = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->list_store), &iter), page ++) {
-		EvJob *job;
-		gboolean thumbnail_set;
-
-		gtk_tree_model_get (GTK_TREE_MODEL (priv->list_store), &iter,
-				    COLUMN_JOB, &job,
-				    COLUMN_THUMBNAIL_SET, &thumbnail_set,
-				    -1);
-
-		if (job == NULL && !thumbnail_set) {
-			job = ev_job_thumbnail_new (priv->document,
-						    page, priv->rotation,
-						    get_scale_for_page (sidebar_thumbnails, page));
-			ev_job_scheduler_push_job (EV_JOB (job), EV_JOB_PRIORITY_HIGH);
-			
-			g_object_set_data_full (G_OBJECT (job), "tree_iter",
-						gtk_tree_iter_copy (&iter),
-						(GDestroyNotify) gtk_tree_iter_free);
-			g_signal_connect (job, "finished",
-					  G_CALLBACK (thumbnail_job_completed_callback),
-					  sidebar_thumbnails);
-			gtk_list_store_set (priv->list_store, &iter,
-					    COLUMN_JOB, job,
-					    -1);
-			
-			/* The queue and the list own a ref to the job now */
-			g_object_unref (job);
-		} else if (job) {
-			g_object_unref (job);
-		}
+	end_page = MIN (end_page, priv->n_pages - 1);
+	if (!get_missing_range (sidebar_thumbnails, start_page, end_page,
+				&first_missing, &last_missing))
+		return;
+
+	if (priv->thumbnail_store) {
+		set_thumbnails_from_store (sidebar_thumbnails,
+					   first_missing, last_missing);
+		if (!get_missing_range (sidebar_thumbnails, first_missing, last_missing,
+					&first_missing, &last_missing))
+			return;
 	}
-	gtk_tree_path_free (path);
+
+	job = ev_job_thumbnails_new (priv->document,
+				     first_missing, last_missing,
+				     priv->rotation, THUMBNAIL_WIDTH);
+	g_signal_connect (job, "updated",
+			  G_CALLBACK (thumbnails_job_updated_callback),
+			  sidebar_thumbnails);
+	g_signal_connect (job, "finished",
+			  G_CALLBACK (thumbnails_job_finished_callback),
+			  sidebar_thumbnails);
+	priv->thumbnail_jobs = g_list_prepend (priv->thumbnail_jobs, job);
+
+	for (page = first_missing; page <= last_missing; page++) {
+		if (!page_needs_thumbnail (sidebar_thumbnails, page))
+			continue;
+
+		ev_thumbnails_model_set_job (priv->thumbnails_model, page, G_OBJECT (job));
+	}
+
+	ev_job_scheduler_push_job (job, EV_JOB_PRIORITY_HIGH);
 }
 
 /* This modifies start */
@@ -472,6 +481,7 @@ update_visible_range (EvSidebarThumbnails *sidebar_thumbnails,
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
 	int old_start_page, old_end_page;
+	GList *l;
 
 	old_start_page = priv->start_page;
 	old_end_page = priv->end_page;
@@ -480,12 +490,40 @@ update_visible_range (EvSidebarThumbnails *sidebar_thumbnails,
 	    end_page == old_end_page)
 		return;
 
-	/* Clear the areas we no longer display */
-	if (old_start_page >= 0 && old_start_page < start_page)
-		clear_range (sidebar_thumbnails, old_start_page, MIN (start_page - 1, old_end_page));
-	
-	if (old_end_page > 0 && old_end_page > end_page)
-		clear_range (sidebar_thumbnails, MAX (end_page + 1, old_start_page), old_end_page);
+	/* Clear the areas we no longer display, keeping a margin
+	 * around the visible range */
+	if (old_start_page >= 0) {
+		gint old_first = MAX (old_start_page - VISIBLE_RANGE_MARGIN, 0);
+		gint old_last = MIN (old_end_page + VISIBLE_RANGE_MARGIN, priv->n_pages - 1);
+		gint first = MAX (start_page - VISIBLE_RANGE_MARGIN, 0);
+		gint last = MIN (end_page + VISIBLE_RANGE_MARGIN, priv->n_pages - 1);
+
+		if (old_first < first)
+			clear_range (sidebar_thumbnails, old_first, MIN (first - 1, old_last));
+
+		if (old_last > last)
+			clear_range (sidebar_thumbnails, MAX (last + 1, old_first), old_last);
+	}
+
+	/* Don't render pages no longer visible. Their rows are released,
+	 * otherwise they would look pending and never be added to a new
+	 * job when scrolled back into view.
+	 */
+	for (l = priv->thumbnail_jobs; l; l = g_list_next (l)) {
+		EvJobThumbnails *job = EV_JOB_THUMBNAILS (l->data);
+		gint pending_start, pending_end;
+		gint page;
+
+		ev_job_thumbnails_trim_range (job, start_page, end_page,
+					      &pending_start, &pending_end);
+		for (page = pending_start; page <= pending_end; page++) {
+			if (page >= start_page && page <= end_page)
+				continue;
+
+			if (ev_thumbnails_model_get_job (priv->thumbnails_model, page) == G_OBJECT (job))
+				ev_thumbnails_model_set_job (priv->thumbnails_model, page, NULL);
+		}
+	}
 
 	add_range (sidebar_thumbnails, start_page, end_page);
 	
@@ -500,9 +538,6 @@ adjustment_changed_cb (EvSidebarThumbnails *sidebar_thumbnails)
 	GtkTreePath *path = NULL;
 	GtkTreePath *path2 = NULL;
 	gdouble page_size;
-	gdouble value;
-	gint wy1;
-	gint wy2;
 
 	/* Widget is not currently visible */
 	if (!gtk_widget_get_mapped (GTK_WIDGET (sidebar_thumbnails)))
@@ -513,32 +548,10 @@ adjustment_changed_cb (EvSidebarThumbnails *sidebar_thumbnails)
 	if (page_size == 0)
 		return;
 
-	value = gtk_adjustment_get_value (priv->vadjustment);
-	
-	if (priv->tree_view) {
-		if (! gtk_widget_get_realized (priv->tree_view))
-			return;
-
-		gtk_tree_view_convert_tree_to_bin_window_coords (GTK_TREE_VIEW (priv->tree_view),
-								 0, (int) value,
-								 NULL, &wy1);
-		gtk_tree_view_convert_tree_to_bin_window_coords (GTK_TREE_VIEW (priv->tree_view),
-								 0, (int) (value + page_size),
-								 NULL, &wy2);
-		gtk_tree_view_get_path_at_pos (GTK_TREE_VIEW (priv->tree_view),
-					       1, wy1 + 1, &path,
-					       NULL, NULL, NULL);
-		gtk_tree_view_get_path_at_pos (GTK_TREE_VIEW (priv->tree_view),
-					       1, wy2 -1, &path2,
-					       NULL, NULL, NULL);
-	} else if (priv->icon_view) {
-		if (! gtk_widget_get_realized (priv->icon_view))
-			return;
-		if (! gtk_icon_view_get_visible_range (GTK_ICON_VIEW (priv->icon_view), &path, &path2))
-			return;
-	} else {
+	if (!priv->icon_view || ! gtk_widget_get_realized (priv->icon_view))
+		return;
+	if (! gtk_icon_view_get_visible_range (GTK_ICON_VIEW (priv->icon_view), &path, &path2))
 		return;
-	}
 
 	if (path && path2) {
 		update_visible_range (sidebar_thumbnails,
@@ -550,64 +563,31 @@ adjustment_changed_cb (EvSidebarThumbnails *sidebar_thumbnails)
 	gtk_tree_path_free (path2);
 }
 
+/* Rows are created on demand by the model, so filling it doesn't
+ * depend on the number of pages. */
 static void
 ev_sidebar_thumbnails_fill_model (EvSidebarThumbnails *sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreeIter iter;
-	int i;
-	gint prev_width = -1;
-	gint prev_height = -1;
-
-	for (i = 0; i < sidebar_thumbnails->priv->n_pages; i++) {
-		gchar     *page_label;
-		gchar     *page_string;
-		GdkPixbuf *loading_icon = NULL;
-		gint       width, height;
-
-		page_label = ev_document_get_page_label (priv->document, i);
-		page_string = g_markup_printf_escaped ("<i>%s</i>", page_label);
-		ev_thumbnails_size_cache_get_size (sidebar_thumbnails->priv->size_cache, i,
-						  sidebar_thumbnails->priv->rotation,
-						  &width, &height);
-		if (!loading_icon || (width != prev_width && height != prev_height)) {
-			loading_icon =
-				ev_sidebar_thumbnails_get_loading_icon (sidebar_thumbnails,
-									width, height);
-		}
-
-		prev_width = width;
-		prev_height = height;
-		
-		gtk_list_store_append (priv->list_store, &iter);
-		gtk_list_store_set (priv->list_store, &iter,
-				    COLUMN_PAGE_STRING, page_string,
-				    COLUMN_PIXBUF, loading_icon,
-				    COLUMN_THUMBNAIL_SET, FALSE,
-				    -1);
-		g_free (page_label);
-		g_free (page_string);
-	}
+	EvThumbnailsModel *old_model = priv->thumbnails_model;
+
+	priv->thumbnails_model = ev_thumbnails_model_new (priv->document,
+							  ev_sidebar_thumbnails_get_placeholder,
+							  sidebar_thumbnails);
+	ev_sidebar_thumbnails_set_view_model (sidebar_thumbnails,
+					      GTK_TREE_MODEL (priv->thumbnails_model));
+	if (old_model)
+		g_object_unref (old_model);
 }
 
 static void
-ev_sidebar_tree_selection_changed (GtkTreeSelection *selection,
-				   EvSidebarThumbnails *ev_sidebar_thumbnails)
+ev_sidebar_thumbnails_set_view_model (EvSidebarThumbnails *sidebar_thumbnails,
+				      GtkTreeModel        *model)
 {
-	EvSidebarThumbnailsPrivate *priv = ev_sidebar_thumbnails->priv;
-	GtkTreePath *path;
-	GtkTreeIter iter;
-	int page;
-
-	if (!gtk_tree_selection_get_selected (selection, NULL, &iter))
-		return;
-
-	path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->list_store),
-					&iter);
-	page = gtk_tree_path_get_indices (path)[0];
-	gtk_tree_path_free (path);
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
 
-	ev_document_model_set_page (priv->model, page);
+	if (priv->icon_view)
+		gtk_icon_view_set_model (GTK_ICON_VIEW (priv->icon_view), model);
 }
 
 static void
@@ -635,33 +615,91 @@ ev_sidebar_icon_selection_changed (GtkIconView         *icon_view,
 	ev_document_model_set_page (priv->model, page);
 }
 
+/* The icon view measures every item on its first layout. Cells have
+ * a fixed size, and the text one doesn't lay its text out to be
+ * measured, so that showing the thumbnails of a document with tens of
+ * thousands of pages doesn't stall; the text is only laid out when
+ * the item is drawn.
+ */
+typedef GtkCellRendererText      EvFixedTextRenderer;
+typedef GtkCellRendererTextClass EvFixedTextRendererClass;
+
+static GType ev_fixed_text_renderer_get_type (void) G_GNUC_CONST;
+
+G_DEFINE_TYPE (EvFixedTextRenderer, ev_fixed_text_renderer, GTK_TYPE_CELL_RENDERER_TEXT)
+
 static void
-ev_sidebar_init_tree_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
+ev_fixed_text_renderer_get_size (GtkCellRenderer *cell,
+				 GtkWidget       *widget,
+				 GdkRectangle    *cell_area,
+				 gint            *x_offset,
+				 gint            *y_offset,
+				 gint            *width,
+				 gint            *height)
 {
-	EvSidebarThumbnailsPrivate *priv;
-	GtkTreeSelection *selection;
-	GtkCellRenderer *renderer;
+	/* gtk_cell_renderer_get_size() has already set the fixed size */
+	if (!cell_area && !width && !height) {
+		if (x_offset)
+			*x_offset = 0;
+		if (y_offset)
+			*y_offset = 0;
+		return;
+	}
 
-	priv = ev_sidebar_thumbnails->priv;
-	priv->tree_view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (priv->list_store));
-
-	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->tree_view));
-	g_signal_connect (selection, "changed",
-			  G_CALLBACK (ev_sidebar_tree_selection_changed), ev_sidebar_thumbnails);
-	gtk_tree_view_set_headers_visible (GTK_TREE_VIEW (priv->tree_view), FALSE);
-	renderer = g_object_new (GTK_TYPE_CELL_RENDERER_PIXBUF,
-				 "xpad", 2,
-				 "ypad", 2,
-				 NULL);
-	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (priv->tree_view), -1,
-						     NULL, renderer,
-						     "pixbuf", 1,
-						     NULL);
-	gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (priv->tree_view), -1,
-						     NULL, gtk_cell_renderer_text_new (),
-						     "markup", 0, NULL);
-	gtk_container_add (GTK_CONTAINER (priv->swindow), priv->tree_view);
-	gtk_widget_show (priv->tree_view);
+	GTK_CELL_RENDERER_CLASS (ev_fixed_text_renderer_parent_class)->get_size (cell, widget, cell_area,
+										 x_offset, y_offset,
+										 width, height);
+}
+
+static void
+ev_fixed_text_renderer_init (EvFixedTextRenderer *renderer)
+{
+}
+
+static void
+ev_fixed_text_renderer_class_init (EvFixedTextRendererClass *klass)
+{
+	GTK_CELL_RENDERER_CLASS (klass)->get_size = ev_fixed_text_renderer_get_size;
+}
+
+/* Every item gets the size of the largest thumbnail, plus a line of
+ * text for the page label.
+ */
+static void
+ev_sidebar_thumbnails_update_cell_sizes (EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	PangoLayout *layout;
+	gint width, height;
+	gint text_height;
+	gint xpad, ypad;
+
+	if (!priv->icon_view || !priv->size_cache)
+		return;
+
+	if (priv->rotation == 0 || priv->rotation == 180) {
+		width = priv->size_cache->max_width;
+		height = priv->size_cache->max_height;
+	} else {
+		width = priv->size_cache->max_height;
+		height = priv->size_cache->max_width;
+	}
+
+	gtk_cell_renderer_get_padding (priv->pixbuf_renderer, &xpad, &ypad);
+	gtk_cell_renderer_set_fixed_size (priv->pixbuf_renderer,
+					  width + 2 * xpad,
+					  height + 2 * ypad);
+
+	layout = gtk_widget_create_pango_layout (priv->icon_view, "0");
+	pango_layout_get_pixel_size (layout, NULL, &text_height);
+	g_object_unref (layout);
+
+	gtk_cell_renderer_get_padding (priv->text_renderer, &xpad, &ypad);
+	gtk_cell_renderer_set_fixed_size (priv->text_renderer,
+					  width + 2 * xpad,
+					  text_height + 2 * ypad);
+
+	gtk_widget_queue_resize (priv->icon_view);
 }
 
 static void
@@ -671,9 +709,25 @@ ev_sidebar_init_icon_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
 
 	priv = ev_sidebar_thumbnails->priv;
 
-	priv->icon_view = gtk_icon_view_new_with_model (GTK_TREE_MODEL (priv->list_store));
-	gtk_icon_view_set_markup_column (GTK_ICON_VIEW (priv->icon_view), 0);
-	gtk_icon_view_set_pixbuf_column (GTK_ICON_VIEW (priv->icon_view), 1);
+	priv->icon_view = gtk_icon_view_new_with_model (GTK_TREE_MODEL (priv->thumbnails_model));
+
+	priv->pixbuf_renderer = gtk_cell_renderer_pixbuf_new ();
+	gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (priv->icon_view),
+				    priv->pixbuf_renderer, FALSE);
+	gtk_cell_layout_add_attribute (GTK_CELL_LAYOUT (priv->icon_view),
+				       priv->pixbuf_renderer,
+				       "pixbuf", EV_THUMBNAILS_MODEL_COLUMN_PIXBUF);
+
+	priv->text_renderer = g_object_new (ev_fixed_text_renderer_get_type (),
+					    "ellipsize", PANGO_ELLIPSIZE_END,
+					    "xalign", 0.5,
+					    NULL);
+	gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (priv->icon_view),
+				    priv->text_renderer, FALSE);
+	gtk_cell_layout_add_attribute (GTK_CELL_LAYOUT (priv->icon_view),
+				       priv->text_renderer,
+				       "markup", EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING);
+
 	g_signal_connect (priv->icon_view, "selection-changed",
 			  G_CALLBACK (ev_sidebar_icon_selection_changed), ev_sidebar_thumbnails);
 
@@ -681,14 +735,6 @@ ev_sidebar_init_icon_view (EvSidebarThumbnails *ev_sidebar_thumbnails)
 	gtk_widget_show (priv->icon_view);
 }
 
-static gboolean
-ev_sidebar_thumbnails_use_icon_view (EvSidebarThumbnails *sidebar_thumbnails)
-{
-	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-
-	return (ev_document_get_n_pages (priv->document) <= MAX_ICON_VIEW_PAGE_COUNT);
-}
-
 static void
 ev_sidebar_thumbnails_init (EvSidebarThumbnails *ev_sidebar_thumbnails)
 {
@@ -696,12 +742,6 @@ ev_sidebar_thumbnails_init (EvSidebarThumbnails *ev_sidebar_thumbnails)
 
 	priv = ev_sidebar_thumbnails->priv = EV_SIDEBAR_THUMBNAILS_GET_PRIVATE (ev_sidebar_thumbnails);
 
-	priv->list_store = gtk_list_store_new (NUM_COLUMNS,
-					       G_TYPE_STRING,
-					       GDK_TYPE_PIXBUF,
-					       G_TYPE_BOOLEAN,
-					       EV_TYPE_JOB_THUMBNAIL);
-
 	priv->swindow = gtk_scrolled_window_new (NULL, NULL);
 	
 	/* We actually don't want GTK_POLICY_AUTOMATIC for horizontal scrollbar here
@@ -729,16 +769,11 @@ static void
 ev_sidebar_thumbnails_set_current_page (EvSidebarThumbnails *sidebar,
 					gint                 page)
 {
-	GtkTreeView *tree_view;
 	GtkTreePath *path;
 
 	path = gtk_tree_path_new_from_indices (page, -1);
 
-	if (sidebar->priv->tree_view) {
-		tree_view = GTK_TREE_VIEW (sidebar->priv->tree_view);
-		gtk_tree_view_set_cursor (tree_view, path, NULL, FALSE);
-		gtk_tree_view_scroll_to_cell (tree_view, path, NULL, FALSE, 0.0, 0.0);
-	} else if (sidebar->priv->icon_view) {
+	if (sidebar->priv->icon_view) {
 
 		g_signal_handlers_block_by_func
 			(sidebar->priv->icon_view,
@@ -804,6 +839,7 @@ ev_sidebar_thumbnails_rotation_changed_cb (EvDocumentModel     *model,
 	gint rotation = ev_document_model_get_rotation (model);
 
 	sidebar_thumbnails->priv->rotation = rotation;
+	ev_sidebar_thumbnails_update_cell_sizes (sidebar_thumbnails);
 	ev_sidebar_thumbnails_reload (sidebar_thumbnails);
 }
 
@@ -819,21 +855,71 @@ ev_sidebar_thumbnails_inverted_colors_changed_cb (EvDocumentModel     *model,
 }
 
 static void
-thumbnail_job_completed_callback (EvJobThumbnail      *job,
+thumbnails_job_updated_callback (EvJobThumbnails     *job,
+				 GList               *results,
+				 EvSidebarThumbnails *sidebar_thumbnails)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+	GList *l;
+
+	for (l = results; l; l = g_list_next (l)) {
+		EvJobThumbnailsResult *result = l->data;
+		GdkPixbuf *thumbnail;
+
+		if (priv->thumbnail_store) {
+			ev_thumbnail_store_add (priv->thumbnail_store,
+						result->page, job->rotation,
+						THUMBNAIL_WIDTH, result->thumbnail);
+		}
+
+		/* The row might have been scrolled out of the view */
+		if (ev_thumbnails_model_get_job (priv->thumbnails_model, result->page) != G_OBJECT (job))
+			continue;
+
+		if (priv->inverted_colors) {
+			/* The thumbnail might be shared with other jobs */
+			thumbnail = gdk_pixbuf_copy (result->thumbnail);
+			ev_document_misc_invert_pixbuf (thumbnail);
+		} else {
+			thumbnail = g_object_ref (result->thumbnail);
+		}
+
+		ev_thumbnails_model_set_thumbnail (priv->thumbnails_model,
+						   result->page, thumbnail);
+		g_object_unref (thumbnail);
+	}
+}
+
+static void
+ev_sidebar_thumbnails_remove_job (EvSidebarThumbnails *sidebar_thumbnails,
+				  EvJobThumbnails     *job)
+{
+	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
+
+	g_signal_handlers_disconnect_by_func (job, thumbnails_job_updated_callback,
+					      sidebar_thumbnails);
+	g_signal_handlers_disconnect_by_func (job, thumbnails_job_finished_callback,
+					      sidebar_thumbnails);
+	priv->thumbnail_jobs = g_list_remove (priv->thumbnail_jobs, job);
+	g_object_unref (job);
+}
+
+static void
+thumbnails_job_finished_callback (EvJobThumbnails     *job,
 				  EvSidebarThumbnails *sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	GtkTreeIter *iter;
+	gint page;
+
+	/* Release the rows whose thumbnail couldn't be rendered,
+	 * they will be requested again when they become visible.
+	 */
+	for (page = job->start_page; page <= job->end_page; page++) {
+		if (ev_thumbnails_model_get_job (priv->thumbnails_model, page) == G_OBJECT (job))
+			ev_thumbnails_model_set_job (priv->thumbnails_model, page, NULL);
+	}
 
-	iter = (GtkTreeIter *) g_object_get_data (G_OBJECT (job), "tree_iter");
-	if (priv->inverted_colors)
-		ev_document_misc_invert_pixbuf (job->thumbnail);
-	gtk_list_store_set (priv->list_store,
-			    iter,
-			    COLUMN_PIXBUF, job->thumbnail,
-			    COLUMN_THUMBNAIL_SET, TRUE,
-			    COLUMN_JOB, NULL,
-			    -1);
+	ev_sidebar_thumbnails_remove_job (sidebar_thumbnails, job);
 }
 
 static void
@@ -851,6 +937,7 @@ ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 	}
 
 	priv->size_cache = ev_thumbnails_size_cache_get (document);
+	priv->thumbnail_store = ev_thumbnail_store_get (document);
 	priv->document = document;
 	priv->n_pages = ev_document_get_n_pages (document);
 	priv->rotation = ev_document_model_get_rotation (model);
@@ -863,30 +950,12 @@ ev_sidebar_thumbnails_document_changed_cb (EvDocumentModel     *model,
 	ev_sidebar_thumbnails_clear_model (sidebar_thumbnails);
 	ev_sidebar_thumbnails_fill_model (sidebar_thumbnails);
 
-	/* Create the view widget, and remove the old one, if needed */
-	if (ev_sidebar_thumbnails_use_icon_view (sidebar_thumbnails)) {
-		if (priv->tree_view) {
-			gtk_container_remove (GTK_CONTAINER (priv->swindow), priv->tree_view);
-			priv->tree_view = NULL;
-		}
-
-		if (! priv->icon_view) {
-			ev_sidebar_init_icon_view (sidebar_thumbnails);
-			g_object_notify (G_OBJECT (sidebar_thumbnails), "main_widget");
-		} else {
-			gtk_widget_queue_resize (priv->icon_view);
-		}
-	} else {
-		if (priv->icon_view) {
-			gtk_container_remove (GTK_CONTAINER (priv->swindow), priv->icon_view);
-			priv->icon_view = NULL;
-		}
-
-		if (! priv->tree_view) {
-			ev_sidebar_init_tree_view (sidebar_thumbnails);
-			g_object_notify (G_OBJECT (sidebar_thumbnails), "main_widget");
-		}
+	/* Create the view widget, if needed */
+	if (! priv->icon_view) {
+		ev_sidebar_init_icon_view (sidebar_thumbnails);
+		g_object_notify (G_OBJECT (sidebar_thumbnails), "main_widget");
 	}
+	ev_sidebar_thumbnails_update_cell_sizes (sidebar_thumbnails);
 
 	/* Connect to the signal and trigger a fake callback */
 	g_signal_connect_swapped (priv->model, "page-changed",
@@ -921,32 +990,21 @@ ev_sidebar_thumbnails_set_model (EvSidebarPage   *sidebar_page,
 			  sidebar_page);
 }
 
-static gboolean
-ev_sidebar_thumbnails_clear_job (GtkTreeModel *model,                                             
-			         GtkTreePath *path,
-			         GtkTreeIter *iter,
-				 gpointer data)
-{
-	EvJob *job;
-	
-	gtk_tree_model_get (model, iter, COLUMN_JOB, &job, -1);
-	
-	if (job != NULL) {
-		ev_job_cancel (job);
-		g_signal_handlers_disconnect_by_func (job, thumbnail_job_completed_callback, data);
-		g_object_unref (job);
-	}
-	
-	return FALSE;    
-}
-
 static void 
 ev_sidebar_thumbnails_clear_model (EvSidebarThumbnails *sidebar_thumbnails)
 {
 	EvSidebarThumbnailsPrivate *priv = sidebar_thumbnails->priv;
-	
-	gtk_tree_model_foreach (GTK_TREE_MODEL (priv->list_store), ev_sidebar_thumbnails_clear_job, sidebar_thumbnails);
-	gtk_list_store_clear (priv->list_store);
+
+	while (priv->thumbnail_jobs) {
+		EvJob *job = priv->thumbnail_jobs->data;
+
+		ev_job_cancel (job);
+		ev_sidebar_thumbnails_remove_job (sidebar_thumbnails,
+						  EV_JOB_THUMBNAILS (job));
+	}
+
+	if (priv->thumbnails_model)
+		ev_thumbnails_model_clear (priv->thumbnails_model);
 }
 
 static gboolean
@@ -0,0 +1,744 @@
+/* ev-thumbnail-store.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "ev-thumbnail-store.h"
+
+/* Thumbnails of a document are stored in a single file in the user
+ * cache dir, named after the md5 of the document uri. The file starts
+ * with a header identifying the version of the document, followed by
+ * an append-only sequence of records: a StoreRecord with the pixel
+ * data right after it, in native byte order and without row padding.
+ * The index is built by scanning the records when the store is
+ * opened, and the pixel data is read from a mapping of the file.
+ *
+ * Other instances might be using the same file, so it's only read
+ * with a shared lock on it and written with an exclusive one. Records
+ * are always appended at the real end of the file, whatever this
+ * instance wrote before. Locks are taken with the store mutex held,
+ * flock() doesn't exclude threads sharing the same file descriptor.
+ */
+#define STORE_MAGIC       "EVTHMB01"
+#define STORE_DATA_KEY    "ev-thumbnail-store"
+#define STORE_URI_KEY     "ev-thumbnail-store-uri"
+
+/* Stores are touched every time they are opened. The ones not used
+ * for STORE_MAX_AGE are removed, and then the least recently used
+ * ones until the directory takes no more than STORE_DIR_MAX_SIZE.
+ */
+#define STORE_MAX_AGE      (30 * 24 * 60 * 60)
+#define STORE_DIR_MAX_SIZE (64 * 1024 * 1024)
+
+typedef struct {
+	gchar   magic[8];
+	guint64 mtime;
+	guint64 file_size;
+} StoreHeader;
+
+typedef struct {
+	guint32 page;
+	guint16 rotation;
+	guint16 size;
+	guint32 width;
+	guint32 height;
+	guint32 n_channels;
+	guint32 reserved;
+} StoreRecord;
+
+typedef struct {
+	gint   page;
+	gint   rotation;
+	gint   size;
+
+	gint   width;
+	gint   height;
+	gint   n_channels;
+	gsize  data_size;
+	goffset data_offset;
+} StoreEntry;
+
+typedef struct {
+	gint       page;
+	gint       rotation;
+	gint       size;
+	GdkPixbuf *thumbnail;
+} StoreTask;
+
+struct _EvThumbnailStore {
+	gchar       *filename;
+	gint         fd;
+	StoreHeader  header;
+
+	/* Protects index and mapped, and serializes the file locks */
+	GMutex      *mutex;
+	GHashTable  *index;
+	GMappedFile *mapped;
+
+	GThreadPool *writer;
+};
+
+static guint
+store_entry_hash (gconstpointer v)
+{
+	const StoreEntry *entry = v;
+
+	return entry->page ^ (entry->rotation << 20) ^ (entry->size << 24);
+}
+
+static gboolean
+store_entry_equal (gconstpointer a,
+		   gconstpointer b)
+{
+	const StoreEntry *ea = a;
+	const StoreEntry *eb = b;
+
+	return ea->page == eb->page &&
+		ea->rotation == eb->rotation &&
+		ea->size == eb->size;
+}
+
+static void
+store_entry_free (StoreEntry *entry)
+{
+	g_slice_free (StoreEntry, entry);
+}
+
+/* Returns 0 for records that can't be a thumbnail, the file might
+ * have been damaged. Pixbufs need the sizes to fit in a gint.
+ */
+static gsize
+store_record_data_size (const StoreRecord *record)
+{
+	gsize row_size;
+
+	if (record->n_channels != 3 && record->n_channels != 4)
+		return 0;
+
+	if (record->width == 0 || record->width > G_MAXINT / 4 ||
+	    record->height == 0 || record->height > G_MAXINT)
+		return 0;
+
+	row_size = (gsize)record->width * record->n_channels;
+	if (record->height > G_MAXSIZE / row_size)
+		return 0;
+
+	return row_size * record->height;
+}
+
+static void
+ev_thumbnail_store_add_entry (EvThumbnailStore  *store,
+			      const StoreRecord *record,
+			      goffset            data_offset)
+{
+	StoreEntry *entry;
+
+	entry = g_slice_new (StoreEntry);
+	entry->page = record->page;
+	entry->rotation = record->rotation;
+	entry->size = record->size;
+	entry->width = record->width;
+	entry->height = record->height;
+	entry->n_channels = record->n_channels;
+	entry->data_size = store_record_data_size (record);
+	entry->data_offset = data_offset;
+
+	g_hash_table_replace (store->index, entry, entry);
+}
+
+/* Builds the index, returns the length of the valid part of the file */
+static goffset
+ev_thumbnail_store_scan (EvThumbnailStore *store)
+{
+	const gchar *contents;
+	gsize        length;
+	goffset      offset = sizeof (StoreHeader);
+
+	length = g_mapped_file_get_length (store->mapped);
+	contents = g_mapped_file_get_contents (store->mapped);
+
+	while (offset + sizeof (StoreRecord) <= length) {
+		StoreRecord record;
+		gsize       data_size;
+
+		memcpy (&record, contents + offset, sizeof (StoreRecord));
+		data_size = store_record_data_size (&record);
+		if (data_size == 0 ||
+		    data_size > length - offset - sizeof (StoreRecord))
+			break;
+
+		ev_thumbnail_store_add_entry (store, &record,
+					      offset + sizeof (StoreRecord));
+		offset += sizeof (StoreRecord) + data_size;
+	}
+
+	return offset;
+}
+
+/* Whether the file still belongs to the version of the document the
+ * store was opened for, another instance might have started it from
+ * scratch for a newer one. Must be called with the file locked.
+ */
+static gboolean
+ev_thumbnail_store_check_header (EvThumbnailStore *store)
+{
+	StoreHeader header;
+
+	if (pread (store->fd, &header, sizeof (StoreHeader), 0) != sizeof (StoreHeader))
+		return FALSE;
+
+	return memcmp (&header, &store->header, sizeof (StoreHeader)) == 0;
+}
+
+static gboolean
+ev_thumbnail_store_open (EvThumbnailStore *store,
+			 guint64           mtime,
+			 guint64           file_size)
+{
+	gboolean valid;
+	goffset  length;
+
+	memset (&store->header, 0, sizeof (StoreHeader));
+	memcpy (store->header.magic, STORE_MAGIC, sizeof (store->header.magic));
+	store->header.mtime = mtime;
+	store->header.file_size = file_size;
+
+	store->fd = g_open (store->filename, O_RDWR | O_CREAT | O_APPEND, 0600);
+	if (store->fd < 0)
+		return FALSE;
+
+	if (flock (store->fd, LOCK_EX) < 0)
+		return FALSE;
+
+	valid = ev_thumbnail_store_check_header (store);
+	if (valid) {
+		store->mapped = g_mapped_file_new (store->filename, FALSE, NULL);
+		valid = store->mapped != NULL;
+	}
+
+	if (valid) {
+		length = ev_thumbnail_store_scan (store);
+		/* Drop any record left incomplete by a crashed writer,
+		 * the lock makes sure nobody is writing it right now.
+		 */
+		if (length < (goffset)g_mapped_file_get_length (store->mapped))
+			valid = ftruncate (store->fd, length) == 0;
+	} else {
+		/* The document changed, start from scratch */
+		valid = ftruncate (store->fd, 0) == 0 &&
+			write (store->fd, &store->header, sizeof (StoreHeader)) == sizeof (StoreHeader);
+	}
+
+	flock (store->fd, LOCK_UN);
+
+	return valid;
+}
+
+/* Runs in the writer thread */
+static void
+ev_thumbnail_store_write (StoreTask        *task,
+			  EvThumbnailStore *store)
+{
+	StoreRecord record;
+	guchar     *buffer;
+	guchar     *pixels;
+	gsize       row_size;
+	gsize       data_size;
+	gssize      written;
+	struct stat st;
+	gint        rowstride;
+	guint       i;
+
+	memset (&record, 0, sizeof (StoreRecord));
+	record.page = task->page;
+	record.rotation = task->rotation;
+	record.size = task->size;
+	record.width = gdk_pixbuf_get_width (task->thumbnail);
+	record.height = gdk_pixbuf_get_height (task->thumbnail);
+	record.n_channels = gdk_pixbuf_get_n_channels (task->thumbnail);
+
+	row_size = record.width * record.n_channels;
+	data_size = store_record_data_size (&record);
+
+	buffer = g_malloc (sizeof (StoreRecord) + data_size);
+	memcpy (buffer, &record, sizeof (StoreRecord));
+
+	pixels = gdk_pixbuf_get_pixels (task->thumbnail);
+	rowstride = gdk_pixbuf_get_rowstride (task->thumbnail);
+	for (i = 0; i < record.height; i++) {
+		memcpy (buffer + sizeof (StoreRecord) + i * row_size,
+			pixels + i * rowstride, row_size);
+	}
+
+	g_mutex_lock (store->mutex);
+
+	/* O_APPEND writes at the end of the file, which is
+	 * where other instances might have appended records too.
+	 */
+	if (flock (store->fd, LOCK_EX) == 0) {
+		if (ev_thumbnail_store_check_header (store) && fstat (store->fd, &st) == 0) {
+			written = write (store->fd, buffer, sizeof (StoreRecord) + data_size);
+			if (written == (gssize)(sizeof (StoreRecord) + data_size)) {
+				ev_thumbnail_store_add_entry (store, &record,
+							      st.st_size + sizeof (StoreRecord));
+			} else if (written > 0 && ftruncate (store->fd, st.st_size) < 0) {
+				g_warning ("Error truncating thumbnail store %s: %s",
+					   store->filename, g_strerror (errno));
+			}
+		}
+		flock (store->fd, LOCK_UN);
+	}
+
+	g_mutex_unlock (store->mutex);
+
+	g_free (buffer);
+	g_object_unref (task->thumbnail);
+	g_slice_free (StoreTask, task);
+}
+
+static void
+ev_thumbnail_store_free (EvThumbnailStore *store)
+{
+	if (store->writer)
+		g_thread_pool_free (store->writer, FALSE, TRUE);
+	if (store->fd >= 0)
+		close (store->fd);
+	if (store->mapped)
+		g_mapped_file_free (store->mapped);
+	g_hash_table_destroy (store->index);
+	g_mutex_free (store->mutex);
+	g_free (store->filename);
+	g_free (store);
+}
+
+typedef struct {
+	gchar  *filename;
+	time_t  mtime;
+	goffset size;
+} StoreFile;
+
+static gint
+store_file_compare_mtime (const StoreFile *a,
+			  const StoreFile *b)
+{
+	return a->mtime < b->mtime ? -1 : a->mtime > b->mtime ? 1 : 0;
+}
+
+/* Runs in its own thread, once per session */
+static gpointer
+ev_thumbnail_store_clean_dir (gchar *dirname)
+{
+	GDir        *dir;
+	const gchar *name;
+	GList       *files = NULL;
+	GList       *l;
+	goffset      total_size = 0;
+	time_t       now = time (NULL);
+
+	dir = g_dir_open (dirname, 0, NULL);
+	if (!dir) {
+		g_free (dirname);
+
+		return NULL;
+	}
+
+	while ((name = g_dir_read_name (dir))) {
+		StoreFile *file;
+		gchar     *filename;
+		struct stat st;
+
+		if (!g_str_has_suffix (name, ".cache"))
+			continue;
+
+		filename = g_build_filename (dirname, name, NULL);
+		if (g_stat (filename, &st) < 0) {
+			g_free (filename);
+			continue;
+		}
+
+		if (now - st.st_mtime > STORE_MAX_AGE) {
+			g_unlink (filename);
+			g_free (filename);
+			continue;
+		}
+
+		file = g_slice_new (StoreFile);
+		file->filename = filename;
+		file->mtime = st.st_mtime;
+		file->size = st.st_size;
+		files = g_list_prepend (files, file);
+		total_size += st.st_size;
+	}
+	g_dir_close (dir);
+
+	/* Least recently used first */
+	files = g_list_sort (files, (GCompareFunc)store_file_compare_mtime);
+	for (l = files; l; l = g_list_next (l)) {
+		StoreFile *file = l->data;
+
+		if (total_size > STORE_DIR_MAX_SIZE && g_unlink (file->filename) == 0)
+			total_size -= file->size;
+
+		g_free (file->filename);
+		g_slice_free (StoreFile, file);
+	}
+	g_list_free (files);
+	g_free (dirname);
+
+	return NULL;
+}
+
+static gchar *
+ev_thumbnail_store_get_filename (const gchar *uri)
+{
+	static gboolean cleaned = FALSE;
+	gchar *md5;
+	gchar *basename;
+	gchar *dirname;
+	gchar *filename;
+
+	dirname = g_build_filename (g_get_user_cache_dir (),
+				    "evince", "thumbnails", NULL);
+	if (g_mkdir_with_parents (dirname, 0700) < 0) {
+		g_free (dirname);
+
+		return NULL;
+	}
+
+	if (!cleaned) {
+		cleaned = TRUE;
+		g_thread_create ((GThreadFunc)ev_thumbnail_store_clean_dir,
+				 g_strdup (dirname), FALSE, NULL);
+	}
+
+	md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, uri, -1);
+	basename = g_strconcat (md5, ".cache", NULL);
+	filename = g_build_filename (dirname, basename, NULL);
+	g_free (md5);
+	g_free (basename);
+	g_free (dirname);
+
+	return filename;
+}
+
+static EvThumbnailStore *
+ev_thumbnail_store_new (EvDocument *document)
+{
+	EvThumbnailStore *store;
+	const gchar      *uri;
+	GFile            *file;
+	GFileInfo        *info;
+	guint64           mtime;
+	guint64           file_size;
+
+	uri = g_object_get_data (G_OBJECT (document), STORE_URI_KEY);
+	if (!uri)
+		return NULL;
+
+	file = g_file_new_for_uri (uri);
+	if (!g_file_is_native (file)) {
+		g_object_unref (file);
+
+		return NULL;
+	}
+
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+				  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+				  G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	g_object_unref (file);
+	if (!info)
+		return NULL;
+
+	mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+	file_size = g_file_info_get_size (info);
+	g_object_unref (info);
+
+	store = g_new0 (EvThumbnailStore, 1);
+	store->fd = -1;
+	store->mutex = g_mutex_new ();
+	store->index = g_hash_table_new_full (store_entry_hash,
+					      store_entry_equal,
+					      NULL,
+					      (GDestroyNotify)store_entry_free);
+	store->filename = ev_thumbnail_store_get_filename (uri);
+
+	if (!store->filename || !ev_thumbnail_store_open (store, mtime, file_size)) {
+		ev_thumbnail_store_free (store);
+
+		return NULL;
+	}
+
+	/* Keep it from expiring */
+	g_utime (store->filename, NULL);
+
+	store->writer = g_thread_pool_new ((GFunc)ev_thumbnail_store_write,
+					   store, 1, FALSE, NULL);
+
+	return store;
+}
+
+/**
+ * ev_thumbnail_store_set_uri:
+ * @document: an #EvDocument
+ * @uri: the uri of the file the user opened
+ *
+ * Called by the window before showing @document, so that its
+ * thumbnails are stored for @uri. That's not necessarily the uri
+ * of @document, compressed documents are loaded from an uncompressed
+ * temporary copy. Documents loaded from a temporary copy of a remote
+ * file don't get a store, windows just don't call this for them.
+ */
+void
+ev_thumbnail_store_set_uri (EvDocument  *document,
+			    const gchar *uri)
+{
+	g_return_if_fail (EV_IS_DOCUMENT (document));
+	g_return_if_fail (uri != NULL);
+
+	if (g_object_get_data (G_OBJECT (document), STORE_URI_KEY))
+		return;
+
+	g_object_set_data_full (G_OBJECT (document), STORE_URI_KEY,
+				g_strdup (uri), (GDestroyNotify)g_free);
+}
+
+/**
+ * ev_thumbnail_store_get:
+ * @document: an #EvDocument
+ *
+ * Returns: the thumbnail store of @document, or %NULL if thumbnails of
+ * @document can't be stored, see ev_thumbnail_store_set_uri(). The
+ * store is owned by @document.
+ */
+EvThumbnailStore *
+ev_thumbnail_store_get (EvDocument *document)
+{
+	EvThumbnailStore *store;
+
+	store = g_object_get_data (G_OBJECT (document), STORE_DATA_KEY);
+	if (!store) {
+		store = ev_thumbnail_store_new (document);
+		if (store) {
+			g_object_set_data_full (G_OBJECT (document),
+						STORE_DATA_KEY,
+						store,
+						(GDestroyNotify)ev_thumbnail_store_free);
+		}
+	}
+
+	return store;
+}
+
+/* Reads the thumbnail of entry from the mapping, after checking that
+ * the record there still describes it. Must be called with the file
+ * locked. Returns %NULL on failure.
+ */
+static GdkPixbuf *
+ev_thumbnail_store_read_entry (EvThumbnailStore *store,
+			       const StoreEntry *entry)
+{
+	const gchar *contents;
+	StoreRecord  record;
+	GdkPixbuf   *thumbnail;
+	guchar      *pixels;
+	gsize        length;
+	gsize        row_size;
+	gint         rowstride;
+	gint         i;
+
+	length = g_mapped_file_get_length (store->mapped);
+	if (entry->data_offset < (goffset)sizeof (StoreRecord) ||
+	    (gsize)entry->data_offset > length ||
+	    entry->data_size > length - entry->data_offset)
+		return NULL;
+
+	contents = g_mapped_file_get_contents (store->mapped);
+	memcpy (&record, contents + entry->data_offset - sizeof (StoreRecord),
+		sizeof (StoreRecord));
+	if (record.page != (guint32)entry->page ||
+	    record.rotation != entry->rotation ||
+	    record.size != entry->size ||
+	    record.width != (guint32)entry->width ||
+	    record.height != (guint32)entry->height ||
+	    record.n_channels != (guint32)entry->n_channels ||
+	    store_record_data_size (&record) != entry->data_size)
+		return NULL;
+
+	thumbnail = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
+				    entry->n_channels == 4,
+				    8, entry->width, entry->height);
+	if (!thumbnail)
+		return NULL;
+
+	pixels = gdk_pixbuf_get_pixels (thumbnail);
+	rowstride = gdk_pixbuf_get_rowstride (thumbnail);
+	row_size = entry->width * entry->n_channels;
+	contents += entry->data_offset;
+
+	for (i = 0; i < entry->height; i++)
+		memcpy (pixels + i * rowstride, contents + i * row_size, row_size);
+
+	return thumbnail;
+}
+
+/**
+ * ev_thumbnail_store_lookup_range:
+ * @store: an #EvThumbnailStore
+ * @start_page: the first page index
+ * @end_page: the last page index
+ * @rotation: the rotation of the thumbnails
+ * @size: the width requested for the thumbnails
+ * @thumbnails: return location for @end_page - @start_page + 1 thumbnails
+ *
+ * Looks up the thumbnails of the pages from @start_page to @end_page,
+ * locking and checking the file only once for the whole range. Every
+ * element of @thumbnails is set to a newly created #GdkPixbuf with the
+ * stored thumbnail of its page, or to %NULL if it's not in the store.
+ *
+ * Returns: the number of thumbnails found
+ */
+gint
+ev_thumbnail_store_lookup_range (EvThumbnailStore *store,
+				 gint              start_page,
+				 gint              end_page,
+				 gint              rotation,
+				 gint              size,
+				 GdkPixbuf       **thumbnails)
+{
+	StoreEntry key;
+	goffset    end = 0;
+	gint       n_found = 0;
+	gint       page;
+
+	g_return_val_if_fail (start_page <= end_page, 0);
+
+	memset (thumbnails, 0, (end_page - start_page + 1) * sizeof (GdkPixbuf *));
+
+	key.rotation = rotation;
+	key.size = size;
+
+	g_mutex_lock (store->mutex);
+
+	for (page = start_page; page <= end_page; page++) {
+		StoreEntry *entry;
+
+		key.page = page;
+		entry = g_hash_table_lookup (store->index, &key);
+		if (entry)
+			end = MAX (end, entry->data_offset + (goffset)entry->data_size);
+	}
+
+	/* None of the pages is stored, there's no need to lock the file */
+	if (end == 0) {
+		g_mutex_unlock (store->mutex);
+
+		return 0;
+	}
+
+	/* The file can't be truncated by another instance while it's
+	 * read, the mapping would be left pointing past its end.
+	 */
+	if (flock (store->fd, LOCK_SH) < 0) {
+		g_mutex_unlock (store->mutex);
+
+		return 0;
+	}
+
+	/* Another instance started the file from scratch for a newer
+	 * version of the document, nothing in the index is valid anymore.
+	 */
+	if (!ev_thumbnail_store_check_header (store)) {
+		g_hash_table_remove_all (store->index);
+		flock (store->fd, LOCK_UN);
+		g_mutex_unlock (store->mutex);
+
+		return 0;
+	}
+
+	/* Records were appended after the file was mapped */
+	if (!store->mapped ||
+	    (goffset)g_mapped_file_get_length (store->mapped) < end) {
+		if (store->mapped)
+			g_mapped_file_free (store->mapped);
+		store->mapped = g_mapped_file_new (store->filename, FALSE, NULL);
+	}
+
+	for (page = start_page; store->mapped && page <= end_page; page++) {
+		StoreEntry *entry;
+
+		key.page = page;
+		entry = g_hash_table_lookup (store->index, &key);
+		if (!entry)
+			continue;
+
+		thumbnails[page - start_page] = ev_thumbnail_store_read_entry (store, entry);
+		if (thumbnails[page - start_page])
+			n_found++;
+	}
+
+	flock (store->fd, LOCK_UN);
+	g_mutex_unlock (store->mutex);
+
+	return n_found;
+}
+
+/**
+ * ev_thumbnail_store_add:
+ * @store: an #EvThumbnailStore
+ * @page: the page index
+ * @rotation: the rotation of the thumbnail
+ * @size: the width requested for the thumbnail
+ * @thumbnail: the thumbnail
+ *
+ * Schedules @thumbnail to be written to the store. @thumbnail must
+ * not be modified afterwards.
+ */
+void
+ev_thumbnail_store_add (EvThumbnailStore *store,
+			gint              page,
+			gint              rotation,
+			gint              size,
+			GdkPixbuf        *thumbnail)
+{
+	StoreTask *task;
+
+	g_return_if_fail (GDK_IS_PIXBUF (thumbnail));
+
+	if (gdk_pixbuf_get_bits_per_sample (thumbnail) != 8)
+		return;
+
+	task = g_slice_new (StoreTask);
+	task->page = page;
+	task->rotation = rotation;
+	task->size = size;
+	task->thumbnail = g_object_ref (thumbnail);
+
+	g_thread_pool_push (store->writer, task, NULL);
+}
@@ -0,0 +1,48 @@
+/* ev-thumbnail-store.h
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef EV_THUMBNAIL_STORE_H
+#define EV_THUMBNAIL_STORE_H
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "ev-document.h"
+
+G_BEGIN_DECLS
+
+typedef struct _EvThumbnailStore EvThumbnailStore;
+
+void              ev_thumbnail_store_set_uri      (EvDocument       *document,
+						   const gchar      *uri);
+EvThumbnailStore *ev_thumbnail_store_get          (EvDocument       *document);
+gint              ev_thumbnail_store_lookup_range (EvThumbnailStore *store,
+						   gint              start_page,
+						   gint              end_page,
+						   gint              rotation,
+						   gint              size,
+						   GdkPixbuf       **thumbnails);
+void              ev_thumbnail_store_add          (EvThumbnailStore *store,
+						   gint              page,
+						   gint              rotation,
+						   gint              size,
+						   GdkPixbuf        *thumbnail);
+
+G_END_DECLS
+
+#endif /* EV_THUMBNAIL_STORE_H */
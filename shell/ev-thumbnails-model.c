@@ -0,0 +1,439 @@
+/* ev-thumbnails-model.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <config.h>
+
+#include "ev-thumbnails-model.h"
+
+/* A list model with one row per page of the document. Rows don't
+ * exist in memory until a thumbnail or a job is set for them, every
+ * other row is computed on demand from the document and the
+ * placeholder function, so the cost of the model doesn't depend on
+ * the number of pages.
+ */
+
+typedef struct {
+	GdkPixbuf *thumbnail;
+	GObject   *job;
+} EvThumbnailsModelRow;
+
+struct _EvThumbnailsModel {
+	GObject parent;
+
+	EvDocument *document;
+	gint        n_pages;
+	gint        stamp;
+
+	EvThumbnailsModelPlaceholderFunc placeholder_func;
+	gpointer                         user_data;
+
+	/* Materialized rows, indexed by page */
+	GHashTable *rows;
+};
+
+struct _EvThumbnailsModelClass {
+	GObjectClass parent_class;
+};
+
+static void ev_thumbnails_model_tree_model_iface_init (GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (EvThumbnailsModel, ev_thumbnails_model, G_TYPE_OBJECT,
+			 G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL,
+						ev_thumbnails_model_tree_model_iface_init))
+
+#define ITER_PAGE(iter) (GPOINTER_TO_INT ((iter)->user_data))
+
+static void
+ev_thumbnails_model_row_free (EvThumbnailsModelRow *row)
+{
+	if (row->thumbnail)
+		g_object_unref (row->thumbnail);
+	if (row->job)
+		g_object_unref (row->job);
+	g_slice_free (EvThumbnailsModelRow, row);
+}
+
+static void
+ev_thumbnails_model_finalize (GObject *object)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (object);
+
+	g_hash_table_destroy (model->rows);
+	if (model->document)
+		g_object_unref (model->document);
+
+	G_OBJECT_CLASS (ev_thumbnails_model_parent_class)->finalize (object);
+}
+
+static void
+ev_thumbnails_model_init (EvThumbnailsModel *model)
+{
+	model->stamp = g_random_int ();
+	model->rows = g_hash_table_new_full (g_direct_hash,
+					     g_direct_equal,
+					     NULL,
+					     (GDestroyNotify)ev_thumbnails_model_row_free);
+}
+
+static void
+ev_thumbnails_model_class_init (EvThumbnailsModelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+	object_class->finalize = ev_thumbnails_model_finalize;
+}
+
+/* GtkTreeModel */
+static GtkTreeModelFlags
+ev_thumbnails_model_get_flags (GtkTreeModel *tree_model)
+{
+	return GTK_TREE_MODEL_LIST_ONLY | GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+static gint
+ev_thumbnails_model_get_n_columns (GtkTreeModel *tree_model)
+{
+	return EV_THUMBNAILS_MODEL_N_COLUMNS;
+}
+
+static GType
+ev_thumbnails_model_get_column_type (GtkTreeModel *tree_model,
+				     gint          column)
+{
+	switch (column) {
+	case EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING:
+		return G_TYPE_STRING;
+	case EV_THUMBNAILS_MODEL_COLUMN_PIXBUF:
+		return GDK_TYPE_PIXBUF;
+	case EV_THUMBNAILS_MODEL_COLUMN_THUMBNAIL_SET:
+		return G_TYPE_BOOLEAN;
+	case EV_THUMBNAILS_MODEL_COLUMN_JOB:
+		return G_TYPE_OBJECT;
+	}
+
+	g_assert_not_reached ();
+
+	return G_TYPE_INVALID;
+}
+
+static gboolean
+ev_thumbnails_model_set_iter (EvThumbnailsModel *model,
+			      GtkTreeIter       *iter,
+			      gint               page)
+{
+	if (page < 0 || page >= model->n_pages) {
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	iter->stamp = model->stamp;
+	iter->user_data = GINT_TO_POINTER (page);
+
+	return TRUE;
+}
+
+static gboolean
+ev_thumbnails_model_get_iter (GtkTreeModel *tree_model,
+			      GtkTreeIter  *iter,
+			      GtkTreePath  *path)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+
+	if (gtk_tree_path_get_depth (path) != 1)
+		return FALSE;
+
+	return ev_thumbnails_model_set_iter (model, iter,
+					     gtk_tree_path_get_indices (path)[0]);
+}
+
+static GtkTreePath *
+ev_thumbnails_model_get_path (GtkTreeModel *tree_model,
+			      GtkTreeIter  *iter)
+{
+	g_return_val_if_fail (iter->stamp == EV_THUMBNAILS_MODEL (tree_model)->stamp, NULL);
+
+	return gtk_tree_path_new_from_indices (ITER_PAGE (iter), -1);
+}
+
+static void
+ev_thumbnails_model_get_value (GtkTreeModel *tree_model,
+			       GtkTreeIter  *iter,
+			       gint          column,
+			       GValue       *value)
+{
+	EvThumbnailsModel    *model = EV_THUMBNAILS_MODEL (tree_model);
+	EvThumbnailsModelRow *row;
+	gint                  page;
+
+	g_return_if_fail (iter->stamp == model->stamp);
+
+	page = ITER_PAGE (iter);
+	row = g_hash_table_lookup (model->rows, GINT_TO_POINTER (page));
+
+	g_value_init (value, ev_thumbnails_model_get_column_type (tree_model, column));
+
+	switch (column) {
+	case EV_THUMBNAILS_MODEL_COLUMN_PAGE_STRING: {
+		gchar *page_label;
+
+		page_label = ev_document_get_page_label (model->document, page);
+		g_value_take_string (value, g_markup_printf_escaped ("<i>%s</i>", page_label));
+		g_free (page_label);
+	}
+		break;
+	case EV_THUMBNAILS_MODEL_COLUMN_PIXBUF:
+		if (row && row->thumbnail)
+			g_value_set_object (value, row->thumbnail);
+		else if (model->placeholder_func)
+			g_value_set_object (value, model->placeholder_func (page, model->user_data));
+		break;
+	case EV_THUMBNAILS_MODEL_COLUMN_THUMBNAIL_SET:
+		g_value_set_boolean (value, row && row->thumbnail);
+		break;
+	case EV_THUMBNAILS_MODEL_COLUMN_JOB:
+		g_value_set_object (value, row ? row->job : NULL);
+		break;
+	}
+}
+
+static gboolean
+ev_thumbnails_model_iter_next (GtkTreeModel *tree_model,
+			       GtkTreeIter  *iter)
+{
+	EvThumbnailsModel *model = EV_THUMBNAILS_MODEL (tree_model);
+
+	g_return_val_if_fail (iter->stamp == model->stamp, FALSE);
+
+	return ev_thumbnails_model_set_iter (model, iter, ITER_PAGE (iter) + 1);
+}
+
+static gboolean
+ev_thumbnails_model_iter_nth_child (GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter,
+				    GtkTreeIter  *parent,
+				    gint          n)
+{
+	if (parent)
+		return FALSE;
+
+	return ev_thumbnails_model_set_iter (EV_THUMBNAILS_MODEL (tree_model), iter, n);
+}
+
+static gboolean
+ev_thumbnails_model_iter_children (GtkTreeModel *tree_model,
+				   GtkTreeIter  *iter,
+				   GtkTreeIter  *parent)
+{
+	return ev_thumbnails_model_iter_nth_child (tree_model, iter, parent, 0);
+}
+
+static gboolean
+ev_thumbnails_model_iter_has_child (GtkTreeModel *tree_model,
+				    GtkTreeIter  *iter)
+{
+	return FALSE;
+}
+
+static gint
+ev_thumbnails_model_iter_n_children (GtkTreeModel *tree_model,
+				     GtkTreeIter  *iter)
+{
+	if (iter)
+		return 0;
+
+	return EV_THUMBNAILS_MODEL (tree_model)->n_pages;
+}
+
+static gboolean
+ev_thumbnails_model_iter_parent (GtkTreeModel *tree_model,
+				 GtkTreeIter  *iter,
+				 GtkTreeIter  *child)
+{
+	return FALSE;
+}
+
+static void
+ev_thumbnails_model_tree_model_iface_init (GtkTreeModelIface *iface)
+{
+	iface->get_flags = ev_thumbnails_model_get_flags;
+	iface->get_n_columns = ev_thumbnails_model_get_n_columns;
+	iface->get_column_type = ev_thumbnails_model_get_column_type;
+	iface->get_iter = ev_thumbnails_model_get_iter;
+	iface->get_path = ev_thumbnails_model_get_path;
+	iface->get_value = ev_thumbnails_model_get_value;
+	iface->iter_next = ev_thumbnails_model_iter_next;
+	iface->iter_children = ev_thumbnails_model_iter_children;
+	iface->iter_has_child = ev_thumbnails_model_iter_has_child;
+	iface->iter_n_children = ev_thumbnails_model_iter_n_children;
+	iface->iter_nth_child = ev_thumbnails_model_iter_nth_child;
+	iface->iter_parent = ev_thumbnails_model_iter_parent;
+}
+
+static void
+ev_thumbnails_model_page_changed (EvThumbnailsModel *model,
+				  gint               page)
+{
+	GtkTreePath *path;
+	GtkTreeIter  iter;
+
+	if (!ev_thumbnails_model_set_iter (model, &iter, page))
+		return;
+
+	path = gtk_tree_path_new_from_indices (page, -1);
+	gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+	gtk_tree_path_free (path);
+}
+
+static EvThumbnailsModelRow *
+ev_thumbnails_model_ensure_row (EvThumbnailsModel *model,
+				gint               page)
+{
+	EvThumbnailsModelRow *row;
+
+	row = g_hash_table_lookup (model->rows, GINT_TO_POINTER (page));
+	if (!row) {
+		row = g_slice_new0 (EvThumbnailsModelRow);
+		g_hash_table_insert (model->rows, GINT_TO_POINTER (page), row);
+	}
+
+	return row;
+}
+
+/**
+ * ev_thumbnails_model_new:
+ * @document: an #EvDocument
+ * @placeholder_func: function returning the pixbuf of rows without thumbnail
+ * @user_data: data passed to @placeholder_func
+ *
+ * Returns: a new #EvThumbnailsModel with a row for every page of @document
+ */
+EvThumbnailsModel *
+ev_thumbnails_model_new (EvDocument                       *document,
+			 EvThumbnailsModelPlaceholderFunc  placeholder_func,
+			 gpointer                          user_data)
+{
+	EvThumbnailsModel *model;
+
+	g_return_val_if_fail (EV_IS_DOCUMENT (document), NULL);
+
+	model = g_object_new (EV_TYPE_THUMBNAILS_MODEL, NULL);
+	model->document = g_object_ref (document);
+	model->n_pages = ev_document_get_n_pages (document);
+	model->placeholder_func = placeholder_func;
+	model->user_data = user_data;
+
+	return model;
+}
+
+gboolean
+ev_thumbnails_model_get_thumbnail_set (EvThumbnailsModel *model,
+				       gint               page)
+{
+	EvThumbnailsModelRow *row;
+
+	g_return_val_if_fail (EV_IS_THUMBNAILS_MODEL (model), FALSE);
+
+	row = g_hash_table_lookup (model->rows, GINT_TO_POINTER (page));
+
+	return row && row->thumbnail;
+}
+
+/* Sets the thumbnail of page and releases its job */
+void
+ev_thumbnails_model_set_thumbnail (EvThumbnailsModel *model,
+				   gint               page,
+				   GdkPixbuf         *thumbnail)
+{
+	EvThumbnailsModelRow *row;
+
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+	g_return_if_fail (GDK_IS_PIXBUF (thumbnail));
+
+	row = ev_thumbnails_model_ensure_row (model, page);
+	if (row->thumbnail)
+		g_object_unref (row->thumbnail);
+	row->thumbnail = g_object_ref (thumbnail);
+	if (row->job) {
+		g_object_unref (row->job);
+		row->job = NULL;
+	}
+
+	ev_thumbnails_model_page_changed (model, page);
+}
+
+/* Returns the job rendering the thumbnail of page, without a reference */
+GObject *
+ev_thumbnails_model_get_job (EvThumbnailsModel *model,
+			     gint               page)
+{
+	EvThumbnailsModelRow *row;
+
+	g_return_val_if_fail (EV_IS_THUMBNAILS_MODEL (model), NULL);
+
+	row = g_hash_table_lookup (model->rows, GINT_TO_POINTER (page));
+
+	return row ? row->job : NULL;
+}
+
+void
+ev_thumbnails_model_set_job (EvThumbnailsModel *model,
+			     gint               page,
+			     GObject           *job)
+{
+	EvThumbnailsModelRow *row;
+
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+
+	if (!job) {
+		row = g_hash_table_lookup (model->rows, GINT_TO_POINTER (page));
+		if (!row || !row->job)
+			return;
+	} else {
+		row = ev_thumbnails_model_ensure_row (model, page);
+		g_object_ref (job);
+	}
+
+	if (row->job)
+		g_object_unref (row->job);
+	row->job = job;
+
+	if (!row->job && !row->thumbnail)
+		g_hash_table_remove (model->rows, GINT_TO_POINTER (page));
+}
+
+/* Drops the row of page, it's shown with the placeholder again */
+void
+ev_thumbnails_model_clear_page (EvThumbnailsModel *model,
+				gint               page)
+{
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+
+	if (g_hash_table_remove (model->rows, GINT_TO_POINTER (page)))
+		ev_thumbnails_model_page_changed (model, page);
+}
+
+/* Drops all the rows without notifying the views. Used before
+ * disposing the model.
+ */
+void
+ev_thumbnails_model_clear (EvThumbnailsModel *model)
+{
+	g_return_if_fail (EV_IS_THUMBNAILS_MODEL (model));
+
+	g_hash_table_remove_all (model->rows);
+}
@@ -84,6 +84,7 @@
 #include "ev-sidebar-thumbnails.h"
 #include "ev-sidebar-layers.h"
 #include "ev-stock-icons.h"
+#include "ev-thumbnail-store.h"
 #include "ev-utils.h"
 #include "ev-keyring.h"
 #include "ev-view.h"
@@ -263,6 +264,12 @@ static void     ev_window_reload_document               (EvWindow         *windo
 							 EvLinkDest *dest);
 static void     ev_window_reload_job_cb                 (EvJob            *job,
 							 EvWindow         *window);
+static void     ev_window_open_document_for_uri         (EvWindow         *ev_window,
+							 EvDocument       *document,
+							 const gchar      *uri,
+							 EvLinkDest       *dest,
+							 EvWindowRunMode   mode,
+							 const gchar      *search_string);
 static void     ev_window_set_icon_from_thumbnail       (EvJobThumbnail   *job,
 							 EvWindow         *ev_window);
 static void     ev_window_save_job_cb                   (EvJob            *save,
@@ -1152,8 +1159,15 @@ ev_window_set_icon_from_thumbnail (EvJobThumbnail *job,
 				   EvWindow       *ev_window)
 {
 	if (job->thumbnail) {
-		if (ev_document_model_get_inverted_colors (ev_window->priv->model))
-			ev_document_misc_invert_pixbuf (job->thumbnail);
+		if (ev_document_model_get_inverted_colors (ev_window->priv->model)) {
+			GdkPixbuf *thumbnail;
+
+			/* The thumbnail might be shared with other jobs */
+			thumbnail = gdk_pixbuf_copy (job->thumbnail);
+			ev_document_misc_invert_pixbuf (thumbnail);
+			g_object_unref (job->thumbnail);
+			job->thumbnail = thumbnail;
+		}
 		gtk_window_set_icon (GTK_WINDOW (ev_window),
 				     job->thumbnail);
 	}
@@ -1260,15 +1274,30 @@ ev_window_setup_document (EvWindow *ev_window)
 	return FALSE;
 }
 
+/* Called before showing document, the sidebar picks the store up */
+static void
+ev_window_setup_thumbnail_store (EvWindow   *ev_window,
+				 EvDocument *document)
+{
+	/* Remote documents are loaded from a temporary local copy,
+	 * there's no point in storing thumbnails for them
+	 */
+	if (!ev_window->priv->local_uri)
+		ev_thumbnail_store_set_uri (document, ev_window->priv->uri);
+}
+
 static void
 ev_window_set_document (EvWindow *ev_window, EvDocument *document)
 {
 	if (ev_window->priv->document == document)
 		return;
 
-	if (ev_window->priv->document)
+	if (ev_window->priv->document) {
+		ev_application_release_document (EV_APP, ev_window->priv->document);
 		g_object_unref (ev_window->priv->document);
+	}
 	ev_window->priv->document = g_object_ref (document);
+	ev_application_add_document (EV_APP, ev_window->priv->uri, document);
 
 	ev_window_set_message_area (ev_window, NULL);
 
@@ -1378,6 +1407,7 @@ ev_window_load_job_cb (EvJob *job,
 
 	/* Success! */
 	if (!ev_job_is_failed (job)) {
+		ev_window_setup_thumbnail_store (ev_window, document);
 		ev_document_model_set_document (ev_window->priv->model, document);
 
 		setup_document_from_metadata (ev_window);
@@ -1477,24 +1507,14 @@ ev_window_load_job_cb (EvJob *job,
 }
 
 static void
-ev_window_reload_job_cb (EvJob    *job,
-			 EvWindow *ev_window)
+ev_window_set_reloaded_document (EvWindow   *ev_window,
+				 EvDocument *document)
 {
 	GtkWidget *widget;
 
-	if (ev_job_is_failed (job)) {
-		ev_window_clear_reload_job (ev_window);
-		ev_window->priv->in_reload = FALSE;
-		if (ev_window->priv->dest) {
-			g_object_unref (ev_window->priv->dest);
-			ev_window->priv->dest = NULL;
-		}
-
-		return;
-	}
-
+	ev_window_setup_thumbnail_store (ev_window, document);
 	ev_document_model_set_document (ev_window->priv->model,
-					job->document);
+					document);
 	if (ev_window->priv->dest) {
 		ev_window_handle_link (ev_window, ev_window->priv->dest);
 		/* Already unrefed by ev_link_action
@@ -1510,11 +1530,29 @@ ev_window_reload_job_cb (EvJob    *job,
 		find_bar_search_changed_cb (EGG_FIND_BAR (ev_window->priv->find_bar),
 					    NULL, ev_window);
 	}
-	
-	ev_window_clear_reload_job (ev_window);
+
 	ev_window->priv->in_reload = FALSE;
 }
 
+static void
+ev_window_reload_job_cb (EvJob    *job,
+			 EvWindow *ev_window)
+{
+	if (ev_job_is_failed (job)) {
+		ev_window_clear_reload_job (ev_window);
+		ev_window->priv->in_reload = FALSE;
+		if (ev_window->priv->dest) {
+			g_object_unref (ev_window->priv->dest);
+			ev_window->priv->dest = NULL;
+		}
+
+		return;
+	}
+
+	ev_window_set_reloaded_document (ev_window, job->document);
+	ev_window_clear_reload_job (ev_window);
+}
+
 /**
  * ev_window_get_uri:
  * @ev_window: The instance of the #EvWindow.
@@ -1819,7 +1857,8 @@ ev_window_open_uri (EvWindow       *ev_window,
 		    EvWindowRunMode mode,
 		    const gchar    *search_string)
 {
-	GFile *source_file;
+	GFile      *source_file;
+	EvDocument *document;
 
 	ev_window->priv->in_reload = FALSE;
 	
@@ -1854,6 +1893,19 @@ ev_window_open_uri (EvWindow       *ev_window,
 	else
 		ev_window->priv->metadata = NULL;
 
+	/* Another window might have already loaded the same file */
+	document = ev_application_get_document (EV_APP, uri);
+	if (document) {
+		g_object_unref (source_file);
+		ev_view_set_loading (EV_VIEW (ev_window->priv->view), FALSE);
+		ev_window_open_document_for_uri (ev_window, document, uri,
+						 dest, mode, search_string);
+		ev_window_add_recent (ev_window, ev_window->priv->uri);
+		g_object_unref (document);
+
+		return;
+	}
+
 	if (ev_window->priv->search_string)
 		g_free (ev_window->priv->search_string);
 	ev_window->priv->search_string = search_string ?
@@ -1880,13 +1932,19 @@ ev_window_open_uri (EvWindow       *ev_window,
 	}
 }
 
-void
-ev_window_open_document (EvWindow       *ev_window,
-			 EvDocument     *document,
-			 EvLinkDest     *dest,
-			 EvWindowRunMode mode,
-			 const gchar    *search_string)
+/* uri is the file the user opened, which is not the document uri
+ * when the document was loaded from an uncompressed temporary copy.
+ */
+static void
+ev_window_open_document_for_uri (EvWindow       *ev_window,
+				 EvDocument     *document,
+				 const gchar    *uri,
+				 EvLinkDest     *dest,
+				 EvWindowRunMode mode,
+				 const gchar    *search_string)
 {
+	gchar *new_uri;
+
 	if (document == ev_window->priv->document)
 		return;
 
@@ -1899,13 +1957,15 @@ ev_window_open_document (EvWindow       *ev_window,
 		ev_window->priv->monitor = NULL;
 	}
 
+	new_uri = g_strdup (uri);
 	if (ev_window->priv->uri)
 		g_free (ev_window->priv->uri);
-	ev_window->priv->uri = g_strdup (ev_document_get_uri (document));
+	ev_window->priv->uri = new_uri;
 
 	setup_size_from_metadata (ev_window);
 	setup_model_from_metadata (ev_window);
 
+	ev_window_setup_thumbnail_store (ev_window, document);
 	ev_document_model_set_document (ev_window->priv->model, document);
 
 	setup_document_from_metadata (ev_window);
@@ -1949,10 +2009,35 @@ ev_window_open_document (EvWindow       *ev_window,
 				  ev_window);
 }
 
+void
+ev_window_open_document (EvWindow       *ev_window,
+			 EvDocument     *document,
+			 EvLinkDest     *dest,
+			 EvWindowRunMode mode,
+			 const gchar    *search_string)
+{
+	ev_window_open_document_for_uri (ev_window, document,
+					 ev_document_get_uri (document),
+					 dest, mode, search_string);
+}
+
 static void
 ev_window_reload_local (EvWindow *ev_window)
 {
 	const gchar *uri;
+	EvDocument  *document;
+
+	/* Another window might have already reloaded the file */
+	if (!ev_window->priv->local_uri) {
+		document = ev_application_get_document (EV_APP, ev_window->priv->uri);
+		if (document && document != ev_window->priv->document) {
+			ev_window_set_reloaded_document (ev_window, document);
+			g_object_unref (document);
+			return;
+		}
+		if (document)
+			g_object_unref (document);
+	}
 	
 	uri = ev_window->priv->local_uri ? ev_window->priv->local_uri : ev_window->priv->uri;
 	ev_window->priv->reload_job = ev_job_load_new (uri);
@@ -2212,9 +2297,10 @@ ev_window_open_copy_at_dest (EvWindow   *window,
 
 	if (window->priv->metadata)
 		new_window->priv->metadata = g_object_ref (window->priv->metadata);
-	ev_window_open_document (new_window,
-				 window->priv->document,
-				 dest, 0, NULL);
+	ev_window_open_document_for_uri (new_window,
+					 window->priv->document,
+					 window->priv->uri,
+					 dest, 0, NULL);
 	gtk_window_present (GTK_WINDOW (new_window));
 }
 
@@ -4815,6 +4901,7 @@ ev_window_dispose (GObject *object)
 	}
 
 	if (priv->document) {
+		ev_application_release_document (EV_APP, priv->document);
 		g_object_unref (priv->document);
 		priv->document = NULL;
 	}
@@ -0,0 +1,936 @@
+/* ev-bench.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the hot paths of the backends: document load, time to the
+ * first rendered page, page rendering at several scales, find,
+ * selection rendering and thumbnails. Results are printed as JSON so
+ * that they can be compared between runs.
+ *
+ * Every document given in the command line is measured, plus
+ * synthetic PDF, TIFF and CBZ documents generated on the fly with
+ * --synthetic-pages pages, for the backends that are built.
+ */
+
+#include <config.h>
+
+#include <evince-document.h>
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static gint          max_pages = 20;
+static gint          synthetic_pages = 200;
+static const gchar  *query = "the";
+static const gchar  *output_file = NULL;
+static const gchar **file_arguments;
+
+static const GOptionEntry goption_options[] = {
+	{ "max-pages", 'n', 0, G_OPTION_ARG_INT, &max_pages, "Maximum number of pages measured per document (default: 20)", "N" },
+	{ "synthetic-pages", 's', 0, G_OPTION_ARG_INT, &synthetic_pages, "Pages of the synthetic documents, 0 to disable them (default: 200)", "N" },
+	{ "query", 'q', 0, G_OPTION_ARG_STRING, &query, "Text searched in the find benchmark (default: the)", "TEXT" },
+	{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &output_file, "Write the results to FILE instead of stdout", "FILE" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "[<document>...]" },
+	{ NULL }
+};
+
+static const gdouble render_scales[] = { 0.5, 1.0, 2.0 };
+
+#define THUMBNAIL_WIDTH 100
+
+/* Timing */
+typedef struct {
+	gint    count;
+	gdouble total;
+	gdouble max;
+} BenchStats;
+
+static void
+bench_stats_add (BenchStats *stats,
+		 gdouble     seconds)
+{
+	stats->count++;
+	stats->total += seconds;
+	stats->max = MAX (stats->max, seconds);
+}
+
+static gdouble
+bench_stats_mean_ms (BenchStats *stats)
+{
+	return stats->count > 0 ? stats->total * 1000 / stats->count : 0;
+}
+
+/* JSON output */
+static void
+json_string (GString     *json,
+	     const gchar *str)
+{
+	const gchar *p;
+
+	g_string_append_c (json, '"');
+	for (p = str; p && *p; p++) {
+		switch (*p) {
+		case '"':
+			g_string_append (json, "\\\"");
+			break;
+		case '\\':
+			g_string_append (json, "\\\\");
+			break;
+		case '\n':
+			g_string_append (json, "\\n");
+			break;
+		case '\t':
+			g_string_append (json, "\\t");
+			break;
+		default:
+			if ((guchar)*p < 0x20)
+				g_string_append_printf (json, "\\u%04x", (guchar)*p);
+			else
+				g_string_append_c (json, *p);
+		}
+	}
+	g_string_append_c (json, '"');
+}
+
+static void
+json_stats (GString    *json,
+	    BenchStats *stats)
+{
+	g_string_append_printf (json,
+				"\"count\": %d, \"mean_ms\": %.3f, \"max_ms\": %.3f, \"total_ms\": %.3f",
+				stats->count,
+				bench_stats_mean_ms (stats),
+				stats->max * 1000,
+				stats->total * 1000);
+}
+
+/* Synthetic documents */
+#define SYNTHETIC_PAGE_WIDTH  612
+#define SYNTHETIC_PAGE_HEIGHT 792
+#define SYNTHETIC_LINES       48
+
+typedef GString *(* SyntheticBuildFunc) (gint     n_pages,
+					 GError **error);
+
+typedef struct {
+	const gchar       *suffix;
+	const gchar       *mime_type;
+	SyntheticBuildFunc build;
+} SyntheticFormat;
+
+static void
+string_append_le16 (GString *str,
+		    guint16  value)
+{
+	value = GUINT16_TO_LE (value);
+	g_string_append_len (str, (const gchar *)&value, 2);
+}
+
+static void
+string_append_le32 (GString *str,
+		    guint32  value)
+{
+	value = GUINT32_TO_LE (value);
+	g_string_append_len (str, (const gchar *)&value, 4);
+}
+
+static void
+string_set_le32 (GString *str,
+		 gsize    pos,
+		 guint32  value)
+{
+	value = GUINT32_TO_LE (value);
+	memcpy (str->str + pos, &value, 4);
+}
+
+/* Image pages: lines of black boxes standing for words, laid out like
+ * the text of the synthetic PDF pages. ink gets a byte per pixel, non
+ * zero where the page is black.
+ */
+static void
+synthetic_page_draw (gint    page,
+		     guchar *ink)
+{
+	GRand *rand;
+	gint   line;
+
+	memset (ink, 0, SYNTHETIC_PAGE_WIDTH * SYNTHETIC_PAGE_HEIGHT);
+
+	rand = g_rand_new_with_seed (page);
+	for (line = 0; line < SYNTHETIC_LINES; line++) {
+		gint top = 20 + line * 14;
+		gint x = 56;
+
+		while (TRUE) {
+			gint word = g_rand_int_range (rand, 8, 48);
+			gint y;
+
+			if (x + word > SYNTHETIC_PAGE_WIDTH - 56)
+				break;
+
+			for (y = top; y < top + 8; y++)
+				memset (ink + y * SYNTHETIC_PAGE_WIDTH + x, 1, word);
+			x += word + 4;
+		}
+	}
+	g_rand_free (rand);
+}
+
+/* A PDF with pages of plain text */
+static GString *
+synthetic_pdf_build (gint     n_pages,
+		     GError **error)
+{
+	GString *pdf;
+	GArray  *offsets;
+	gint     n_objects;
+	gint     i;
+	gsize    xref;
+
+	/* Objects: 1 catalog, 2 pages, 3 font, then a page and its
+	 * contents for every page */
+	n_objects = 3 + n_pages * 2;
+	offsets = g_array_sized_new (FALSE, TRUE, sizeof (gsize), n_objects + 1);
+	g_array_set_size (offsets, n_objects + 1);
+
+	pdf = g_string_new ("%PDF-1.4\n");
+
+	g_array_index (offsets, gsize, 1) = pdf->len;
+	g_string_append (pdf, "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+
+	g_array_index (offsets, gsize, 2) = pdf->len;
+	g_string_append (pdf, "2 0 obj\n<< /Type /Pages /Kids [");
+	for (i = 0; i < n_pages; i++)
+		g_string_append_printf (pdf, " %d 0 R", 4 + i * 2);
+	g_string_append_printf (pdf, " ] /Count %d >>\nendobj\n", n_pages);
+
+	g_array_index (offsets, gsize, 3) = pdf->len;
+	g_string_append (pdf, "3 0 obj\n<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>\nendobj\n");
+
+	for (i = 0; i < n_pages; i++) {
+		GString *contents;
+		gint     line;
+
+		contents = g_string_new ("BT /F1 11 Tf 14 TL 56 780 Td\n");
+		for (line = 0; line < SYNTHETIC_LINES; line++) {
+			g_string_append_printf (contents,
+						"(Page %d line %d: the quick brown fox jumps over the lazy dog) '\n",
+						i + 1, line + 1);
+		}
+		g_string_append (contents, "ET\n");
+
+		g_array_index (offsets, gsize, 4 + i * 2) = pdf->len;
+		g_string_append_printf (pdf,
+					"%d 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] "
+					"/Resources << /Font << /F1 3 0 R >> >> /Contents %d 0 R >>\nendobj\n",
+					4 + i * 2, 5 + i * 2);
+
+		g_array_index (offsets, gsize, 5 + i * 2) = pdf->len;
+		g_string_append_printf (pdf, "%d 0 obj\n<< /Length %" G_GSIZE_FORMAT " >>\nstream\n%sendstream\nendobj\n",
+					5 + i * 2, contents->len, contents->str);
+		g_string_free (contents, TRUE);
+	}
+
+	xref = pdf->len;
+	g_string_append_printf (pdf, "xref\n0 %d\n0000000000 65535 f \n", n_objects + 1);
+	for (i = 1; i <= n_objects; i++)
+		g_string_append_printf (pdf, "%010" G_GSIZE_FORMAT " 00000 n \n",
+					g_array_index (offsets, gsize, i));
+	g_string_append_printf (pdf, "trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%" G_GSIZE_FORMAT "\n%%%%EOF\n",
+				n_objects + 1, xref);
+
+	g_array_free (offsets, TRUE);
+
+	return pdf;
+}
+
+#define TIFF_SHORT    3
+#define TIFF_LONG     4
+#define TIFF_RATIONAL 5
+
+/* A directory entry with a single value. Values that fit in 4 bytes
+ * are stored in the entry itself, the others are offsets.
+ */
+static void
+tiff_append_entry (GString *tiff,
+		   guint16  tag,
+		   guint16  type,
+		   guint32  value)
+{
+	string_append_le16 (tiff, tag);
+	string_append_le16 (tiff, type);
+	string_append_le32 (tiff, 1);
+	string_append_le32 (tiff, value);
+}
+
+/* A multipage uncompressed bilevel TIFF, rendered by the backend as
+ * monochrome pages */
+static GString *
+synthetic_tiff_build (gint     n_pages,
+		      GError **error)
+{
+	GString *tiff;
+	guchar  *ink;
+	gsize    next_ifd;
+	gint     row_bytes;
+	gint     i;
+
+	row_bytes = (SYNTHETIC_PAGE_WIDTH + 7) / 8;
+	ink = g_malloc (SYNTHETIC_PAGE_WIDTH * SYNTHETIC_PAGE_HEIGHT);
+
+	tiff = g_string_new (NULL);
+	g_string_append_len (tiff, "II*\0", 4);
+	next_ifd = tiff->len;
+	string_append_le32 (tiff, 0);
+
+	for (i = 0; i < n_pages; i++) {
+		gsize strip, resolution;
+		gint  x, y;
+
+		synthetic_page_draw (i, ink);
+
+		strip = tiff->len;
+		for (y = 0; y < SYNTHETIC_PAGE_HEIGHT; y++) {
+			const guchar *src = ink + y * SYNTHETIC_PAGE_WIDTH;
+
+			for (x = 0; x < row_bytes * 8; x += 8) {
+				guchar byte = 0;
+				gint   bit;
+
+				for (bit = 0; bit < 8 && x + bit < SYNTHETIC_PAGE_WIDTH; bit++) {
+					if (src[x + bit])
+						byte |= 0x80 >> bit;
+				}
+				g_string_append_c (tiff, byte);
+			}
+		}
+
+		/* 72 dpi, so pages have the size of the PDF ones */
+		resolution = tiff->len;
+		string_append_le32 (tiff, 72);
+		string_append_le32 (tiff, 1);
+
+		/* The directory, with the entries sorted by tag */
+		string_set_le32 (tiff, next_ifd, tiff->len);
+		string_append_le16 (tiff, 12);
+		tiff_append_entry (tiff, 256, TIFF_LONG, SYNTHETIC_PAGE_WIDTH);	/* ImageWidth */
+		tiff_append_entry (tiff, 257, TIFF_LONG, SYNTHETIC_PAGE_HEIGHT);	/* ImageLength */
+		tiff_append_entry (tiff, 258, TIFF_SHORT, 1);			/* BitsPerSample */
+		tiff_append_entry (tiff, 259, TIFF_SHORT, 1);			/* Compression: none */
+		tiff_append_entry (tiff, 262, TIFF_SHORT, 0);			/* Photometric: WhiteIsZero */
+		tiff_append_entry (tiff, 273, TIFF_LONG, strip);			/* StripOffsets */
+		tiff_append_entry (tiff, 277, TIFF_SHORT, 1);			/* SamplesPerPixel */
+		tiff_append_entry (tiff, 278, TIFF_LONG, SYNTHETIC_PAGE_HEIGHT);	/* RowsPerStrip */
+		tiff_append_entry (tiff, 279, TIFF_LONG, row_bytes * SYNTHETIC_PAGE_HEIGHT); /* StripByteCounts */
+		tiff_append_entry (tiff, 282, TIFF_RATIONAL, resolution);	/* XResolution */
+		tiff_append_entry (tiff, 283, TIFF_RATIONAL, resolution);	/* YResolution */
+		tiff_append_entry (tiff, 296, TIFF_SHORT, 2);			/* ResolutionUnit: inch */
+		next_ifd = tiff->len;
+		string_append_le32 (tiff, 0);
+	}
+
+	g_free (ink);
+
+	return tiff;
+}
+
+static guint32
+bench_crc32 (const guchar *data,
+	     gsize         len)
+{
+	guint32 crc = 0xffffffff;
+	gsize   i;
+	gint    bit;
+
+	for (i = 0; i < len; i++) {
+		crc ^= data[i];
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+
+	return ~crc;
+}
+
+static void
+zip_append_header (GString     *zip,
+		   guint32      signature,
+		   const gchar *name,
+		   guint32      crc,
+		   guint32      size,
+		   gsize        offset)
+{
+	gboolean central = signature == 0x02014b50;
+
+	string_append_le32 (zip, signature);
+	if (central)
+		string_append_le16 (zip, 20);	/* Version made by */
+	string_append_le16 (zip, 10);		/* Version needed */
+	string_append_le16 (zip, 0);		/* Flags */
+	string_append_le16 (zip, 0);		/* Method: stored */
+	string_append_le16 (zip, 0);		/* Time */
+	string_append_le16 (zip, 0x21);		/* Date: 1980-01-01 */
+	string_append_le32 (zip, crc);
+	string_append_le32 (zip, size);		/* Compressed size */
+	string_append_le32 (zip, size);
+	string_append_le16 (zip, strlen (name));
+	string_append_le16 (zip, 0);		/* Extra field length */
+	if (central) {
+		string_append_le16 (zip, 0);	/* Comment length */
+		string_append_le16 (zip, 0);	/* Disk */
+		string_append_le16 (zip, 0);	/* Internal attributes */
+		string_append_le32 (zip, 0);	/* External attributes */
+		string_append_le32 (zip, offset);
+	}
+	g_string_append (zip, name);
+}
+
+/* A comic book: a zip archive of PNG pages. The PNG files are already
+ * compressed, so they are stored as they are.
+ */
+static GString *
+synthetic_cbz_build (gint     n_pages,
+		     GError **error)
+{
+	GString   *zip;
+	GString   *central;
+	GdkPixbuf *pixbuf;
+	guchar    *ink;
+	gint       i;
+
+	ink = g_malloc (SYNTHETIC_PAGE_WIDTH * SYNTHETIC_PAGE_HEIGHT);
+	pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8,
+				 SYNTHETIC_PAGE_WIDTH, SYNTHETIC_PAGE_HEIGHT);
+
+	zip = g_string_new (NULL);
+	central = g_string_new (NULL);
+
+	for (i = 0; i < n_pages; i++) {
+		guchar *pixels = gdk_pixbuf_get_pixels (pixbuf);
+		gint    stride = gdk_pixbuf_get_rowstride (pixbuf);
+		gchar  *buffer;
+		gsize   size;
+		gchar  *name;
+		guint32 crc;
+		gsize   offset;
+		gint    x, y;
+
+		synthetic_page_draw (i, ink);
+		for (y = 0; y < SYNTHETIC_PAGE_HEIGHT; y++) {
+			guchar *p = pixels + y * stride;
+
+			for (x = 0; x < SYNTHETIC_PAGE_WIDTH; x++, p += 3)
+				p[0] = p[1] = p[2] = ink[y * SYNTHETIC_PAGE_WIDTH + x] ? 0x00 : 0xff;
+		}
+
+		if (!gdk_pixbuf_save_to_buffer (pixbuf, &buffer, &size, "png", error, NULL)) {
+			g_string_free (zip, TRUE);
+			zip = NULL;
+			break;
+		}
+
+		name = g_strdup_printf ("page-%04d.png", i + 1);
+		crc = bench_crc32 ((const guchar *)buffer, size);
+		offset = zip->len;
+
+		zip_append_header (zip, 0x04034b50, name, crc, size, 0);
+		g_string_append_len (zip, buffer, size);
+		zip_append_header (central, 0x02014b50, name, crc, size, offset);
+
+		g_free (name);
+		g_free (buffer);
+	}
+
+	if (zip) {
+		gsize central_offset = zip->len;
+
+		g_string_append_len (zip, central->str, central->len);
+		string_append_le32 (zip, 0x06054b50);
+		string_append_le16 (zip, 0);	/* Disk */
+		string_append_le16 (zip, 0);	/* Disk of the central directory */
+		string_append_le16 (zip, n_pages);
+		string_append_le16 (zip, n_pages);
+		string_append_le32 (zip, central->len);
+		string_append_le32 (zip, central_offset);
+		string_append_le16 (zip, 0);	/* Comment length */
+	}
+
+	g_string_free (central, TRUE);
+	g_object_unref (pixbuf);
+	g_free (ink);
+
+	return zip;
+}
+
+static const SyntheticFormat synthetic_formats[] = {
+	{ "pdf", "application/pdf", synthetic_pdf_build },
+	{ "tiff", "image/tiff", synthetic_tiff_build },
+	{ "cbz", "application/x-cbz", synthetic_cbz_build }
+};
+
+static gboolean
+backend_supports_mime_type (const gchar *mime_type)
+{
+	GList   *types, *l;
+	gboolean retval = FALSE;
+
+	types = ev_backends_manager_get_all_types_info ();
+	for (l = types; l && !retval; l = g_list_next (l)) {
+		EvTypeInfo *info = (EvTypeInfo *)l->data;
+		gint        i;
+
+		for (i = 0; info->mime_types[i]; i++) {
+			if (g_ascii_strcasecmp (info->mime_types[i], mime_type) == 0) {
+				retval = TRUE;
+				break;
+			}
+		}
+	}
+	g_list_foreach (types, (GFunc)g_free, NULL);
+	g_list_free (types);
+
+	return retval;
+}
+
+/* Documents of backends that are not built are skipped, so that the
+ * bundled fixtures can be measured with any configuration.
+ */
+static gboolean
+document_is_supported (const gchar *filename)
+{
+	GFile   *file;
+	gchar   *uri;
+	gchar   *mime_type;
+	gboolean retval;
+
+	file = g_file_new_for_commandline_arg (filename);
+	uri = g_file_get_uri (file);
+	g_object_unref (file);
+
+	/* Unknown types are left to the loader to report */
+	mime_type = ev_file_get_mime_type (uri, FALSE, NULL);
+	g_free (uri);
+	if (!mime_type)
+		return TRUE;
+
+	retval = backend_supports_mime_type (mime_type);
+	g_free (mime_type);
+
+	return retval;
+}
+
+static gchar *
+create_synthetic_document (const SyntheticFormat *format,
+			   gint                   n_pages,
+			   GError               **error)
+{
+	GString *contents;
+	gchar   *template;
+	gchar   *filename;
+	gint     fd;
+	gboolean retval;
+
+	template = g_strdup_printf ("ev-bench-XXXXXX.%s", format->suffix);
+	fd = g_file_open_tmp (template, &filename, error);
+	g_free (template);
+	if (fd == -1)
+		return NULL;
+	close (fd);
+
+	contents = format->build (n_pages, error);
+	if (contents) {
+		retval = g_file_set_contents (filename, contents->str, contents->len, error);
+		g_string_free (contents, TRUE);
+	} else {
+		retval = FALSE;
+	}
+
+	if (!retval) {
+		g_unlink (filename);
+		g_free (filename);
+
+		return NULL;
+	}
+
+	return filename;
+}
+
+/* Benchmarks */
+static cairo_surface_t *
+render_page (EvDocument *document,
+	     gint        index,
+	     gdouble     scale)
+{
+	EvRenderContext *rc;
+	EvPage          *page;
+	cairo_surface_t *surface;
+
+	/* Monochrome pages are returned as A8 or A1 masks, the surfaces
+	 * are only timed here, never read.
+	 */
+	page = ev_document_get_page (document, index);
+	rc = ev_render_context_new (page, 0, scale);
+	surface = ev_document_render (document, rc);
+	g_object_unref (rc);
+	g_object_unref (page);
+
+	return surface;
+}
+
+static void
+bench_render (EvDocument *document,
+	      gint        n_pages,
+	      GString    *json)
+{
+	guint i;
+
+	g_string_append (json, "\"render\": [");
+	for (i = 0; i < G_N_ELEMENTS (render_scales); i++) {
+		BenchStats stats = { 0, };
+		GTimer    *timer;
+		gint       page;
+
+		timer = g_timer_new ();
+		for (page = 0; page < n_pages; page++) {
+			cairo_surface_t *surface;
+
+			g_timer_start (timer);
+			surface = render_page (document, page, render_scales[i]);
+			bench_stats_add (&stats, g_timer_elapsed (timer, NULL));
+			if (surface)
+				cairo_surface_destroy (surface);
+		}
+		g_timer_destroy (timer);
+
+		g_string_append_printf (json, "%s{ \"scale\": %.2f, ",
+					i > 0 ? ", " : "", render_scales[i]);
+		json_stats (json, &stats);
+		g_string_append (json, " }");
+	}
+	g_string_append (json, "]");
+}
+
+static void
+bench_find (EvDocument *document,
+	    gint        n_pages,
+	    GString    *json)
+{
+	BenchStats stats = { 0, };
+	GTimer    *timer;
+	gint       n_matches = 0;
+	gint       i;
+
+	g_string_append (json, "\"find\": ");
+	if (!EV_IS_DOCUMENT_FIND (document)) {
+		g_string_append (json, "null");
+		return;
+	}
+
+	timer = g_timer_new ();
+	for (i = 0; i < n_pages; i++) {
+		EvPage *page;
+		GList  *matches;
+
+		page = ev_document_get_page (document, i);
+		g_timer_start (timer);
+		matches = ev_document_find_find_text (EV_DOCUMENT_FIND (document),
+						      page, query, FALSE);
+		bench_stats_add (&stats, g_timer_elapsed (timer, NULL));
+		g_object_unref (page);
+
+		n_matches += g_list_length (matches);
+		g_list_foreach (matches, (GFunc)ev_rectangle_free, NULL);
+		g_list_free (matches);
+	}
+	g_timer_destroy (timer);
+
+	g_string_append (json, "{ \"query\": ");
+	json_string (json, query);
+	g_string_append_printf (json, ", \"matches\": %d, \"pages_per_s\": %.1f, ",
+				n_matches,
+				stats.total > 0 ? stats.count / stats.total : 0);
+	json_stats (json, &stats);
+	g_string_append (json, " }");
+}
+
+static void
+bench_selection (EvDocument *document,
+		 gint        n_pages,
+		 GString    *json)
+{
+	BenchStats stats = { 0, };
+	GTimer    *timer;
+	GdkColor   text = { 0, 0xffff, 0xffff, 0xffff };
+	GdkColor   base = { 0, 0x3333, 0x6666, 0x9999 };
+	gint       i;
+
+	g_string_append (json, "\"selection\": ");
+	if (!EV_IS_SELECTION (document)) {
+		g_string_append (json, "null");
+		return;
+	}
+
+	timer = g_timer_new ();
+	for (i = 0; i < n_pages; i++) {
+		EvRenderContext *rc;
+		EvPage          *page;
+		cairo_surface_t *surface = NULL;
+		EvRectangle      points;
+		gdouble          width, height;
+
+		/* Select the top half of the page */
+		ev_document_get_page_size (document, i, &width, &height);
+		points.x1 = 0;
+		points.y1 = 0;
+		points.x2 = width;
+		points.y2 = height / 2;
+
+		page = ev_document_get_page (document, i);
+		rc = ev_render_context_new (page, 0, 1.0);
+		g_timer_start (timer);
+		ev_selection_render_selection (EV_SELECTION (document), rc,
+					       &surface, &points, NULL,
+					       EV_SELECTION_STYLE_GLYPH,
+					       &text, &base);
+		bench_stats_add (&stats, g_timer_elapsed (timer, NULL));
+		g_object_unref (rc);
+		g_object_unref (page);
+
+		if (surface)
+			cairo_surface_destroy (surface);
+	}
+	g_timer_destroy (timer);
+
+	g_string_append (json, "{ ");
+	json_stats (json, &stats);
+	g_string_append (json, " }");
+}
+
+static void
+bench_thumbnails (EvDocument *document,
+		  gint        n_pages,
+		  GString    *json)
+{
+	BenchStats stats = { 0, };
+	GTimer    *timer;
+	gint       i;
+
+	g_string_append (json, "\"thumbnails\": ");
+	if (!EV_IS_DOCUMENT_THUMBNAILS (document)) {
+		g_string_append (json, "null");
+		return;
+	}
+
+	timer = g_timer_new ();
+	for (i = 0; i < n_pages; i++) {
+		EvRenderContext *rc;
+		EvPage          *page;
+		GdkPixbuf       *thumbnail;
+		gdouble          width;
+
+		ev_document_get_page_size (document, i, &width, NULL);
+		page = ev_document_get_page (document, i);
+		rc = ev_render_context_new (page, 0, THUMBNAIL_WIDTH / width);
+		g_timer_start (timer);
+		thumbnail = ev_document_thumbnails_get_thumbnail (EV_DOCUMENT_THUMBNAILS (document),
+								  rc, TRUE);
+		bench_stats_add (&stats, g_timer_elapsed (timer, NULL));
+		g_object_unref (rc);
+		g_object_unref (page);
+
+		if (thumbnail)
+			g_object_unref (thumbnail);
+	}
+	g_timer_destroy (timer);
+
+	g_string_append_printf (json, "{ \"per_s\": %.1f, ",
+				stats.total > 0 ? stats.count / stats.total : 0);
+	json_stats (json, &stats);
+	g_string_append (json, " }");
+}
+
+static gboolean
+bench_document (const gchar *filename,
+		GString     *json)
+{
+	EvDocument      *document;
+	cairo_surface_t *surface;
+	GFile           *file;
+	GTimer          *timer;
+	GError          *error = NULL;
+	gchar           *uri;
+	gdouble          load_time;
+	gdouble          first_page_time;
+	gint             n_pages;
+
+	file = g_file_new_for_commandline_arg (filename);
+	uri = g_file_get_uri (file);
+	g_object_unref (file);
+
+	timer = g_timer_new ();
+	document = ev_document_factory_get_document (uri, &error);
+	load_time = g_timer_elapsed (timer, NULL);
+	g_free (uri);
+
+	if (error) {
+		g_printerr ("Error loading %s: %s\n", filename, error->message);
+		g_error_free (error);
+		if (document)
+			g_object_unref (document);
+		g_timer_destroy (timer);
+
+		return FALSE;
+	}
+
+	/* Time to first page includes loading the document */
+	surface = render_page (document, 0, 1.0);
+	first_page_time = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+	if (surface)
+		cairo_surface_destroy (surface);
+
+	n_pages = MIN (ev_document_get_n_pages (document), MAX (max_pages, 1));
+
+	g_string_append (json, "{ \"document\": ");
+	json_string (json, filename);
+	g_string_append (json, ", \"backend\": ");
+	json_string (json, ev_backends_manager_get_document_module_name (document));
+	g_string_append_printf (json,
+				", \"n_pages\": %d, \"measured_pages\": %d, "
+				"\"load_ms\": %.3f, \"first_page_ms\": %.3f,\n    ",
+				ev_document_get_n_pages (document), n_pages,
+				load_time * 1000, first_page_time * 1000);
+	bench_render (document, n_pages, json);
+	g_string_append (json, ",\n    ");
+	bench_find (document, n_pages, json);
+	g_string_append (json, ",\n    ");
+	bench_selection (document, n_pages, json);
+	g_string_append (json, ",\n    ");
+	bench_thumbnails (document, n_pages, json);
+	g_string_append (json, " }");
+
+	g_object_unref (document);
+
+	return TRUE;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	GString        *json;
+	GPtrArray      *documents;
+	GError         *error = NULL;
+	gchar          *synthetic[G_N_ELEMENTS (synthetic_formats)] = { NULL, };
+	gboolean        first = TRUE;
+	gint            retval = 0;
+	guint           j;
+	gint            i;
+
+	context = g_option_context_new ("- Benchmark document backends");
+	g_option_context_add_main_entries (context, goption_options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+
+		return 1;
+	}
+	g_option_context_free (context);
+
+	g_type_init ();
+
+	if (!g_thread_supported ())
+		g_thread_init (NULL);
+
+	if (!ev_init ())
+		return 1;
+
+	for (j = 0; synthetic_pages > 0 && j < G_N_ELEMENTS (synthetic_formats); j++) {
+		const SyntheticFormat *format = &synthetic_formats[j];
+
+		if (!backend_supports_mime_type (format->mime_type))
+			continue;
+
+		synthetic[j] = create_synthetic_document (format, synthetic_pages, &error);
+		if (!synthetic[j]) {
+			g_printerr ("Error creating synthetic %s document: %s\n",
+				    format->suffix, error->message);
+			g_clear_error (&error);
+		}
+	}
+
+	json = g_string_new ("{ \"version\": ");
+	json_string (json, VERSION);
+	g_string_append (json, ",\n  \"documents\": [\n  ");
+
+	/* The synthetic documents first, then the given ones */
+	documents = g_ptr_array_new ();
+	for (j = 0; j < G_N_ELEMENTS (synthetic); j++) {
+		if (synthetic[j])
+			g_ptr_array_add (documents, synthetic[j]);
+	}
+	for (i = 0; file_arguments && file_arguments[i]; i++) {
+		if (document_is_supported (file_arguments[i]))
+			g_ptr_array_add (documents, (gpointer)file_arguments[i]);
+		else
+			g_printerr ("Skipping %s: no backend for it\n", file_arguments[i]);
+	}
+
+	for (j = 0; j < documents->len; j++) {
+		GString *doc_json;
+
+		doc_json = g_string_new (NULL);
+		if (bench_document (g_ptr_array_index (documents, j), doc_json)) {
+			if (!first)
+				g_string_append (json, ",\n  ");
+			g_string_append_len (json, doc_json->str, doc_json->len);
+			first = FALSE;
+		} else {
+			retval = 1;
+		}
+		g_string_free (doc_json, TRUE);
+	}
+	g_ptr_array_free (documents, TRUE);
+
+	g_string_append (json, "\n  ]\n}\n");
+
+	if (output_file) {
+		if (!g_file_set_contents (output_file, json->str, json->len, &error)) {
+			g_printerr ("Error writing %s: %s\n", output_file, error->message);
+			g_error_free (error);
+			retval = 1;
+		}
+	} else {
+		fputs (json->str, stdout);
+	}
+	g_string_free (json, TRUE);
+
+	for (j = 0; j < G_N_ELEMENTS (synthetic); j++) {
+		if (synthetic[j]) {
+			g_unlink (synthetic[j]);
+			g_free (synthetic[j]);
+		}
+	}
+
+	ev_shutdown ();
+
+	return retval;
+}
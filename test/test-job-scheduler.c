@@ -0,0 +1,336 @@
+/* test-job-scheduler.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Checks that thread jobs run in priority and order, also after they
+ * are moved or pushed again, and that a page render pushed while a
+ * thumbnails range job is running doesn't wait for the whole range
+ * to be rendered.
+ */
+
+#include <config.h>
+
+#include "ev-document.h"
+#include "ev-document-thumbnails.h"
+#include "ev-document-misc.h"
+#include "ev-jobs.h"
+#include "ev-job-scheduler.h"
+
+#define N_PAGES 40
+
+/* A document whose thumbnails are only rendered when the test allows it */
+typedef struct {
+	EvDocument parent;
+} TestDocument;
+
+typedef struct {
+	EvDocumentClass parent_class;
+} TestDocumentClass;
+
+static void test_document_thumbnails_iface_init (EvDocumentThumbnailsIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (TestDocument, test_document, EV_TYPE_DOCUMENT,
+			 G_IMPLEMENT_INTERFACE (EV_TYPE_DOCUMENT_THUMBNAILS,
+						test_document_thumbnails_iface_init))
+
+static GMutex  *thumbnails_mutex;
+static GCond   *thumbnails_cond;
+static gint     n_thumbnails = 0;
+static gint     thumbnails_allowed = 1;
+/* Thumbnails rendered when the page was rendered */
+static gint     thumbnails_at_render = -1;
+
+static gboolean
+test_document_load (EvDocument *document,
+		    const char *uri,
+		    GError    **error)
+{
+	return TRUE;
+}
+
+static gint
+test_document_get_n_pages (EvDocument *document)
+{
+	return N_PAGES;
+}
+
+static void
+test_document_get_page_size (EvDocument *document,
+			     EvPage     *page,
+			     double     *width,
+			     double     *height)
+{
+	*width = 100;
+	*height = 100;
+}
+
+static cairo_surface_t *
+test_document_render (EvDocument      *document,
+		      EvRenderContext *rc)
+{
+	g_mutex_lock (thumbnails_mutex);
+	thumbnails_at_render = n_thumbnails;
+	g_mutex_unlock (thumbnails_mutex);
+
+	return ev_document_misc_surface_new (CAIRO_FORMAT_RGB24, 10, 10);
+}
+
+static void
+test_document_init (TestDocument *document)
+{
+}
+
+static void
+test_document_class_init (TestDocumentClass *klass)
+{
+	EvDocumentClass *ev_document_class = EV_DOCUMENT_CLASS (klass);
+
+	ev_document_class->load = test_document_load;
+	ev_document_class->get_n_pages = test_document_get_n_pages;
+	ev_document_class->get_page_size = test_document_get_page_size;
+	ev_document_class->render = test_document_render;
+}
+
+static GdkPixbuf *
+test_document_get_thumbnail (EvDocumentThumbnails *document,
+			     EvRenderContext      *rc,
+			     gboolean              border)
+{
+	g_mutex_lock (thumbnails_mutex);
+	while (n_thumbnails >= thumbnails_allowed)
+		g_cond_wait (thumbnails_cond, thumbnails_mutex);
+	n_thumbnails++;
+	g_cond_broadcast (thumbnails_cond);
+	g_mutex_unlock (thumbnails_mutex);
+
+	return gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, 10, 10);
+}
+
+static void
+test_document_get_dimensions (EvDocumentThumbnails *document,
+			      EvRenderContext      *rc,
+			      gint                 *width,
+			      gint                 *height)
+{
+	*width = 10;
+	*height = 10;
+}
+
+static void
+test_document_thumbnails_iface_init (EvDocumentThumbnailsIface *iface)
+{
+	iface->get_thumbnail = test_document_get_thumbnail;
+	iface->get_dimensions = test_document_get_dimensions;
+}
+
+static void
+render_finished_cb (EvJob     *job,
+		    GMainLoop *loop)
+{
+	g_main_loop_quit (loop);
+}
+
+static void
+test_render_during_thumbnails (void)
+{
+	GMainLoop  *loop;
+	EvDocument *document;
+	EvJob      *thumbnails;
+	EvJob      *render;
+	gint        thumbnails_at_push;
+
+	thumbnails_mutex = g_mutex_new ();
+	thumbnails_cond = g_cond_new ();
+
+	loop = g_main_loop_new (NULL, FALSE);
+	document = g_object_new (test_document_get_type (), NULL);
+	g_assert (ev_document_load (document, "file:///test", NULL));
+
+	thumbnails = ev_job_thumbnails_new (document, 0, N_PAGES - 1, 0, 10);
+	ev_job_scheduler_push_job (thumbnails, EV_JOB_PRIORITY_HIGH);
+
+	/* Only the first thumbnail is rendered, the job thread then
+	 * waits in the next one until the render has been pushed.
+	 */
+	g_mutex_lock (thumbnails_mutex);
+	while (n_thumbnails == 0)
+		g_cond_wait (thumbnails_cond, thumbnails_mutex);
+	thumbnails_at_push = n_thumbnails;
+	g_mutex_unlock (thumbnails_mutex);
+
+	render = ev_job_render_new (document, 0, 0, 1.0, 100, 100);
+	g_signal_connect (render, "finished",
+			  G_CALLBACK (render_finished_cb),
+			  loop);
+	ev_job_scheduler_push_job (render, EV_JOB_PRIORITY_URGENT);
+
+	g_mutex_lock (thumbnails_mutex);
+	thumbnails_allowed = N_PAGES;
+	g_cond_broadcast (thumbnails_cond);
+	g_mutex_unlock (thumbnails_mutex);
+
+	g_main_loop_run (loop);
+
+	/* The render runs as soon as the thumbnail being rendered
+	 * when it was pushed is done, not after the whole range.
+	 */
+	g_assert_cmpint (thumbnails_at_render, >=, thumbnails_at_push);
+	g_assert_cmpint (thumbnails_at_render, <=, thumbnails_at_push + 1);
+
+	ev_job_cancel (thumbnails);
+	g_object_unref (thumbnails);
+	g_object_unref (render);
+	g_object_unref (document);
+	g_main_loop_unref (loop);
+}
+
+/* A job that records the order jobs are run in. The gate job blocks
+ * the job thread until it's opened, so that jobs can be queued before
+ * any of them runs.
+ */
+typedef struct {
+	EvJob parent;
+
+	gint  id;
+} TestJob;
+
+typedef struct {
+	EvJobClass parent_class;
+} TestJobClass;
+
+G_DEFINE_TYPE (TestJob, test_job, EV_TYPE_JOB)
+
+#define GATE_ID -1
+
+static GMutex  *run_mutex;
+static GCond   *run_cond;
+static gboolean gate_running = FALSE;
+static gboolean gate_open = FALSE;
+static GArray  *run_order;
+
+static gboolean
+test_job_run (EvJob *job)
+{
+	TestJob *test_job = (TestJob *)job;
+
+	g_mutex_lock (run_mutex);
+	if (test_job->id == GATE_ID) {
+		gate_running = TRUE;
+		g_cond_broadcast (run_cond);
+		while (!gate_open)
+			g_cond_wait (run_cond, run_mutex);
+	} else {
+		g_array_append_val (run_order, test_job->id);
+		g_cond_broadcast (run_cond);
+	}
+	g_mutex_unlock (run_mutex);
+
+	return FALSE;
+}
+
+static void
+test_job_init (TestJob *job)
+{
+}
+
+static void
+test_job_class_init (TestJobClass *klass)
+{
+	EV_JOB_CLASS (klass)->run = test_job_run;
+}
+
+static EvJob *
+test_job_new (gint id)
+{
+	TestJob *job;
+
+	job = g_object_new (test_job_get_type (), NULL);
+	job->id = id;
+
+	return EV_JOB (job);
+}
+
+static void
+test_queue_order (void)
+{
+	EvJob *gate;
+	EvJob *jobs[6];
+	guint  i;
+
+	run_mutex = g_mutex_new ();
+	run_cond = g_cond_new ();
+	run_order = g_array_new (FALSE, FALSE, sizeof (gint));
+
+	gate = test_job_new (GATE_ID);
+	ev_job_scheduler_push_job (gate, EV_JOB_PRIORITY_NONE);
+
+	g_mutex_lock (run_mutex);
+	while (!gate_running)
+		g_cond_wait (run_cond, run_mutex);
+	g_mutex_unlock (run_mutex);
+
+	for (i = 0; i < G_N_ELEMENTS (jobs); i++)
+		jobs[i] = test_job_new (i);
+
+	ev_job_scheduler_push_job (jobs[0], EV_JOB_PRIORITY_LOW);
+	ev_job_scheduler_push_job_with_order (jobs[1], EV_JOB_PRIORITY_URGENT, 2);
+	ev_job_scheduler_push_job_with_order (jobs[2], EV_JOB_PRIORITY_URGENT, 1);
+	ev_job_scheduler_push_job (jobs[3], EV_JOB_PRIORITY_HIGH);
+	ev_job_scheduler_push_job (jobs[4], EV_JOB_PRIORITY_LOW);
+	ev_job_scheduler_push_job (jobs[5], EV_JOB_PRIORITY_NONE);
+
+	/* Moved ahead of every other job */
+	ev_job_scheduler_update_job (jobs[5], EV_JOB_PRIORITY_URGENT);
+	/* Pushed again, it's moved after the jobs of its new priority */
+	ev_job_scheduler_push_job_with_order (jobs[0], EV_JOB_PRIORITY_HIGH, 1);
+	/* A running job is left alone */
+	ev_job_scheduler_push_job (gate, EV_JOB_PRIORITY_URGENT);
+
+	g_mutex_lock (run_mutex);
+	gate_open = TRUE;
+	g_cond_broadcast (run_cond);
+	while (run_order->len < G_N_ELEMENTS (jobs))
+		g_cond_wait (run_cond, run_mutex);
+	g_mutex_unlock (run_mutex);
+
+	g_assert_cmpint (g_array_index (run_order, gint, 0), ==, 5);
+	g_assert_cmpint (g_array_index (run_order, gint, 1), ==, 2);
+	g_assert_cmpint (g_array_index (run_order, gint, 2), ==, 1);
+	g_assert_cmpint (g_array_index (run_order, gint, 3), ==, 3);
+	g_assert_cmpint (g_array_index (run_order, gint, 4), ==, 0);
+	g_assert_cmpint (g_array_index (run_order, gint, 5), ==, 4);
+
+	for (i = 0; i < G_N_ELEMENTS (jobs); i++)
+		g_object_unref (jobs[i]);
+	g_object_unref (gate);
+	g_array_free (run_order, TRUE);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_thread_init (NULL);
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/job-scheduler/queue-order",
+			 test_queue_order);
+	g_test_add_func ("/job-scheduler/render-during-thumbnails",
+			 test_render_during_thumbnails);
+
+	return g_test_run ();
+}
@@ -0,0 +1,222 @@
+/* test-page-store.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Checks that pages restored from the page store are identical to
+ * the stored ones, padding included, for every image format and for
+ * widths whose strides are not a multiple of the pixel size. The
+ * patterns put runs and literal sequences on both sides of the
+ * 128 and 255 word boundaries, and around the minimum run length.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "ev-page-store.h"
+
+#define STORE_SIZE (64 * 1024 * 1024)
+#define HEIGHT     5
+
+typedef void (* FillFunc) (guint32 *data,
+			   gsize    n_words);
+
+typedef struct {
+	cairo_format_t format;
+	gint           width;
+	FillFunc       fill;
+} PageStoreTest;
+
+static void
+fill_uniform (guint32 *data,
+	      gsize    n_words)
+{
+	gsize i;
+
+	for (i = 0; i < n_words; i++)
+		data[i] = 0xffffffff;
+}
+
+/* Every word differs from its neighbours, so all rows are literal */
+static void
+fill_literal (guint32 *data,
+	      gsize    n_words)
+{
+	gsize i;
+
+	for (i = 0; i < n_words; i++)
+		data[i] = (guint32) (i + 1) * 2654435761u;
+}
+
+static void
+fill_runs (guint32 *data,
+	   gsize    n_words)
+{
+	static const gsize lengths[] = {
+		1, 2, 3, 4, 127, 128, 129, 1, 254, 255, 256, 2, 257
+	};
+	gsize i = 0, l = 0;
+	guint32 value = 0;
+
+	while (i < n_words) {
+		gsize run = lengths[l++ % G_N_ELEMENTS (lengths)];
+
+		value = value == 0xffffffff ? 0xff000000 : 0xffffffff;
+		while (run-- && i < n_words)
+			data[i++] = value;
+	}
+}
+
+/* Literal sequences of the boundary lengths between short runs */
+static void
+fill_literal_runs (guint32 *data,
+		   gsize    n_words)
+{
+	static const gsize lengths[] = {
+		127, 128, 129, 254, 255, 256
+	};
+	gsize i = 0, l = 0;
+
+	while (i < n_words) {
+		gsize n = lengths[l++ % G_N_ELEMENTS (lengths)];
+		gsize run = 3;
+
+		while (n-- && i < n_words) {
+			data[i] = (guint32) (i + 1) * 2654435761u;
+			i++;
+		}
+		while (run-- && i < n_words)
+			data[i++] = 0;
+	}
+}
+
+static void
+fill_noise (guint32 *data,
+	    gsize    n_words)
+{
+	gsize i;
+
+	/* Few values, so that runs of random length show up */
+	for (i = 0; i < n_words; i++)
+		data[i] = g_test_rand_int_range (0, 3);
+}
+
+static void
+test_round_trip (gconstpointer data)
+{
+	const PageStoreTest *test = data;
+	EvPageStore         *store;
+	cairo_surface_t     *surface;
+	cairo_surface_t     *restored;
+	gint                 stride;
+	gint                 i;
+
+	surface = cairo_image_surface_create (test->format, test->width, HEIGHT);
+	g_assert_cmpint (cairo_surface_status (surface), ==, CAIRO_STATUS_SUCCESS);
+	stride = cairo_image_surface_get_stride (surface);
+
+	cairo_surface_flush (surface);
+	test->fill ((guint32 *) cairo_image_surface_get_data (surface),
+		    (gsize) stride * HEIGHT / sizeof (guint32));
+	cairo_surface_mark_dirty (surface);
+
+	store = _ev_page_store_new (STORE_SIZE);
+	_ev_page_store_add (store, 0, 90, surface);
+
+	g_assert (_ev_page_store_lookup (store, 0, 0, test->width, HEIGHT) == NULL);
+	g_assert (_ev_page_store_lookup (store, 1, 90, test->width, HEIGHT) == NULL);
+
+	/* Restoring doesn't consume the stored page */
+	for (i = 0; i < 2; i++) {
+		restored = _ev_page_store_lookup (store, 0, 90, test->width, HEIGHT);
+		g_assert (restored != NULL);
+		g_assert_cmpint (cairo_image_surface_get_format (restored), ==, test->format);
+		g_assert_cmpint (cairo_image_surface_get_stride (restored), ==, stride);
+
+		cairo_surface_flush (restored);
+		g_assert (memcmp (cairo_image_surface_get_data (surface),
+				  cairo_image_surface_get_data (restored),
+				  (gsize) stride * HEIGHT) == 0);
+		cairo_surface_destroy (restored);
+	}
+
+	_ev_page_store_free (store);
+	cairo_surface_destroy (surface);
+}
+
+int
+main (int argc, char *argv[])
+{
+	static const struct {
+		cairo_format_t format;
+		const gchar   *name;
+	} formats[] = {
+		{ CAIRO_FORMAT_ARGB32, "argb32" },
+		{ CAIRO_FORMAT_RGB24,  "rgb24" },
+		{ CAIRO_FORMAT_A8,     "a8" },
+		{ CAIRO_FORMAT_A1,     "a1" }
+	};
+	static const struct {
+		FillFunc     fill;
+		const gchar *name;
+	} patterns[] = {
+		{ fill_uniform,      "uniform" },
+		{ fill_literal,      "literal" },
+		{ fill_runs,         "runs" },
+		{ fill_literal_runs, "literal-runs" },
+		{ fill_noise,        "noise" }
+	};
+	static const gint widths[] = {
+		1, 3, 7, 127, 128, 129, 255, 256, 257, 1021
+	};
+	GPtrArray *tests;
+	gint       retval;
+	guint      f, p, w;
+
+	g_test_init (&argc, &argv, NULL);
+
+	tests = g_ptr_array_new ();
+
+	for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+		for (p = 0; p < G_N_ELEMENTS (patterns); p++) {
+			for (w = 0; w < G_N_ELEMENTS (widths); w++) {
+				PageStoreTest *test;
+				gchar         *path;
+
+				test = g_new0 (PageStoreTest, 1);
+				test->format = formats[f].format;
+				test->width = widths[w];
+				test->fill = patterns[p].fill;
+				g_ptr_array_add (tests, test);
+
+				path = g_strdup_printf ("/page-store/%s/%s/%d",
+							formats[f].name,
+							patterns[p].name,
+							widths[w]);
+				g_test_add_data_func (path, test, test_round_trip);
+				g_free (path);
+			}
+		}
+	}
+
+	retval = g_test_run ();
+
+	g_ptr_array_foreach (tests, (GFunc)g_free, NULL);
+	g_ptr_array_free (tests, TRUE);
+
+	return retval;
+}
@@ -0,0 +1,231 @@
+/* test-pixel-kernels.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Checks that every pixel kernel implementation supported by the CPU
+ * gives the same results as the scalar reference, for all the row
+ * lengths around the vector widths and unaligned rows.
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include "ev-pixel-kernels.h"
+
+#define MAX_PIXELS 80
+#define MAX_OFFSET 3
+
+static const EvPixelKernels *reference;
+
+/* Premultiplied pixels, with some fully opaque and fully transparent ones */
+static void
+fill_argb32 (GRand   *rand,
+	     guint32 *pixels,
+	     gint     n_pixels)
+{
+	gint i;
+
+	for (i = 0; i < n_pixels; i++) {
+		guint a = g_rand_int_range (rand, 0, 256);
+
+		if (i % 5 == 0)
+			a = 0;
+		else if (i % 7 == 0)
+			a = 0xff;
+
+		pixels[i] = (a << 24) |
+			(g_rand_int_range (rand, 0, a + 1) << 16) |
+			(g_rand_int_range (rand, 0, a + 1) << 8) |
+			g_rand_int_range (rand, 0, a + 1);
+	}
+}
+
+static void
+fill_bytes (GRand  *rand,
+	    guchar *data,
+	    gsize   n_bytes)
+{
+	gsize i;
+
+	for (i = 0; i < n_bytes; i++)
+		data[i] = g_rand_int_range (rand, 0, 256);
+}
+
+static void
+test_argb32_to_rgba (gconstpointer data)
+{
+	const EvPixelKernels *kernels = data;
+	GRand                *rand = g_rand_new_with_seed (1);
+	guint32               src[MAX_PIXELS + MAX_OFFSET];
+	guchar                expected[MAX_PIXELS * 4];
+	guchar                result[MAX_PIXELS * 4];
+	gint                  n, offset, has_alpha;
+
+	for (n = 0; n <= MAX_PIXELS; n++) {
+		for (offset = 0; offset < MAX_OFFSET; offset++) {
+			for (has_alpha = 0; has_alpha < 2; has_alpha++) {
+				fill_argb32 (rand, src, n + offset);
+				memset (expected, 0, sizeof (expected));
+				memset (result, 0, sizeof (result));
+
+				reference->argb32_to_rgba (src + offset, expected, n, has_alpha);
+				kernels->argb32_to_rgba (src + offset, result, n, has_alpha);
+				g_assert (memcmp (expected, result, sizeof (result)) == 0);
+			}
+		}
+	}
+
+	g_rand_free (rand);
+}
+
+static void
+test_rgba_to_argb32 (gconstpointer data)
+{
+	const EvPixelKernels *kernels = data;
+	GRand                *rand = g_rand_new_with_seed (2);
+	guchar                src[(MAX_PIXELS + MAX_OFFSET) * 4];
+	guint32               expected[MAX_PIXELS];
+	guint32               result[MAX_PIXELS];
+	gint                  n, offset, n_channels;
+
+	for (n = 0; n <= MAX_PIXELS; n++) {
+		for (offset = 0; offset < MAX_OFFSET; offset++) {
+			for (n_channels = 3; n_channels <= 4; n_channels++) {
+				fill_bytes (rand, src, sizeof (src));
+				memset (expected, 0, sizeof (expected));
+				memset (result, 0, sizeof (result));
+
+				reference->rgba_to_argb32 (src + offset, expected, n, n_channels);
+				kernels->rgba_to_argb32 (src + offset, result, n, n_channels);
+				g_assert (memcmp (expected, result, sizeof (result)) == 0);
+			}
+		}
+	}
+
+	g_rand_free (rand);
+}
+
+static void
+test_invert (gconstpointer data)
+{
+	const EvPixelKernels *kernels = data;
+	GRand                *rand = g_rand_new_with_seed (3);
+	guchar                expected[MAX_PIXELS * 4 + MAX_OFFSET * 4];
+	guchar                result[MAX_PIXELS * 4 + MAX_OFFSET * 4];
+	gint                  n, offset;
+
+	for (n = 0; n <= MAX_PIXELS * 4; n++) {
+		for (offset = 0; offset < MAX_OFFSET; offset++) {
+			fill_bytes (rand, expected, sizeof (expected));
+			memcpy (result, expected, sizeof (result));
+
+			reference->invert (expected + offset * 4, n, 0x00ffffff);
+			kernels->invert (result + offset * 4, n, 0x00ffffff);
+			g_assert (memcmp (expected, result, sizeof (result)) == 0);
+		}
+	}
+
+	g_rand_free (rand);
+}
+
+static void
+test_box_accumulate (gconstpointer data)
+{
+	const EvPixelKernels *kernels = data;
+	GRand                *rand = g_rand_new_with_seed (4);
+	guint32               src[MAX_PIXELS + MAX_OFFSET];
+	guint32               expected[MAX_PIXELS * 4];
+	guint32               result[MAX_PIXELS * 4];
+	gint                  x_bounds[MAX_PIXELS + 1];
+	gint                  n, offset, dest_width, i;
+
+	for (n = 1; n <= MAX_PIXELS; n++) {
+		for (offset = 0; offset < MAX_OFFSET; offset++) {
+			for (dest_width = 1; dest_width <= n; dest_width += 1 + n / 8) {
+				for (i = 0; i <= dest_width; i++)
+					x_bounds[i] = i * n / dest_width;
+
+				fill_argb32 (rand, src, n + offset);
+				memset (expected, 0, sizeof (expected));
+				memset (result, 0, sizeof (result));
+
+				reference->box_accumulate (src + offset, x_bounds, dest_width, expected);
+				kernels->box_accumulate (src + offset, x_bounds, dest_width, result);
+				g_assert (memcmp (expected, result, sizeof (result)) == 0);
+			}
+		}
+	}
+
+	g_rand_free (rand);
+}
+
+/* Unpremultiplying and premultiplying again must give the same pixel */
+static void
+test_round_trip (void)
+{
+	guint a, c;
+
+	for (a = 1; a < 256; a++) {
+		for (c = 0; c <= a; c++) {
+			guint32 pixel = (a << 24) | (c << 16) | (c << 8) | c;
+			guint32 result;
+			guchar  rgba[4];
+
+			reference->argb32_to_rgba (&pixel, rgba, 1, TRUE);
+			reference->rgba_to_argb32 (rgba, &result, 1, 4);
+			g_assert_cmphex (pixel, ==, result);
+		}
+	}
+}
+
+int
+main (int argc, char *argv[])
+{
+	gint level;
+
+	g_test_init (&argc, &argv, NULL);
+
+	reference = _ev_pixel_kernels_get_for_level (EV_PIXEL_KERNELS_SCALAR);
+	g_test_add_func ("/pixel-kernels/scalar/round-trip", test_round_trip);
+
+	for (level = EV_PIXEL_KERNELS_SCALAR + 1; level < EV_PIXEL_KERNELS_N_LEVELS; level++) {
+		const EvPixelKernels *kernels = _ev_pixel_kernels_get_for_level (level);
+		gchar                *path;
+
+		if (!kernels)
+			continue;
+
+		path = g_strdup_printf ("/pixel-kernels/%s/argb32-to-rgba", kernels->name);
+		g_test_add_data_func (path, kernels, test_argb32_to_rgba);
+		g_free (path);
+
+		path = g_strdup_printf ("/pixel-kernels/%s/rgba-to-argb32", kernels->name);
+		g_test_add_data_func (path, kernels, test_rgba_to_argb32);
+		g_free (path);
+
+		path = g_strdup_printf ("/pixel-kernels/%s/invert", kernels->name);
+		g_test_add_data_func (path, kernels, test_invert);
+		g_free (path);
+
+		path = g_strdup_printf ("/pixel-kernels/%s/box-accumulate", kernels->name);
+		g_test_add_data_func (path, kernels, test_box_accumulate);
+		g_free (path);
+	}
+
+	return g_test_run ();
+}
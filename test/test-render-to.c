@@ -0,0 +1,270 @@
+/* test-render-to.c
+ *  this file is part of evince, a gnome document viewer
+ *
+ * Evince is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Evince is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Checks that ev_document_render_to() draws the same pixels as
+ * painting the surface returned by ev_document_render(), for the
+ * bundled documents whose backends are installed. Pages are drawn
+ * into a larger surface at an offset, with and without a clip, so
+ * that both the direct and the fallback paths of the backends are
+ * used.
+ */
+
+#include <config.h>
+
+#include <evince-document.h>
+
+#include <gio/gio.h>
+
+/* Around the page, where nothing must be drawn */
+#define MARGIN 7
+
+/* Differences between the rasterizers of the two paths */
+#define TOLERANCE 2
+
+typedef struct {
+	EvDocument      *document;
+	gint             rotation;
+	EvRenderQuality  quality;
+	gboolean         clipped;
+} RenderToTest;
+
+static const gchar *fixtures[] = {
+	"1-page.djvu",
+	"3-page.pdf"
+};
+
+static cairo_surface_t *
+create_target (gint width,
+	       gint height)
+{
+	cairo_surface_t *surface;
+	cairo_t         *cr;
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+					      width + 2 * MARGIN,
+					      height + 2 * MARGIN);
+	cr = cairo_create (surface);
+	cairo_set_source_rgb (cr, 0., 0., 1.);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+
+	return surface;
+}
+
+/* Places cr at the page origin, clipped to the middle of the page */
+static void
+setup_context (cairo_t            *cr,
+	       const RenderToTest *test,
+	       gint                width,
+	       gint                height)
+{
+	cairo_translate (cr, MARGIN, MARGIN);
+	if (test->clipped) {
+		cairo_rectangle (cr, width / 4, height / 4, width / 2, height / 2);
+		cairo_clip (cr);
+	}
+}
+
+static void
+assert_surfaces_equal (cairo_surface_t *expected,
+		       cairo_surface_t *actual)
+{
+	guchar *expected_data, *actual_data;
+	gint    width, height, stride;
+	gint    x, y, i;
+
+	cairo_surface_flush (expected);
+	cairo_surface_flush (actual);
+
+	width = cairo_image_surface_get_width (expected);
+	height = cairo_image_surface_get_height (expected);
+	stride = cairo_image_surface_get_stride (expected);
+	g_assert_cmpint (cairo_image_surface_get_width (actual), ==, width);
+	g_assert_cmpint (cairo_image_surface_get_height (actual), ==, height);
+	g_assert_cmpint (cairo_image_surface_get_stride (actual), ==, stride);
+
+	expected_data = cairo_image_surface_get_data (expected);
+	actual_data = cairo_image_surface_get_data (actual);
+
+	for (y = 0; y < height; y++) {
+		guint32 *e = (guint32 *)(expected_data + y * stride);
+		guint32 *a = (guint32 *)(actual_data + y * stride);
+
+		for (x = 0; x < width; x++) {
+			/* The top byte of RGB24 pixels is undefined */
+			for (i = 0; i < 24; i += 8) {
+				gint diff = (gint)((e[x] >> i) & 0xff) - (gint)((a[x] >> i) & 0xff);
+
+				if (ABS (diff) > TOLERANCE) {
+					g_error ("Pixel %d,%d is %06x instead of %06x",
+						 x, y, a[x] & 0xffffff, e[x] & 0xffffff);
+				}
+			}
+		}
+	}
+}
+
+static void
+test_render_to (gconstpointer data)
+{
+	const RenderToTest *test = data;
+	EvPage             *page;
+	EvRenderContext    *rc;
+	cairo_surface_t    *surface;
+	cairo_surface_t    *image;
+	cairo_surface_t    *expected;
+	cairo_surface_t    *actual;
+	cairo_t            *cr;
+	gint                width, height;
+
+	ev_document_doc_mutex_lock ();
+
+	page = ev_document_get_page (test->document, 0);
+	rc = ev_render_context_new (page, test->rotation, 1.5);
+	ev_render_context_set_quality (rc, test->quality);
+	g_object_unref (page);
+
+	surface = ev_document_render (test->document, rc);
+	g_assert (surface != NULL);
+	image = ev_document_misc_surface_to_color (surface);
+	cairo_surface_destroy (surface);
+
+	width = cairo_image_surface_get_width (image);
+	height = cairo_image_surface_get_height (image);
+
+	expected = create_target (width, height);
+	cr = cairo_create (expected);
+	setup_context (cr, test, width, height);
+	cairo_set_source_surface (cr, image, 0, 0);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+	cairo_surface_destroy (image);
+
+	actual = create_target (width, height);
+	cr = cairo_create (actual);
+	setup_context (cr, test, width, height);
+	g_assert (ev_document_render_to (test->document, rc, cr));
+	g_assert_cmpint (cairo_status (cr), ==, CAIRO_STATUS_SUCCESS);
+	cairo_destroy (cr);
+
+	g_object_unref (rc);
+
+	ev_document_doc_mutex_unlock ();
+
+	assert_surfaces_equal (expected, actual);
+
+	cairo_surface_destroy (expected);
+	cairo_surface_destroy (actual);
+}
+
+static EvDocument *
+load_fixture (const gchar *filename)
+{
+	EvDocument *document;
+	GFile      *file;
+	gchar      *path;
+	gchar      *uri;
+	GError     *error = NULL;
+
+	path = g_build_filename (TEST_DATA_DIR, filename, NULL);
+	file = g_file_new_for_path (path);
+	g_free (path);
+	uri = g_file_get_uri (file);
+	g_object_unref (file);
+
+	/* Documents of backends that are not built are not tested */
+	document = ev_document_factory_get_document (uri, &error);
+	g_free (uri);
+	if (error) {
+		g_error_free (error);
+		if (document)
+			g_object_unref (document);
+
+		return NULL;
+	}
+
+	return document;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GPtrArray *documents;
+	GPtrArray *tests;
+	gint       retval;
+	guint      i;
+
+	g_type_init ();
+
+	if (!g_thread_supported ())
+		g_thread_init (NULL);
+
+	g_test_init (&argc, &argv, NULL);
+
+	if (!ev_init ())
+		return 1;
+
+	documents = g_ptr_array_new ();
+	tests = g_ptr_array_new ();
+
+	for (i = 0; i < G_N_ELEMENTS (fixtures); i++) {
+		EvDocument *document;
+		gint        rotation;
+		gint        quality;
+		gint        clipped;
+
+		document = load_fixture (fixtures[i]);
+		if (!document)
+			continue;
+		g_ptr_array_add (documents, document);
+
+		for (rotation = 0; rotation < 360; rotation += 90) {
+			for (quality = EV_RENDER_QUALITY_FINAL; quality <= EV_RENDER_QUALITY_DRAFT; quality++) {
+				for (clipped = FALSE; clipped <= TRUE; clipped++) {
+					RenderToTest *test;
+					gchar        *path;
+
+					test = g_new0 (RenderToTest, 1);
+					test->document = document;
+					test->rotation = rotation;
+					test->quality = quality;
+					test->clipped = clipped;
+					g_ptr_array_add (tests, test);
+
+					path = g_strdup_printf ("/render-to/%s/%d/%s%s",
+								fixtures[i], rotation,
+								quality == EV_RENDER_QUALITY_DRAFT ? "draft" : "final",
+								clipped ? "/clipped" : "");
+					g_test_add_data_func (path, test, test_render_to);
+					g_free (path);
+				}
+			}
+		}
+	}
+
+	retval = g_test_run ();
+
+	g_ptr_array_foreach (tests, (GFunc)g_free, NULL);
+	g_ptr_array_free (tests, TRUE);
+	g_ptr_array_foreach (documents, (GFunc)g_object_unref, NULL);
+	g_ptr_array_free (documents, TRUE);
+
+	ev_shutdown ();
+
+	return retval;
+}
@@ -40,20 +40,59 @@
 #define THUMBNAIL_SIZE 128
 
 static gint size = THUMBNAIL_SIZE;
+static gboolean batch = FALSE;
+static gint n_threads = 1;
 static const gchar **file_arguments;
 
 static const GOptionEntry goption_options[] = {
 	{ "size", 's', 0, G_OPTION_ARG_INT, &size, NULL, "SIZE" },
-	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "<input> <ouput>" },
+	{ "batch", 'b', 0, G_OPTION_ARG_NONE, &batch, "Thumbnail several files, reading tab separated input and output pairs from stdin when no files are given", NULL },
+	{ "threads", 't', 0, G_OPTION_ARG_INT, &n_threads, "Number of threads used in batch mode", "N" },
+	{ G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &file_arguments, NULL, "<input> <ouput> [<input> <output>...]" },
 	{ NULL }
 };
 
-struct AsyncData {
-	EvDocument  *document;
-	const gchar *output;
-	gint         size;
-	gboolean     success;
-};
+/* Only one document is loaded or rendered at a time, backends
+ * are not thread safe. In batch mode, copying remote files and
+ * encoding the thumbnails happen in parallel.
+ */
+#define BACKEND_LOCK()   backend_lock ()
+#define BACKEND_UNLOCK() ev_document_doc_mutex_unlock ()
+
+/* Time spent by the current thread waiting for the backend lock, in
+ * batch mode. It's reported apart from the time spent on the file,
+ * otherwise timings would grow with the number of threads.
+ */
+static GStaticPrivate lock_wait = G_STATIC_PRIVATE_INIT;
+
+static void
+backend_lock (void)
+{
+	gdouble *wait = g_static_private_get (&lock_wait);
+	GTimer  *timer;
+
+	if (!wait) {
+		ev_document_doc_mutex_lock ();
+		return;
+	}
+
+	timer = g_timer_new ();
+	ev_document_doc_mutex_lock ();
+	*wait += g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+}
+
+typedef struct {
+	gchar *input;
+	gchar *output;
+} ThumbnailRequest;
+
+G_LOCK_DEFINE_STATIC (batch_output);
+static gint n_failed = 0;
+
+/* Classes of the backends used in batch mode, referenced so that
+ * backend modules are not unloaded after every file */
+static GHashTable *backend_classes = NULL;
 
 static void
 delete_temp_file (GFile *file)
@@ -100,7 +139,18 @@ evince_thumbnailer_get_document (GFile *file)
 		uri = g_file_get_uri (file);
 	}
 
-	document = ev_document_factory_get_document (uri, &error);
+	/* Only the first page is rendered, don't scan the whole document */
+	BACKEND_LOCK ();
+	document = ev_document_factory_get_document_full (uri,
+							  EV_DOCUMENT_LOAD_FLAG_FIRST_PAGE,
+							  &error);
+	if (document && backend_classes &&
+	    !g_hash_table_lookup (backend_classes, GSIZE_TO_POINTER (G_OBJECT_TYPE (document)))) {
+		g_hash_table_insert (backend_classes,
+				     GSIZE_TO_POINTER (G_OBJECT_TYPE (document)),
+				     g_type_class_ref (G_OBJECT_TYPE (document)));
+	}
+	BACKEND_UNLOCK ();
 	if (tmp_file) {
 		if (document) {
 			g_object_weak_ref (G_OBJECT (document),
@@ -135,6 +185,7 @@ evince_thumbnail_pngenc_get (EvDocument *document, const char *thumbnail, int si
 	GdkPixbuf *pixbuf;
 	EvPage *page;
 
+	BACKEND_LOCK ();
 	page = ev_document_get_page (document, 0);
 	
 	ev_document_get_page_size (document, 0, &width, &height);
@@ -144,6 +195,7 @@ evince_thumbnail_pngenc_get (EvDocument *document, const char *thumbnail, int si
 						       rc, FALSE);
 	g_object_unref (rc);
 	g_object_unref (page);
+	BACKEND_UNLOCK ();
 	
 	if (pixbuf != NULL) {
 		const char *overlaid_icon_name = NULL;
@@ -191,18 +243,164 @@ evince_thumbnail_pngenc_get (EvDocument *document, const char *thumbnail, int si
 	return FALSE;
 }
 
-static gpointer
-evince_thumbnail_pngenc_get_async (struct AsyncData *data)
+static void
+evince_thumbnailer_release_document (EvDocument *document)
 {
-	ev_document_doc_mutex_lock ();
-	data->success = evince_thumbnail_pngenc_get (data->document,
-						     data->output,
-						     data->size);
-	ev_document_doc_mutex_unlock ();
-	
-	g_idle_add ((GSourceFunc)gtk_main_quit, NULL);
-	
-	return NULL;
+	BACKEND_LOCK ();
+	g_object_unref (document);
+	BACKEND_UNLOCK ();
+}
+
+/* Returns 0 on success or the exit code of the thumbnailer */
+static gint
+evince_thumbnailer_thumbnail_file (const gchar *input,
+				   const gchar *output)
+{
+	EvDocument *document;
+	GFile      *file;
+	gint        retval = 0;
+
+	file = g_file_new_for_commandline_arg (input);
+	document = evince_thumbnailer_get_document (file);
+	g_object_unref (file);
+
+	if (!document)
+		return -2;
+
+	if (!EV_IS_DOCUMENT_THUMBNAILS (document) ||
+	    !evince_thumbnail_pngenc_get (document, output, size))
+		retval = -2;
+
+	evince_thumbnailer_release_document (document);
+
+	return retval;
+}
+
+static void
+thumbnail_request_free (ThumbnailRequest *request)
+{
+	g_free (request->input);
+	g_free (request->output);
+	g_slice_free (ThumbnailRequest, request);
+}
+
+static void
+batch_thumbnail_file (ThumbnailRequest *request,
+		      gpointer          user_data)
+{
+	GTimer  *timer;
+	gdouble  wait = 0;
+	gboolean success;
+
+	g_static_private_set (&lock_wait, &wait, NULL);
+
+	timer = g_timer_new ();
+	success = evince_thumbnailer_thumbnail_file (request->input,
+						     request->output) == 0;
+	g_timer_stop (timer);
+
+	g_static_private_set (&lock_wait, NULL, NULL);
+
+	G_LOCK (batch_output);
+	if (!success)
+		n_failed++;
+	g_print ("%s\t%s\t%.1f ms\t%.1f ms waiting for the lock\n",
+		 success ? "OK" : "FAILED",
+		 request->input,
+		 (g_timer_elapsed (timer, NULL) - wait) * 1000,
+		 wait * 1000);
+	G_UNLOCK (batch_output);
+
+	g_timer_destroy (timer);
+	thumbnail_request_free (request);
+}
+
+static void
+batch_push_request (GThreadPool *pool,
+		    const gchar *input,
+		    const gchar *output)
+{
+	ThumbnailRequest *request;
+
+	request = g_slice_new (ThumbnailRequest);
+	request->input = g_strdup (input);
+	request->output = g_strdup (output);
+	g_thread_pool_push (pool, request, NULL);
+}
+
+/* Thumbnails the files given in the command line, or read from
+ * stdin as "input<TAB>output" lines, printing the result, the time
+ * spent on every file and the time spent waiting for other threads.
+ */
+static gint
+evince_thumbnailer_batch (void)
+{
+	GThreadPool *pool;
+	GTimer      *timer;
+	GError      *error = NULL;
+	gint         n_files = 0;
+
+	/* Make sure the mutex is created before the threads */
+	ev_document_get_doc_mutex ();
+
+	backend_classes = g_hash_table_new_full (g_direct_hash,
+						 g_direct_equal,
+						 NULL,
+						 (GDestroyNotify)g_type_class_unref);
+
+	pool = g_thread_pool_new ((GFunc)batch_thumbnail_file, NULL,
+				  MAX (n_threads, 1), TRUE, &error);
+	if (!pool) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+
+		return -1;
+	}
+
+	timer = g_timer_new ();
+
+	if (file_arguments && file_arguments[0]) {
+		gint i;
+
+		for (i = 0; file_arguments[i] && file_arguments[i + 1]; i += 2) {
+			batch_push_request (pool, file_arguments[i], file_arguments[i + 1]);
+			n_files++;
+		}
+	} else {
+		GIOChannel *channel;
+		gchar      *line;
+		gsize       terminator;
+
+		channel = g_io_channel_unix_new (0);
+		g_io_channel_set_encoding (channel, NULL, NULL);
+		while (g_io_channel_read_line (channel, &line, NULL, &terminator, NULL) == G_IO_STATUS_NORMAL) {
+			gchar **pair;
+
+			line[terminator] = '\0';
+			pair = g_strsplit (line, "\t", 2);
+			if (pair[0] && pair[1] && *pair[0] && *pair[1]) {
+				batch_push_request (pool, pair[0], pair[1]);
+				n_files++;
+			} else if (*line) {
+				g_printerr ("Ignoring invalid line: %s\n", line);
+			}
+			g_strfreev (pair);
+			g_free (line);
+		}
+		g_io_channel_unref (channel);
+	}
+
+	/* Wait for all the files to be processed */
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	g_hash_table_destroy (backend_classes);
+	backend_classes = NULL;
+
+	g_printerr ("%d files, %d failed, %.1f s\n",
+		    n_files, n_failed, g_timer_elapsed (timer, NULL));
+	g_timer_destroy (timer);
+
+	return n_failed > 0 ? -2 : 0;
 }
 
 static void
@@ -218,11 +416,10 @@ print_usage (GOptionContext *context)
 int
 main (int argc, char *argv[])
 {
-	EvDocument     *document;
 	GOptionContext *context;
-	const char     *input;
-	const char     *output;
-	GFile          *file;
+	const char     *input = NULL;
+	const char     *output = NULL;
+	gint            retval;
 	GError         *error = NULL;
 
 	context = g_option_context_new ("- GNOME Document Thumbnailer");
@@ -237,9 +434,18 @@ main (int argc, char *argv[])
 		return -1;
 	}
 
-	input = file_arguments ? file_arguments[0] : NULL;
-	output = input ? file_arguments[1] : NULL;
-	if (!input || !output) {
+	if (!batch) {
+		input = file_arguments ? file_arguments[0] : NULL;
+		output = input ? file_arguments[1] : NULL;
+		if (!input || !output) {
+			print_usage (context);
+			g_option_context_free (context);
+
+			return -1;
+		}
+	} else if (file_arguments &&
+		   g_strv_length ((gchar **)file_arguments) % 2 != 0) {
+		g_printerr ("Input and output files must be given in pairs\n");
 		print_usage (context);
 		g_option_context_free (context);
 
@@ -253,9 +459,6 @@ main (int argc, char *argv[])
 		return -1;
 	}
 
-	input = file_arguments[0];
-	output = file_arguments[1];
-
 	g_type_init ();
 
 	if (!g_thread_supported ())
@@ -264,49 +467,12 @@ main (int argc, char *argv[])
         if (!ev_init ())
                 return -1;
 
-	file = g_file_new_for_commandline_arg (input);
-	document = evince_thumbnailer_get_document (file);
-	g_object_unref (file);
-
-	if (!document) {
-		ev_shutdown ();
-		return -2;
-	}
-
-	if (!EV_IS_DOCUMENT_THUMBNAILS (document)) {
-		g_object_unref (document);
-		ev_shutdown ();
-		return -2;
-	}
-
-	if (EV_IS_ASYNC_RENDERER (document)) {
-		struct AsyncData data;
+	if (batch)
+		retval = evince_thumbnailer_batch ();
+	else
+		retval = evince_thumbnailer_thumbnail_file (input, output);
 
-		gtk_init (&argc, &argv);
-		
-		data.document = document;
-		data.output = output;
-		data.size = size;
-
-		g_thread_create ((GThreadFunc) evince_thumbnail_pngenc_get_async,
-				 &data, FALSE, NULL);
-		
-		gtk_main ();
-
-		g_object_unref (document);
-		ev_shutdown ();
-
-		return data.success ? 0 : -2;
-	}
-
-	if (!evince_thumbnail_pngenc_get (document, output, size)) {
-		g_object_unref (document);
-		ev_shutdown ();
-		return -2;
-	}
-
-	g_object_unref (document);
         ev_shutdown ();
 
-	return 0;
+	return retval;
 }